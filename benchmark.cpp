@@ -19,479 +19,507 @@
  * IN THE SOFTWARE.
  */
 
+
+// Parameterized throughput harness.
+//
+//     benchmark [--min 4K] [--max 64M] [--reps 15] [--cache warm|cold|both] [--filter text] [--dir path] [--csv]
+//
+// Payload sizes go from --min to --max, multiplying by 16 (4K, 64K, 1M, 16M, 256M, 4G, ...). Every size runs
+// the read, write and round trip cases over the whole buffer size sweep plus the bulk and chunked APIs.
+// Each sample opens fresh streams, so no run reads from an exhausted one.
+//
+// warm: one untimed run first, samples then come from the page cache.
+// cold: the page cache is dropped for the file before every read sample (posix_fadvise), and write samples
+//       are timed up to fsync. Not available where posix_fadvise is missing.
+//
+// Reported: MB/s (10^6 bytes) at the median, p50 / p90 / p99 sample durations and bytes per TSC cycle
+// (reference cycles, x86 only). Small payloads get more samples, up to 1000.
+
 #include "streambyte.hpp"
 
 #include <algorithm>
 #include <chrono>
-#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
-#include <numeric>
-#include <sstream>
+#include <string>
 #include <vector>
 
-// Tests parameters
-static constexpr const int g_tests_batch_count = 100;
-static constexpr const int g_bytes_count = 500'000;
-
-static
-void print_abstract() {
-    std::cout << "This utility tests against:\r\n\t"
-        << "- i/ostream_iterator<char>\r\n\t"
-        << "- i/ostreambuf_iterator<char>\r\n\t"
-        << "- i/ostreambyte_iterator<32>\r\n\t"
-        << "- i/ostreambyte_iterator<64>\r\n\t"
-        << "- i/ostreambyte_iterator<128>\r\n\t"
-        << "- i/ostreambyte_iterator<256>\r\n\t"
-        << "- i/ostreambyte_iterator<512>\r\n\t"
-        << "- i/ostreambyte_iterator<1024>\r\n"
-        << std::endl;
-    
-    std::cout << "Note that, istreambyte does no formatting, unlike i/ostream_iterator.\r\n" << std::endl;
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MRT_BENCH_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define MRT_BENCH_TSC
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(POSIX_FADV_DONTNEED)
+#define MRT_BENCH_COLD_CACHE
+#endif
+
+// Benchmark parameters
+namespace options {
+    static std::uint64_t min_payload = std::uint64_t{4} << 10;
+    static std::uint64_t max_payload = std::uint64_t{64} << 20;
+    static int reps = 15;
+    static bool warm = true;
+    static bool cold = true;
+    static bool csv = false;
+    static std::string filter;
+    static std::string dir = ".";
+
+    static constexpr std::size_t pattern_size = std::size_t{1} << 20;
+    static constexpr int max_reps = 1000;
 }
 
-// Testing utilities (timing, batching)
-namespace utils {
-
-    void print_result(std::uint64_t median, std::uint64_t sum, std::uint64_t average) {
-        std::cout << "average=" << average 
-            << ", sum=" << sum 
-            << ", median=" << median;
-    }
-
-    template<typename Function>
-    auto test(Function&& f) {
-        using namespace std;
+// Buffer sizes swept by the iterator cases.
+template <std::size_t... sizes>
+struct buffer_sizes { };
 
-        auto start = chrono::high_resolution_clock::now();
-        f();
-        auto end = chrono::high_resolution_clock::now();
+using swept_buffer_sizes = buffer_sizes<32, 64, 128, 256, 512, 1024, 4096, 16384, 65536>;
 
-        return chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+// Timing, cache control, statistics
+namespace utils {
+    // Keeps the readers' checksums alive.
+    static volatile std::uint64_t g_sink = 0;
+
+    inline
+    std::uint64_t cycles() noexcept {
+#ifdef MRT_BENCH_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
     }
 
-    template<typename Function>
-    void batch_test() {
-        std::vector<std::uint64_t> durations;
-        durations.reserve(g_tests_batch_count);
-
-        std::generate_n(std::back_inserter(durations), g_tests_batch_count, []() { return test(Function{}); });
-
-        // Calculations
-        std::sort(std::begin(durations), std::end(durations));
-
-        auto median = static_cast<std::uint64_t>( (durations[std::ceil(g_tests_batch_count / 2)] + durations[std::floor(g_tests_batch_count / 2)]) / 2 );
-        std::uint64_t sum = std::accumulate(std::begin(durations), std::end(durations), 0, std::plus<std::uint64_t>{});
-        auto average = static_cast<std::uint64_t>(sum / g_tests_batch_count);
-
-        print_result(median, sum, average);
+    // Writes back then evicts the file's pages so the next read comes from the device.
+    inline
+    void drop_cache(const std::string& path) {
+#ifdef MRT_BENCH_COLD_CACHE
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            ::fdatasync(fd);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+#else
+        (void)path;
+#endif
     }
 
-}
-
-// Actual operations
-namespace operation {
-    static std::vector<std::byte> data_to_write;
-
-    std::vector<std::byte> get_data_to_write() {
-        if (data_to_write.empty()) {
-            data_to_write.reserve(g_bytes_count);
-
-            // Byte: 0..9
-            for (auto i = 0; i < g_bytes_count; ++i) {
-                data_to_write.push_back( static_cast<std::byte>(i % 10) );
-            }
-        }
-
-        return data_to_write;
+    // fsync works per file, so any descriptor on it flushes what the stream wrote.
+    inline
+    void sync_file(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            ::fsync(fd);
+            ::close(fd);
+        }
+#else
+        (void)path;
+#endif
     }
 
-    struct ostream {
-        std::vector<char> m_data;
-        std::ofstream m_stream;
-
-        ostream() : m_stream("ostream.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            auto data = get_data_to_write();
-            m_data.reserve(data.size());
-            for (auto c : data) {
-                m_data.push_back(static_cast<char>(c));
-            }
-        }
-
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                std::ostream_iterator<char>(m_stream));
-        }
+    struct sample {
+        std::uint64_t ns;
+        std::uint64_t cycles;
     };
 
-    struct ostreambuf {
-        std::vector<char> m_data;
-        std::ofstream m_stream;
-
-        ostreambuf() : m_stream("ostreambuf.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            auto data = get_data_to_write();
-            m_data.reserve(data.size());
-            for (auto c : data) {
-                m_data.push_back(static_cast<char>(c));
-            }
-        }
-
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                std::ostreambuf_iterator<char>(m_stream));
-        }
+    struct summary {
+        double mb_per_s;
+        double p50_us;
+        double p90_us;
+        double p99_us;
+        double bytes_per_cycle;
     };
 
-    struct ostreambyte_32 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 32;
-
-        ostreambyte_32() : m_stream("ostreambyte_32.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
-        }
-
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
-        }
-    };
-
-    struct ostreambyte_64 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 64;
-
-        ostreambyte_64() : m_stream("ostreambyte_64.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
-        }
-
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
-        }
-    };
-
-    struct ostreambyte_128 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 128;
-
-        ostreambyte_128() : m_stream("ostreambyte_128.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
-        }
-
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
-        }
-    };
-
-    struct ostreambyte_256 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 256;
-
-        ostreambyte_256() : m_stream("ostreambyte_256.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
-        }
+    inline
+    summary summarize(std::vector<sample> samples, std::uint64_t payload) {
+        std::sort(samples.begin(), samples.end(), [](const sample& a, const sample& b) { return a.ns < b.ns; });
+        const auto at = [&samples](double quantile) {
+            return samples[static_cast<std::size_t>(quantile * static_cast<double>(samples.size() - 1) + 0.5)];
+        };
+
+        const sample median = at(0.5);
+        summary result{};
+        result.mb_per_s = median.ns == 0 ? 0.0 : static_cast<double>(payload) * 1e3 / static_cast<double>(median.ns);
+        result.p50_us = static_cast<double>(median.ns) / 1e3;
+        result.p90_us = static_cast<double>(at(0.9).ns) / 1e3;
+        result.p99_us = static_cast<double>(at(0.99).ns) / 1e3;
+        result.bytes_per_cycle = median.cycles == 0 ? 0.0 : static_cast<double>(payload) / static_cast<double>(median.cycles);
+
+        return result;
+    }
 
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
+    inline
+    std::string format_size(std::uint64_t bytes) {
+        static const char* const units[] = {"B", "K", "M", "G", "T"};
+        std::size_t unit = 0;
+        while (bytes >= 1024 && bytes % 1024 == 0 && unit + 1 < std::size(units)) {
+            bytes /= 1024;
+            ++unit;
         }
-    };
-
-    struct ostreambyte_512 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 512;
 
-        ostreambyte_512() : m_stream("ostreambyte_512.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
-        }
+        return std::to_string(bytes) + units[unit];
+    }
 
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
+    // "4K", "64M", "4G" or plain bytes.
+    inline
+    std::uint64_t parse_size(const std::string& text) {
+        char* end = nullptr;
+        std::uint64_t value = std::strtoull(text.c_str(), &end, 10);
+        switch (end != nullptr ? *end : '\0') {
+            case 'T': case 't': value <<= 10; [[fallthrough]];
+            case 'G': case 'g': value <<= 10; [[fallthrough]];
+            case 'M': case 'm': value <<= 10; [[fallthrough]];
+            case 'K': case 'k': value <<= 10; break;
+            default: break;
         }
-    };
 
-    struct ostreambyte_1024 {
-        std::vector<std::byte> m_data;
-        std::ofstream m_stream;
-        constexpr static const std::size_t m_size = 1024;
+        return value;
+    }
+}
 
-        ostreambyte_1024() : m_stream("ostreambyte_1024.testfile", std::ios_base::binary | std::ios_base::trunc) {
-            m_data = get_data_to_write();
+// What a case runs against.
+struct context {
+    std::string input_path;      // payload bytes, written before the read cases
+    std::string output_path;     // truncated by every write sample
+    std::uint64_t payload;
+    const std::vector<std::byte>* pattern;
+    const std::vector<char>* char_pattern;
+};
+
+enum class case_kind { read, write, round_trip };
+
+struct bench_case {
+    case_kind kind;
+    std::string api;
+    std::function<void(const context&)> run;
+};
+
+// Actual operations. Readers fold every byte into a checksum so each API does the same work;
+// writers emit the payload as repeated 1 MiB patterns.
+namespace operation {
+    // Calls f(first, count) over the payload, one pattern slice at a time.
+    template <typename Function>
+    void for_each_slice(const context& ctx, Function&& f) {
+        for (std::uint64_t done = 0; done < ctx.payload;) {
+            const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(ctx.payload - done, options::pattern_size));
+            f(count);
+            done += count;
         }
+    }
 
-        void operator()() {
-            std::copy(std::begin(m_data),
-                std::end(m_data), 
-                mrt::ostreambyte_iterator<m_size>(m_stream));
+    inline
+    std::uint64_t checksum(const std::byte* data, std::size_t size) noexcept {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < size; ++i) {
+            sum += std::to_integer<unsigned>(data[i]);
         }
-    };
 
-    // istream - Requires ostream to run beforehand
-    struct istream {
-        std::vector<char> m_data;
-        std::ifstream m_stream;
-
-        istream() : m_stream("ostream.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+        return sum;
+    }
 
-        void operator()() {
-            std::copy(std::istream_iterator<char>(m_stream), 
-                std::istream_iterator<char>(), 
-                std::back_inserter(m_data));
-        }
-    };
+    template <typename Iterator>
+    void fold(Iterator first, Iterator last) {
+        std::uint64_t sum = 0;
+        std::for_each(first, last, [&sum](auto b) { sum += static_cast<unsigned char>(b); });
+        utils::g_sink = utils::g_sink + sum;
+    }
 
-    struct istreambuf {
-        std::vector<char> m_data;
-        std::ifstream m_stream;
+    inline
+    void istream(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        in >> std::noskipws;
+        fold(std::istream_iterator<char>(in), std::istream_iterator<char>());
+    }
 
-        istreambuf() : m_stream("ostreambuf.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+    inline
+    void istreambuf(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        fold(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
 
-        void operator()() {
-            std::copy(std::istreambuf_iterator<char>(m_stream), 
-                std::istreambuf_iterator<char>(), 
-                std::back_inserter(m_data));
-        }
-    };
+    template <std::size_t buf_size>
+    void istreambyte(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        fold(mrt::istreambyte_iterator<buf_size>(in), mrt::istreambyte_iterator<buf_size>());
+    }
 
-    struct istreambyte_32 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 32;
+    inline
+    void istreambuf_byte(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        fold(mrt::istreambuf_byte_iterator(in), mrt::istreambuf_byte_iterator());
+    }
 
-        istreambyte_32() : m_stream("ostreambyte_32.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
+    inline
+    void read_bytes(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        std::vector<std::byte> scratch(options::pattern_size);
+        std::uint64_t sum = 0;
+        while (const std::size_t got = mrt::read_bytes(in, scratch)) {
+            sum += checksum(scratch.data(), got);
         }
+        utils::g_sink = utils::g_sink + sum;
+    }
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
+    inline
+    void byte_chunks(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        std::uint64_t sum = 0;
+        for (const auto chunk : mrt::byte_chunks(in)) {
+            sum += checksum(chunk.data(), chunk.size());
         }
-    };
+        utils::g_sink = utils::g_sink + sum;
+    }
 
-    struct istreambyte_64 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 64;
+    inline
+    void ostream(const context& ctx) {
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        for_each_slice(ctx, [&](std::size_t count) {
+            std::copy(ctx.char_pattern->begin(), ctx.char_pattern->begin() + count, std::ostream_iterator<char>(out));
+        });
+    }
 
-        istreambyte_64() : m_stream("ostreambyte_64.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+    inline
+    void ostreambuf(const context& ctx) {
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        for_each_slice(ctx, [&](std::size_t count) {
+            std::copy(ctx.char_pattern->begin(), ctx.char_pattern->begin() + count, std::ostreambuf_iterator<char>(out));
+        });
+    }
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
-        }
-    };
+    template <std::size_t buf_size>
+    void ostreambyte(const context& ctx) {
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        for_each_slice(ctx, [&](std::size_t count) {
+            std::copy(ctx.pattern->begin(), ctx.pattern->begin() + count, mrt::ostreambyte_iterator<buf_size>(out));
+        });
+    }
 
-    struct istreambyte_128 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 128;
+    inline
+    void write_bytes(const context& ctx) {
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        for_each_slice(ctx, [&](std::size_t count) {
+            mrt::write_bytes(out, mrt::const_byte_span{ctx.pattern->data(), count});
+        });
+    }
 
-        istreambyte_128() : m_stream("ostreambyte_128.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+    template <std::size_t buf_size>
+    void round_trip(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        std::copy(mrt::istreambyte_iterator<buf_size>(in), mrt::istreambyte_iterator<buf_size>(), mrt::ostreambyte_iterator<buf_size>(out));
+    }
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
+    inline
+    void round_trip_bulk(const context& ctx) {
+        std::ifstream in(ctx.input_path, std::ios_base::binary);
+        std::ofstream out(ctx.output_path, std::ios_base::binary | std::ios_base::trunc);
+        std::vector<std::byte> scratch(options::pattern_size);
+        while (const std::size_t got = mrt::read_bytes(in, scratch)) {
+            mrt::write_bytes(out, mrt::const_byte_span{scratch.data(), got});
         }
-    };
-
-    struct istreambyte_256 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 256;
+    }
+}
 
-        istreambyte_256() : m_stream("ostreambyte_256.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+// Case registry
+namespace registry {
+    template <std::size_t buf_size>
+    void add_block_cases(std::vector<bench_case>& cases) {
+        const std::string size = std::to_string(buf_size);
+        cases.push_back({case_kind::read, "istreambyte_iterator<" + size + ">", operation::istreambyte<buf_size>});
+        cases.push_back({case_kind::write, "ostreambyte_iterator<" + size + ">", operation::ostreambyte<buf_size>});
+        cases.push_back({case_kind::round_trip, "istreambyte -> ostreambyte<" + size + ">", operation::round_trip<buf_size>});
+    }
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
-        }
-    };
+    template <std::size_t... sizes>
+    void add_sweep(std::vector<bench_case>& cases, buffer_sizes<sizes...>) {
+        (add_block_cases<sizes>(cases), ...);
+    }
 
-    struct istreambyte_512 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 512;
+    inline
+    std::vector<bench_case> all_cases() {
+        std::vector<bench_case> cases{
+            {case_kind::read, "istream_iterator<char>", operation::istream},
+            {case_kind::read, "istreambuf_iterator<char>", operation::istreambuf},
+            {case_kind::read, "istreambuf_byte_iterator", operation::istreambuf_byte},
+            {case_kind::read, "read_bytes (bulk)", operation::read_bytes},
+            {case_kind::read, "byte_chunks (chunked)", operation::byte_chunks},
+            {case_kind::write, "ostream_iterator<char>", operation::ostream},
+            {case_kind::write, "ostreambuf_iterator<char>", operation::ostreambuf},
+            {case_kind::write, "write_bytes (bulk)", operation::write_bytes},
+            {case_kind::round_trip, "read_bytes -> write_bytes (bulk)", operation::round_trip_bulk},
+        };
+        add_sweep(cases, swept_buffer_sizes{});
+
+        std::stable_sort(cases.begin(), cases.end(), [](const bench_case& a, const bench_case& b) { return a.kind < b.kind; });
+        return cases;
+    }
+}
 
-        istreambyte_512() : m_stream("ostreambyte_512.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+// Running and reporting
+namespace bootstrap {
+    inline
+    const char* kind_name(case_kind kind) {
+        return kind == case_kind::read ? "read" : kind == case_kind::write ? "write" : "round-trip";
+    }
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
+    inline
+    std::vector<utils::sample> measure(const bench_case& c, const context& ctx, bool cold, int reps) {
+        if (!cold) {
+            c.run(ctx);
         }
-    };
 
-    struct istreambyte_1024 {
-        std::vector<std::byte> m_data;
-        std::ifstream m_stream;
-        constexpr static const std::size_t m_size = 1024;
+        std::vector<utils::sample> samples;
+        samples.reserve(static_cast<std::size_t>(reps));
+        for (int i = 0; i < reps; ++i) {
+            if (cold) {
+                utils::drop_cache(ctx.input_path);
+            }
 
-        istreambyte_1024() : m_stream("ostreambyte_1024.testfile", std::ios_base::binary) {
-            m_data.reserve(g_bytes_count);
-        }
+            const auto start = std::chrono::steady_clock::now();
+            const std::uint64_t start_cycles = utils::cycles();
+            c.run(ctx);
+            if (cold && c.kind != case_kind::read) {
+                utils::sync_file(ctx.output_path);
+            }
+            const std::uint64_t end_cycles = utils::cycles();
+            const auto end = std::chrono::steady_clock::now();
 
-        void operator()() {
-            std::copy(mrt::istreambyte_iterator<m_size>(m_stream), 
-                mrt::istreambyte_iterator<m_size>(), 
-                std::back_inserter(m_data));
+            samples.push_back({static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()),
+                end_cycles - start_cycles});
         }
-    };
-}
 
-// Ease of use bootstrap to call from main
-namespace bootstrap {
-    void ostream() {
-        std::cout << "Operation: ostream_iterator:\r\n\t";
-        utils::batch_test<operation::ostream>();
-        std::cout << std::endl;
+        return samples;
     }
 
-    void ostreambuf() {
-        std::cout << "Operation: ostreambuf:\r\n\t";
-        utils::batch_test<operation::ostreambuf>();
-        std::cout << std::endl;
-    }
+    inline
+    void print_header() {
+        if (options::csv) {
+            std::cout << "kind,api,payload,cache,mb_per_s,p50_us,p90_us,p99_us,bytes_per_cycle\n";
+            return;
+        }
 
-    void ostreambyte_32() {
-        std::cout << "Operation: ostreambyte_32:\r\n\t";
-        utils::batch_test<operation::ostreambyte_32>();
-        std::cout << std::endl;
+        std::cout << std::left << std::setw(11) << "kind" << std::setw(36) << "api" << std::setw(8) << "payload"
+            << std::setw(6) << "cache" << std::right << std::setw(10) << "MB/s" << std::setw(12) << "p50 us"
+            << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(9) << "B/cycle" << '\n';
     }
 
-    void ostreambyte_64() {
-        std::cout << "Operation: ostreambyte_64:\r\n\t";
-        utils::batch_test<operation::ostreambyte_64>();
-        std::cout << std::endl;
-    }
+    inline
+    void print_row(const bench_case& c, std::uint64_t payload, bool cold, const utils::summary& s) {
+        const char* cache = cold ? "cold" : "warm";
+        if (options::csv) {
+            std::cout << kind_name(c.kind) << ",\"" << c.api << "\"," << payload << ',' << cache << ',' << s.mb_per_s << ','
+                << s.p50_us << ',' << s.p90_us << ',' << s.p99_us << ',' << s.bytes_per_cycle << '\n';
+            return;
+        }
 
-    void ostreambyte_128() {
-        std::cout << "Operation: ostreambyte_128:\r\n\t";
-        utils::batch_test<operation::ostreambyte_128>();
-        std::cout << std::endl;
+        std::cout << std::left << std::setw(11) << kind_name(c.kind) << std::setw(36) << c.api << std::setw(8)
+            << utils::format_size(payload) << std::setw(6) << cache << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << s.mb_per_s << std::setw(12) << s.p50_us << std::setw(12) << s.p90_us
+            << std::setw(12) << s.p99_us << std::setprecision(3) << std::setw(9) << s.bytes_per_cycle << '\n';
     }
 
-    void ostreambyte_256() {
-        std::cout << "Operation: ostreambyte_256:\r\n\t";
-        utils::batch_test<operation::ostreambyte_256>();
-        std::cout << std::endl;
+    inline
+    void write_input(const context& ctx) {
+        std::ofstream out(ctx.input_path, std::ios_base::binary | std::ios_base::trunc);
+        operation::for_each_slice(ctx, [&](std::size_t count) {
+            mrt::write_bytes(out, mrt::const_byte_span{ctx.pattern->data(), count});
+        });
     }
 
-    void ostreambyte_512() {
-        std::cout << "Operation: ostreambyte_512:\r\n\t";
-        utils::batch_test<operation::ostreambyte_512>();
-        std::cout << std::endl;
-    }
+    inline
+    bool parse_arguments(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--min" && has_value) {
+                options::min_payload = std::max<std::uint64_t>(utils::parse_size(argv[++i]), 1);
+            } else if (arg == "--max" && has_value) {
+                options::max_payload = utils::parse_size(argv[++i]);
+            } else if (arg == "--reps" && has_value) {
+                options::reps = std::max(std::atoi(argv[++i]), 1);
+            } else if (arg == "--cache" && has_value) {
+                const std::string mode = argv[++i];
+                options::warm = mode != "cold";
+                options::cold = mode != "warm";
+            } else if (arg == "--filter" && has_value) {
+                options::filter = argv[++i];
+            } else if (arg == "--dir" && has_value) {
+                options::dir = argv[++i];
+            } else if (arg == "--csv") {
+                options::csv = true;
+            } else {
+                std::cerr << "usage: " << argv[0]
+                    << " [--min 4K] [--max 64M] [--reps 15] [--cache warm|cold|both] [--filter text] [--dir path] [--csv]\n";
+                return false;
+            }
+        }
 
-    void ostreambyte_1024() {
-        std::cout << "Operation: ostreambyte_1024:\r\n\t";
-        utils::batch_test<operation::ostreambyte_1024>();
-        std::cout << std::endl;
+#ifndef MRT_BENCH_COLD_CACHE
+        if (options::cold) {
+            std::cerr << "cold page cache runs need posix_fadvise; running warm only.\n";
+            options::cold = false;
+            options::warm = true;
+        }
+#endif
+        return true;
     }
+}
 
-    void istream() {
-        std::cout << "Operation: istream:\r\n\t";
-        utils::batch_test<operation::istream>();
-        std::cout << std::endl;
+int main(int argc, char** argv) {
+    if (!bootstrap::parse_arguments(argc, argv)) {
+        return 1;
     }
 
-    void istreambuf() {
-        std::cout << "Operation: istreambuf:\r\n\t";
-        utils::batch_test<operation::istreambuf>();
-        std::cout << std::endl;
+    std::vector<std::byte> pattern(options::pattern_size);
+    std::vector<char> char_pattern(options::pattern_size);
+    for (std::size_t i = 0; i < options::pattern_size; ++i) {
+        // Not just 0..9: the payload must look like binary data, whitespace and 0xFF included.
+        pattern[i] = static_cast<std::byte>((i * 131) % 256);
+        char_pattern[i] = static_cast<char>(pattern[i]);
     }
 
-    void istreambyte_32() {
-        std::cout << "Operation: istreambyte_32:\r\n\t";
-        utils::batch_test<operation::istreambyte_32>();
-        std::cout << std::endl;
-    }
+    const std::vector<bench_case> cases = registry::all_cases();
+    bootstrap::print_header();
 
-    void istreambyte_64() {
-        std::cout << "Operation: istreambyte_64:\r\n\t";
-        utils::batch_test<operation::istreambyte_64>();
-        std::cout << std::endl;
-    }
+    for (std::uint64_t payload = options::min_payload; payload <= options::max_payload; payload *= 16) {
+        const context ctx{options::dir + "/bench_input.testfile", options::dir + "/bench_output.testfile", payload, &pattern, &char_pattern};
+        bootstrap::write_input(ctx);
 
-    void istreambyte_128() {
-        std::cout << "Operation: istreambyte_128:\r\n\t";
-        utils::batch_test<operation::istreambyte_128>();
-        std::cout << std::endl;
-    }
+        const auto scaled = static_cast<std::uint64_t>(options::reps) * std::max<std::uint64_t>(1, options::pattern_size / payload);
+        const int reps = static_cast<int>(std::min<std::uint64_t>(scaled, std::max(options::reps, options::max_reps)));
 
-    void istreambyte_256() {
-        std::cout << "Operation: istreambyte_256:\r\n\t";
-        utils::batch_test<operation::istreambyte_256>();
-        std::cout << std::endl;
-    }
+        for (const bench_case& c : cases) {
+            if (!options::filter.empty() && c.api.find(options::filter) == std::string::npos) {
+                continue;
+            }
 
-    void istreambyte_512() {
-        std::cout << "Operation: istreambyte_512:\r\n\t";
-        utils::batch_test<operation::istreambyte_512>();
-        std::cout << std::endl;
-    }
+            for (const bool cold : {false, true}) {
+                if ((cold && !options::cold) || (!cold && !options::warm)) {
+                    continue;
+                }
 
-    void istreambyte_1024() {
-        std::cout << "Operation: istreambyte_1024:\r\n\t";
-        utils::batch_test<operation::istreambyte_1024>();
-        std::cout << std::endl;
+                bootstrap::print_row(c, payload, cold, utils::summarize(bootstrap::measure(c, ctx, cold, reps), payload));
+            }
+        }
     }
-}
-
-int main() {
-    print_abstract();
-
-    bootstrap::ostream();
-    bootstrap::ostreambuf();
-    bootstrap::ostreambyte_32();
-    bootstrap::ostreambyte_64();
-    bootstrap::ostreambyte_128();
-    bootstrap::ostreambyte_256();
-    bootstrap::ostreambyte_512();
-    bootstrap::ostreambyte_1024();
-
-    std::cout << "\r\n" << std::endl;
-
-    bootstrap::istream();
-    bootstrap::istreambuf();
-    bootstrap::istreambyte_32();
-    bootstrap::istreambyte_64();
-    bootstrap::istreambyte_128();
-    bootstrap::istreambyte_256();
-    bootstrap::istreambyte_512();
-    bootstrap::istreambyte_1024();
 
+    std::remove((options::dir + "/bench_input.testfile").c_str());
+    std::remove((options::dir + "/bench_output.testfile").c_str());
     return 0;
-}
\ No newline at end of file
+}
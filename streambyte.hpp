@@ -22,13 +22,45 @@
 #ifndef MRT_STREAMBYTE_HPP_
 #define MRT_STREAMBYTE_HPP_
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <istream>
 #include <iterator>
+#include <memory>
+#include <new>
 #include <streambuf>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
+#ifdef __cpp_lib_ranges
+#include <ranges>
+#endif
+
+#if defined(__cpp_lib_bitops)
+#include <bit>
+#endif
 
 #ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cpp_lib_hardware_interference_size
 #define MRT_HARDWARE_CI_SIZE std::hardware_constructive_interference_size
 #else
 #define MRT_HARDWARE_CI_SIZE 64
@@ -36,9 +68,299 @@
 
 namespace mrt {
 
+#ifdef __cpp_lib_span
+using byte_span = std::span<std::byte>;
+using const_byte_span = std::span<const std::byte>;
+#else
+// Minimal stand-in for std::span<T> until C++20 is available.
+template <typename T>
+class basic_byte_span {
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using size_type = std::size_t;
+    using pointer = T*;
+    using reference = T&;
+    using iterator = T*;
+
+    constexpr
+    basic_byte_span() noexcept
+        : m_data{nullptr}, m_size{0}
+    { }
+
+    constexpr
+    basic_byte_span(pointer data, size_type size) noexcept
+        : m_data{data}, m_size{size}
+    { }
+
+    constexpr
+    basic_byte_span(pointer first, pointer last) noexcept
+        : m_data{first}, m_size{static_cast<size_type>(last - first)}
+    { }
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+    constexpr
+    basic_byte_span(const basic_byte_span<U>& rhs) noexcept
+        : m_data{rhs.data()}, m_size{rhs.size()}
+    { }
+
+    template <typename Container, typename = std::enable_if_t<
+        std::is_convertible_v<std::remove_pointer_t<decltype(std::data(std::declval<Container&>()))>(*)[], T(*)[]>>>
+    constexpr
+    basic_byte_span(Container& container) noexcept
+        : m_data{std::data(container)}, m_size{std::size(container)}
+    { }
+
+    [[nodiscard]] constexpr pointer data() const noexcept { return m_data; }
+    [[nodiscard]] constexpr size_type size() const noexcept { return m_size; }
+    [[nodiscard]] constexpr bool empty() const noexcept { return m_size == 0; }
+    [[nodiscard]] constexpr iterator begin() const noexcept { return m_data; }
+    [[nodiscard]] constexpr iterator end() const noexcept { return m_data + m_size; }
+    [[nodiscard]] constexpr reference operator[](size_type i) const noexcept { return m_data[i]; }
+
+    [[nodiscard]] constexpr
+    basic_byte_span first(size_type count) const noexcept {
+        return {m_data, count};
+    }
+
+    [[nodiscard]] constexpr
+    basic_byte_span subspan(size_type offset, size_type count = static_cast<size_type>(-1)) const noexcept {
+        return {m_data + offset, count == static_cast<size_type>(-1) ? m_size - offset : count};
+    }
+
+private:
+    pointer m_data;
+    size_type m_size;
+};
+
+using byte_span = basic_byte_span<std::byte>;
+using const_byte_span = basic_byte_span<const std::byte>;
+#endif
+
+namespace detail {
+    // Byte order and bit helpers shared by the block level parsers.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    inline constexpr bool host_is_big_endian = true;
+#else
+    inline constexpr bool host_is_big_endian = false;
+#endif
+
+    [[nodiscard]] inline
+    std::uint16_t byteswap(std::uint16_t value) noexcept {
+#if defined(_MSC_VER)
+        return _byteswap_ushort(value);
+#else
+        return __builtin_bswap16(value);
+#endif
+    }
+
+    [[nodiscard]] inline
+    std::uint32_t byteswap(std::uint32_t value) noexcept {
+#if defined(_MSC_VER)
+        return _byteswap_ulong(value);
+#else
+        return __builtin_bswap32(value);
+#endif
+    }
+
+    [[nodiscard]] inline
+    std::uint64_t byteswap(std::uint64_t value) noexcept {
+#if defined(_MSC_VER)
+        return _byteswap_uint64(value);
+#else
+        return __builtin_bswap64(value);
+#endif
+    }
+
+    [[nodiscard]] inline
+    std::uint64_t load_le64(const std::byte* p) noexcept {
+        std::uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return host_is_big_endian ? byteswap(value) : value;
+    }
+
+    [[nodiscard]] inline
+    std::uint32_t load_le32(const std::byte* p) noexcept {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return host_is_big_endian ? byteswap(value) : value;
+    }
+
+    // value must not be 0.
+    [[nodiscard]] inline
+    unsigned count_trailing_zeros(std::uint64_t value) noexcept {
+#if defined(__cpp_lib_bitops)
+        return static_cast<unsigned>(std::countr_zero(value));
+#elif defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward64(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+    }
+
+    template <typename T>
+    struct type_identity {
+        using type = T;
+    };
+
+    template <typename T>
+    using type_identity_t = typename type_identity<T>::type;
+
+    // Grants the bulk helpers access to the iterators' block internals.
+    struct block_access;
+}
+
+// Where istreambyte_iterator<N, Source> takes its blocks from. A source is cheap to copy and provides
+//     std::size_t read(char* dest, std::size_t count);   // fewer than count only at the end
+//     explicit operator bool() const;                    // false for an empty (default constructed) source
+// The policy is a template parameter, so reads bind statically instead of through a virtual call.
+class streambuf_source {
+public:
+    using streambuf_type = std::basic_streambuf<char>;
+
+public:
+    constexpr
+    streambuf_source() noexcept
+        : m_streambuf{nullptr}
+    { }
+
+    constexpr explicit
+    streambuf_source(streambuf_type* streambuf) noexcept
+        : m_streambuf{streambuf}
+    { }
+
+public:
+    std::size_t read(char* dest, std::size_t count) {
+        return static_cast<std::size_t>(m_streambuf->sgetn(dest, static_cast<std::streamsize>(count)));
+    }
+
+    [[nodiscard]] constexpr explicit
+    operator bool() const noexcept {
+        return m_streambuf != nullptr;
+    }
+
+    [[nodiscard]] constexpr
+    streambuf_type* streambuf() const noexcept {
+        return m_streambuf;
+    }
+
+private:
+    streambuf_type* m_streambuf;
+};
+
+// Bytes already in memory (a vector, a network buffer, a mapped_bytes::span()).
+// istreambyte_iterator<N, span_source> walks them in place: no block, no copy, no call per block.
+class span_source {
+public:
+    constexpr
+    span_source() noexcept = default;
+
+    constexpr explicit
+    span_source(const_byte_span bytes) noexcept
+        : m_bytes{bytes}
+    { }
+
+public:
+    std::size_t read(char* dest, std::size_t count) noexcept {
+        count = std::min(count, m_bytes.size());
+        std::memcpy(dest, m_bytes.data(), count);
+        m_bytes = m_bytes.subspan(count);
+
+        return count;
+    }
+
+    [[nodiscard]] constexpr explicit
+    operator bool() const noexcept {
+        return !m_bytes.empty();
+    }
+
+    [[nodiscard]] constexpr
+    const_byte_span bytes() const noexcept {
+        return m_bytes;
+    }
+
+private:
+    const_byte_span m_bytes;
+};
+
+// Where ostreambyte_iterator<N, Sink> writes its blocks to. Same idea as the sources:
+//     std::size_t write(const char* data, std::size_t count);   // fewer than count means failure
+//     explicit operator bool() const;
+class streambuf_sink {
+public:
+    using streambuf_type = std::basic_streambuf<char>;
+
+public:
+    constexpr
+    streambuf_sink() noexcept
+        : m_streambuf{nullptr}
+    { }
+
+    constexpr explicit
+    streambuf_sink(streambuf_type* streambuf) noexcept
+        : m_streambuf{streambuf}
+    { }
+
+public:
+    std::size_t write(const char* data, std::size_t count) {
+        return static_cast<std::size_t>(m_streambuf->sputn(data, static_cast<std::streamsize>(count)));
+    }
+
+    [[nodiscard]] constexpr explicit
+    operator bool() const noexcept {
+        return m_streambuf != nullptr;
+    }
+
+    [[nodiscard]] constexpr
+    streambuf_type* streambuf() const noexcept {
+        return m_streambuf;
+    }
+
+private:
+    streambuf_type* m_streambuf;
+};
+
+// Fixed memory as a sink. ostreambyte_iterator<N, span_sink> stores straight into it;
+// writing past its end fails.
+class span_sink {
+public:
+    constexpr
+    span_sink() noexcept = default;
+
+    constexpr explicit
+    span_sink(byte_span bytes) noexcept
+        : m_bytes{bytes}
+    { }
+
+public:
+    std::size_t write(const char* data, std::size_t count) noexcept {
+        count = std::min(count, m_bytes.size());
+        std::memcpy(m_bytes.data(), data, count);
+        m_bytes = m_bytes.subspan(count);
+
+        return count;
+    }
+
+    [[nodiscard]] constexpr explicit
+    operator bool() const noexcept {
+        return m_bytes.data() != nullptr;
+    }
+
+    // What is left to write into.
+    [[nodiscard]] constexpr
+    byte_span bytes() const noexcept {
+        return m_bytes;
+    }
+
+private:
+    byte_span m_bytes;
+};
+
 // Iterator for byte reading from istream.
 // Optimized to read by blocks.
-template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE>
+template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE, typename Source = streambuf_source>
 class istreambyte_iterator {
 public:
     using byte_type = std::byte;
@@ -46,42 +368,42 @@ public:
     using value_type = byte_type;
     using pointer = const byte_type*;
     using reference = byte_type;
-    using difference_type = char;
+    using difference_type = std::ptrdiff_t;
 
     using int_type = char;
     using traits_type = std::char_traits<int_type>;
     using streambuf_type = std::basic_streambuf<int_type, traits_type>;
     using istream_type = std::basic_istream<int_type, traits_type>;
+    using source_type = Source;
 
 private:
     using size_type = std::size_t;
     using array_type = std::array<int_type, buf_size>;
 
 private:
+    // Result of post-increment: only holds the delivered byte (*it++).
+    // The block stays with the iterator; shared_istreambyte_iterator can be rebuilt from its proxy.
     class istreambyte_proxy {
     public:
         [[nodiscard]] constexpr
         byte_type operator*() const noexcept {
-            return m_buf[m_buf_pos];
+            return m_value;
         }
 
     private:
         friend istreambyte_iterator;
-        istreambyte_proxy(size_type to_read, size_type buf_pos, 
-            array_type& buf, streambuf_type* streambuf) noexcept
-            : m_to_read{to_read}, m_buf_pos{buf_pos}, m_streambuf{streambuf}, m_buf{buf}
+        constexpr
+        istreambyte_proxy(byte_type value) noexcept
+            : m_value{value}
         { }
         
-        size_type m_to_read;
-        size_type m_buf_pos;
-        streambuf_type* m_streambuf;
-        array_type& m_buf;
+        byte_type m_value;
     };
 
 public:
     constexpr
     istreambyte_iterator() noexcept
-        : m_to_read{0}, m_buf_pos{0}, m_streambuf{nullptr}, m_buf{0}
+        : m_to_read{0}, m_buf_pos{0}, m_source{}, m_buf{0}
     { }
 
     istreambyte_iterator(istream_type& stream)
@@ -89,17 +411,16 @@ public:
     { }
 
     istreambyte_iterator(streambuf_type* sb)
-        : m_to_read{0}, m_buf_pos{0}, m_streambuf{sb}, m_buf{0}
+        : istreambyte_iterator(Source{sb})
+    { }
+
+    // Non-deduced, so class template argument deduction still picks the stream constructors.
+    explicit istreambyte_iterator(detail::type_identity_t<Source> source)
+        : m_to_read{0}, m_buf_pos{0}, m_source{std::move(source)}, m_buf{0}
     { 
-        if (m_streambuf) {
-            _read_block();
-        }
+        _read_block();
     }
 
-    istreambyte_iterator(const istreambyte_proxy& proxy) noexcept
-        : m_to_read{proxy.m_to_read}, m_buf_pos{proxy.m_buf_pos}, m_streambuf{proxy.m_streambuf}
-    { }
-
 public:
     [[nodiscard]] constexpr
     byte_type operator*() const {
@@ -113,7 +434,7 @@ public:
     }
 
     istreambyte_proxy operator++(int) {
-        istreambyte_proxy tmp{ --m_to_read, m_buf_pos, m_buf, m_streambuf };
+        istreambyte_proxy tmp{ _value() };
         ++*this;
 
         return tmp;
@@ -121,12 +442,37 @@ public:
 
     [[nodiscard]]
     bool equal(const istreambyte_iterator& lrs) const {
-        // both streambuf null = finished reading blocks; + none left to read = finished.
-        return (m_streambuf == nullptr && m_to_read == 0 && lrs.m_streambuf == nullptr) 
-            || (m_streambuf != nullptr && lrs.m_streambuf != nullptr);
+        // An empty block means the stream is exhausted; any two live iterators compare equal.
+        return _at_end() == lrs._at_end();
+    }
+
+#ifdef __cpp_lib_ranges
+    // End of stream as std::default_sentinel: a single check on this iterator alone.
+    [[nodiscard]] friend
+    bool operator==(const istreambyte_iterator& it, std::default_sentinel_t) noexcept {
+        return it._at_end();
+    }
+#endif
+
+    // Bytes available without further I/O, starting at *it. Only empty once the stream is exhausted.
+    [[nodiscard]]
+    const_byte_span buffered() const noexcept {
+        return {reinterpret_cast<const byte_type*>(m_buf.data() + m_buf_pos), m_to_read};
+    }
+
+    // Skips count <= buffered().size() bytes, reading the next block once this one is used up.
+    void consume(size_type count) {
+        m_buf_pos += count;
+        m_to_read -= count;
+
+        if (m_to_read == 0) {
+            _read_block();
+        }
     }
 
 private:
+    friend detail::block_access;
+
     // Next value to deliver
     [[nodiscard]] constexpr
     byte_type _value() const noexcept {
@@ -139,160 +485,1575 @@ private:
         return m_buf[m_buf_pos];
     }
 
+    [[nodiscard]] constexpr
+    bool _at_end() const noexcept {
+        return m_to_read == 0;
+    }
+
     // Equivalent to sbumpc but for a block.
-    [[nodiscard]]
-    int_type _bump() const {
+    void _increment() {
+        if (_at_end()) {
+            return;
+        }
+
         ++m_buf_pos;
         --m_to_read;
 
-        if (m_buf_pos >= buf_size) {
+        if (m_to_read == 0) {
             _read_block();
         }
-
-        return _current();
     }
 
-    void _increment() {	
-        if ( (m_streambuf == nullptr && m_to_read == 0) || traits_type::eq_int_type(traits_type::eof(), _bump())) {
-            m_streambuf = nullptr;
+    // Moves up to count bytes into dest: what is left of the block first, then straight from
+    // the source without staging through m_buf. Returns the number of bytes moved.
+    size_type _read_into(int_type* dest, size_type count) {
+        size_type done = std::min(count, m_to_read);
+        std::memcpy(dest, m_buf.data() + m_buf_pos, done);
+        m_buf_pos += done;
+        m_to_read -= done;
+
+        if (done < count && m_source) {
+            const size_type wanted = count - done;
+            const size_type got = m_source.read(dest + done, wanted);
+            done += got;
+
+            if (got < wanted) {
+                m_source = Source{};
+            }
         }
+
+        if (m_to_read == 0) {
+            _read_block();
+        }
+
+        return done;
     }
 
     void _read_block() const {
         m_buf_pos = 0;
-        m_to_read = static_cast<size_type>(m_streambuf->sgetn(m_buf.data(), buf_size));
+        m_to_read = 0;
+
+        if (!m_source) {
+            return;
+        }
+
+        m_to_read = m_source.read(m_buf.data(), buf_size);
 
         if (m_to_read < buf_size) {
-            m_streambuf = nullptr;
+            m_source = Source{};
         }
     }
 
 private:
     mutable size_type m_to_read;
     mutable size_type m_buf_pos;
-    mutable streambuf_type* m_streambuf;
-    mutable array_type m_buf;
+    mutable Source m_source;
+    // Cache line aligned so a block never straddles more lines than it needs to.
+    alignas(MRT_HARDWARE_CI_SIZE) mutable array_type m_buf;
 };
 
-template<std::size_t buf_size>
-inline
-bool operator==(const istreambyte_iterator<buf_size>& lhs, const istreambyte_iterator<buf_size>& lrs) noexcept
-{
-    return lhs.equal(lrs);
-}
-
-template<std::size_t buf_size>
-inline
-bool operator!=(const istreambyte_iterator<buf_size>& lhs, const istreambyte_iterator<buf_size>& lrs) noexcept
-{
-    return !lhs.equal(lrs);
-}
-
-// Outbut streambyte iterator to write to a streambuf. 
-// Uses an internal buffer and flushes only when full or on object deallocation
-template<std::size_t buf_size = MRT_HARDWARE_CI_SIZE>
-class ostreambyte_iterator {
+// Memory needs no block: the iterator is a pointer walk over the span, buf_size is unused.
+template <std::size_t buf_size>
+class istreambyte_iterator<buf_size, span_source> {
 public:
-    using iterator_category = std::output_iterator_tag;
-    using value_type = void;
-    using difference_type = void;
-    using pointer = void;
-    using reference = void;
+    using byte_type = std::byte;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = byte_type;
+    using pointer = const byte_type*;
+    using reference = byte_type;
+    using difference_type = std::ptrdiff_t;
 
-    using char_type = char;
-    using traits_type = std::char_traits<char_type>;
-    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
-    using ostream_type = std::basic_ostream<char_type, traits_type>;
+    using int_type = char;
+    using traits_type = std::char_traits<int_type>;
+    using source_type = span_source;
 
 private:
-    using byte_type = std::byte;
-    using array_type = std::array<char_type, buf_size>;
     using size_type = std::size_t;
 
+    class istreambyte_proxy {
+    public:
+        [[nodiscard]] constexpr
+        byte_type operator*() const noexcept {
+            return m_value;
+        }
+
+    private:
+        friend istreambyte_iterator;
+        constexpr
+        istreambyte_proxy(byte_type value) noexcept
+            : m_value{value}
+        { }
+
+        byte_type m_value;
+    };
+
 public:
-    ostreambyte_iterator(streambuf_type* streambuf) noexcept
-        : m_failure{false}, m_streambuf{streambuf}, m_buf_pos{0}, m_buf{}
+    constexpr
+    istreambyte_iterator() noexcept
+        : m_first{nullptr}, m_last{nullptr}
     { }
 
-    ostreambyte_iterator(ostream_type& stream) noexcept
-        : ostreambyte_iterator{stream.rdbuf()}
+    constexpr explicit
+    istreambyte_iterator(span_source source) noexcept
+        : m_first{source.bytes().data()}, m_last{source.bytes().data() + source.bytes().size()}
     { }
 
-    ostreambyte_iterator(const ostreambyte_iterator& rhs)
-        : m_failure{rhs.m_failure}, m_streambuf{rhs.m_streambuf}, m_buf_pos{0}, m_buf{}
-    {
-        const_cast<ostreambyte_iterator&>(rhs)._commit();
-        const_cast<ostreambyte_iterator&>(rhs)._clear_buffer();
-    }
+    constexpr explicit
+    istreambyte_iterator(const_byte_span bytes) noexcept
+        : istreambyte_iterator(span_source{bytes})
+    { }
 
-    ~ostreambyte_iterator() {
-        _commit();
+public:
+    [[nodiscard]] constexpr
+    byte_type operator*() const noexcept {
+        return *m_first;
     }
 
-    ostreambyte_iterator& operator=(byte_type rhs) {
-        if (m_streambuf == nullptr || traits_type::eq_int_type(traits_type::eof(), _put(static_cast<char_type>(rhs)))) {
-            m_failure = true;
-        }
+    constexpr
+    istreambyte_iterator& operator++() noexcept {
+        ++m_first;
 
         return *this;
     }
 
-    [[nodiscard]]
-    ostreambyte_iterator& operator*() noexcept {
-        return *this;
+    constexpr
+    istreambyte_proxy operator++(int) noexcept {
+        return istreambyte_proxy{*m_first++};
     }
 
-    ostreambyte_iterator& operator++() noexcept {
-        return *this;
+    [[nodiscard]] constexpr
+    bool equal(const istreambyte_iterator& lrs) const noexcept {
+        return _at_end() == lrs._at_end();
     }
 
-    ostreambyte_iterator& operator++(int) noexcept {
-        return *this;
+#ifdef __cpp_lib_ranges
+    // Same as istreambyte_iterator's default_sentinel comparison.
+    [[nodiscard]] friend
+    bool operator==(const istreambyte_iterator& it, std::default_sentinel_t) noexcept {
+        return it._at_end();
     }
+#endif
 
     [[nodiscard]] constexpr
-    bool failed() const noexcept {
-        return m_failure;
+    const_byte_span buffered() const noexcept {
+        return {m_first, static_cast<size_type>(m_last - m_first)};
     }
 
-private:
-    bool _commit() {
-        std::streamsize current_size = static_cast<std::streamsize>(_buf_size());
-        return m_streambuf->sputn(m_buf.data(), current_size) == current_size;
+    constexpr
+    void consume(size_type count) noexcept {
+        m_first += count;
     }
 
-    char_type _put(char_type c) {
-        m_buf[m_buf_pos] = c;
-        ++m_buf_pos;
+private:
+    friend detail::block_access;
 
-        if (_buf_size() == buf_size) {
-            if (!_commit()) {
-                c = static_cast<char_type>(traits_type::eof());
+    [[nodiscard]] constexpr
+    bool _at_end() const noexcept {
+        return m_first == m_last;
+    }
+
+    size_type _read_into(int_type* dest, size_type count) noexcept {
+        count = std::min(count, static_cast<size_type>(m_last - m_first));
+        std::memcpy(dest, m_first, count);
+        m_first += count;
+
+        return count;
+    }
+
+private:
+    const byte_type* m_first;
+    const byte_type* m_last;
+};
+
+template<std::size_t buf_size, typename Source>
+inline
+bool operator==(const istreambyte_iterator<buf_size, Source>& lhs, const istreambyte_iterator<buf_size, Source>& lrs) noexcept
+{
+    return lhs.equal(lrs);
+}
+
+template<std::size_t buf_size, typename Source>
+inline
+bool operator!=(const istreambyte_iterator<buf_size, Source>& lhs, const istreambyte_iterator<buf_size, Source>& lrs) noexcept
+{
+    return !lhs.equal(lrs);
+}
+
+// Pointer walk over bytes in memory with the istreambyte_iterator interface.
+using span_byte_iterator = istreambyte_iterator<MRT_HARDWARE_CI_SIZE, span_source>;
+
+namespace detail {
+    // basic_streambuf keeps its get area protected. Member pointers formed through a derived
+    // class may legally be applied to any streambuf, which lets iterators walk it in place.
+    struct get_area_access : std::basic_streambuf<char> {
+        static char* current(std::basic_streambuf<char>* sb) noexcept {
+            return (sb->*(&get_area_access::gptr))();
+        }
+
+        static char* end(std::basic_streambuf<char>* sb) noexcept {
+            return (sb->*(&get_area_access::egptr))();
+        }
+
+        static void advance(std::basic_streambuf<char>* sb, std::size_t count) noexcept {
+            (sb->*(&get_area_access::gbump))(static_cast<int>(count));
+        }
+    };
+}
+
+// Iterator for byte reading from a streambuf without a private buffer.
+// Walks the streambuf's own get area and only calls underflow() once it is exhausted,
+// so bytes are not copied a second time and the stream position always matches the iterator.
+class istreambuf_byte_iterator {
+public:
+    using byte_type = std::byte;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = byte_type;
+    using pointer = const byte_type*;
+    using reference = byte_type;
+    using difference_type = std::ptrdiff_t;
+
+    using int_type = char;
+    using traits_type = std::char_traits<int_type>;
+    using streambuf_type = std::basic_streambuf<int_type, traits_type>;
+    using istream_type = std::basic_istream<int_type, traits_type>;
+
+private:
+    using size_type = std::size_t;
+    using access = detail::get_area_access;
+
+    class istreambuf_byte_proxy {
+    public:
+        [[nodiscard]] constexpr
+        byte_type operator*() const noexcept {
+            return m_value;
+        }
+
+    private:
+        friend istreambuf_byte_iterator;
+        constexpr
+        istreambuf_byte_proxy(byte_type value, streambuf_type* streambuf) noexcept
+            : m_value{value}, m_streambuf{streambuf}
+        { }
+
+        byte_type m_value;
+        streambuf_type* m_streambuf;
+    };
+
+public:
+    constexpr
+    istreambuf_byte_iterator() noexcept
+        : m_streambuf{nullptr}, m_unbuffered{false}, m_peek{0}
+    { }
+
+    istreambuf_byte_iterator(istream_type& stream)
+        : istreambuf_byte_iterator(stream.rdbuf())
+    { }
+
+    istreambuf_byte_iterator(streambuf_type* sb)
+        : m_streambuf{sb}, m_unbuffered{false}, m_peek{0}
+    {
+        _fill();
+    }
+
+    istreambuf_byte_iterator(const istreambuf_byte_proxy& proxy)
+        : istreambuf_byte_iterator(proxy.m_streambuf)
+    { }
+
+public:
+    [[nodiscard]]
+    byte_type operator*() const noexcept {
+        return static_cast<byte_type>(m_unbuffered ? m_peek : *access::current(m_streambuf));
+    }
+
+    istreambuf_byte_iterator& operator++() {
+        _increment();
+
+        return *this;
+    }
+
+    istreambuf_byte_proxy operator++(int) {
+        istreambuf_byte_proxy tmp{ **this, m_streambuf };
+        ++*this;
+
+        return tmp;
+    }
+
+    [[nodiscard]]
+    bool equal(const istreambuf_byte_iterator& lrs) const noexcept {
+        return _at_end() == lrs._at_end();
+    }
+
+#ifdef __cpp_lib_ranges
+    // Same as istreambyte_iterator's default_sentinel comparison.
+    [[nodiscard]] friend
+    bool operator==(const istreambuf_byte_iterator& it, std::default_sentinel_t) noexcept {
+        return it._at_end();
+    }
+#endif
+
+    // Same contract as istreambyte_iterator::buffered(): here it is the streambuf's get area.
+    [[nodiscard]]
+    const_byte_span buffered() const noexcept {
+        if (_at_end()) {
+            return {};
+        }
+
+        if (m_unbuffered) {
+            return {reinterpret_cast<const byte_type*>(&m_peek), 1};
+        }
+
+        return {reinterpret_cast<const byte_type*>(access::current(m_streambuf)), _window_size()};
+    }
+
+    // Without a get area the window is the single peeked byte, so it is bumped one at a time;
+    // consume(0) leaves the stream where it is.
+    void consume(size_type count) {
+        while (count != 0 && !_at_end()) {
+            if (m_unbuffered) {
+                m_streambuf->sbumpc();
+                --count;
+            } else {
+                const size_type step = std::min(count, _window_size());
+                access::advance(m_streambuf, step);
+                count -= step;
+            }
+
+            _fill();
+        }
+    }
+
+private:
+    friend detail::block_access;
+
+    [[nodiscard]] constexpr
+    bool _at_end() const noexcept {
+        return m_streambuf == nullptr;
+    }
+
+    [[nodiscard]]
+    size_type _window_size() const noexcept {
+        return m_unbuffered ? 0 : static_cast<size_type>(access::end(m_streambuf) - access::current(m_streambuf));
+    }
+
+    void _increment() {
+        if (_at_end()) {
+            return;
+        }
+
+        consume(1);
+    }
+
+    // Same contract as istreambyte_iterator::_read_into: the window first, then sgetn.
+    size_type _read_into(int_type* dest, size_type count) {
+        if (_at_end()) {
+            return 0;
+        }
+
+        size_type done = std::min(count, _window_size());
+        if (done != 0) {
+            std::memcpy(dest, access::current(m_streambuf), done);
+            access::advance(m_streambuf, done);
+        }
+
+        if (done < count) {
+            done += static_cast<size_type>(m_streambuf->sgetn(dest + done, static_cast<std::streamsize>(count - done)));
+        }
+
+        _fill();
+        return done;
+    }
+
+    // Makes sure there is a byte to deliver; underflows only when the get area is exhausted.
+    void _fill() {
+        if (_at_end()) {
+            return;
+        }
+
+        if (access::current(m_streambuf) != access::end(m_streambuf)) {
+            m_unbuffered = false;
+            return;
+        }
+
+        const auto next = m_streambuf->sgetc();
+        if (traits_type::eq_int_type(traits_type::eof(), next)) {
+            m_streambuf = nullptr;
+            return;
+        }
+
+        // Some streambufs (e.g. stdio synced ones) deliver characters without a get area.
+        m_unbuffered = access::current(m_streambuf) == access::end(m_streambuf);
+        m_peek = traits_type::to_char_type(next);
+    }
+
+private:
+    streambuf_type* m_streambuf;
+    bool m_unbuffered;
+    int_type m_peek;
+};
+
+inline
+bool operator==(const istreambuf_byte_iterator& lhs, const istreambuf_byte_iterator& lrs) noexcept
+{
+    return lhs.equal(lrs);
+}
+
+inline
+bool operator!=(const istreambuf_byte_iterator& lhs, const istreambuf_byte_iterator& lrs) noexcept
+{
+    return !lhs.equal(lrs);
+}
+
+// Iterator for byte reading from istream, with the block kept in a separately allocated state.
+// Copies share that state, so they are pointer sized and the block size is picked at runtime.
+// The allocator is used for the state and its block, which lets a pool recycle them.
+template <typename Alloc = std::allocator<char>>
+class shared_istreambyte_iterator {
+public:
+    using byte_type = std::byte;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = byte_type;
+    using pointer = const byte_type*;
+    using reference = byte_type;
+    using difference_type = std::ptrdiff_t;
+
+    using int_type = char;
+    using traits_type = std::char_traits<int_type>;
+    using streambuf_type = std::basic_streambuf<int_type, traits_type>;
+    using istream_type = std::basic_istream<int_type, traits_type>;
+    using allocator_type = Alloc;
+
+    static constexpr std::size_t default_block_size = std::size_t{1} << 16;
+
+private:
+    using size_type = std::size_t;
+
+    // Single threaded reference count: iterators are not meant to be shared across threads.
+    struct state {
+        using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<state>;
+        using buffer_allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<int_type>;
+
+        state(streambuf_type* sb, size_type size, const Alloc& alloc)
+            : m_refs{1}, m_to_read{0}, m_buf_pos{0}, m_block_size{size}, m_streambuf{sb},
+              m_alloc{alloc}, m_buf{std::allocator_traits<buffer_allocator_type>::allocate(m_alloc, size)}
+        { }
+
+        ~state() {
+            std::allocator_traits<buffer_allocator_type>::deallocate(m_alloc, m_buf, m_block_size);
+        }
+
+        state(const state&) = delete;
+        state& operator=(const state&) = delete;
+
+        size_type m_refs;
+        size_type m_to_read;
+        size_type m_buf_pos;
+        size_type m_block_size;
+        streambuf_type* m_streambuf;
+        buffer_allocator_type m_alloc;
+        int_type* m_buf;
+    };
+
+    // Keeps the shared state alive, so an iterator can be rebuilt from it.
+    class shared_istreambyte_proxy;
+
+public:
+    constexpr
+    shared_istreambyte_iterator() noexcept
+        : m_state{nullptr}
+    { }
+
+    shared_istreambyte_iterator(istream_type& stream, size_type block_size = default_block_size, const Alloc& alloc = Alloc())
+        : shared_istreambyte_iterator(stream.rdbuf(), block_size, alloc)
+    { }
+
+    shared_istreambyte_iterator(streambuf_type* sb, size_type block_size = default_block_size, const Alloc& alloc = Alloc())
+        : m_state{nullptr}
+    {
+        if (sb == nullptr) {
+            return;
+        }
+
+        typename state::allocator_type state_alloc{alloc};
+        state* created = std::allocator_traits<typename state::allocator_type>::allocate(state_alloc, 1);
+        try {
+            ::new (static_cast<void*>(created)) state{sb, std::max(block_size, size_type{1}), alloc};
+        } catch (...) {
+            std::allocator_traits<typename state::allocator_type>::deallocate(state_alloc, created, 1);
+            throw;
+        }
+
+        m_state = created;
+        _read_block();
+    }
+
+    shared_istreambyte_iterator(const shared_istreambyte_proxy& proxy) noexcept
+        : shared_istreambyte_iterator(proxy.m_iterator)
+    { }
+
+    shared_istreambyte_iterator(const shared_istreambyte_iterator& rhs) noexcept
+        : m_state{rhs.m_state}
+    {
+        if (m_state) {
+            ++m_state->m_refs;
+        }
+    }
+
+    shared_istreambyte_iterator(shared_istreambyte_iterator&& rhs) noexcept
+        : m_state{std::exchange(rhs.m_state, nullptr)}
+    { }
+
+    shared_istreambyte_iterator& operator=(shared_istreambyte_iterator rhs) noexcept {
+        std::swap(m_state, rhs.m_state);
+        return *this;
+    }
+
+    ~shared_istreambyte_iterator() {
+        _release();
+    }
+
+public:
+    [[nodiscard]]
+    byte_type operator*() const noexcept {
+        return static_cast<byte_type>(m_state->m_buf[m_state->m_buf_pos]);
+    }
+
+    shared_istreambyte_iterator& operator++() {
+        _increment();
+
+        return *this;
+    }
+
+    shared_istreambyte_proxy operator++(int) {
+        shared_istreambyte_proxy tmp{ **this, *this };
+        ++*this;
+
+        return tmp;
+    }
+
+    [[nodiscard]]
+    bool equal(const shared_istreambyte_iterator& lrs) const noexcept {
+        return _at_end() == lrs._at_end();
+    }
+
+#ifdef __cpp_lib_ranges
+    // Same as istreambyte_iterator's default_sentinel comparison.
+    [[nodiscard]] friend
+    bool operator==(const shared_istreambyte_iterator& it, std::default_sentinel_t) noexcept {
+        return it._at_end();
+    }
+#endif
+
+    // Same contract as istreambyte_iterator::buffered().
+    [[nodiscard]]
+    const_byte_span buffered() const noexcept {
+        if (m_state == nullptr) {
+            return {};
+        }
+
+        return {reinterpret_cast<const byte_type*>(m_state->m_buf + m_state->m_buf_pos), m_state->m_to_read};
+    }
+
+    void consume(size_type count) {
+        m_state->m_buf_pos += count;
+        m_state->m_to_read -= count;
+
+        if (m_state->m_to_read == 0) {
+            _read_block();
+        }
+    }
+
+    [[nodiscard]]
+    size_type block_size() const noexcept {
+        return m_state ? m_state->m_block_size : 0;
+    }
+
+private:
+    friend detail::block_access;
+
+    [[nodiscard]]
+    bool _at_end() const noexcept {
+        return m_state == nullptr || m_state->m_to_read == 0;
+    }
+
+    void _increment() {
+        if (_at_end()) {
+            return;
+        }
+
+        ++m_state->m_buf_pos;
+        --m_state->m_to_read;
+
+        if (m_state->m_to_read == 0) {
+            _read_block();
+        }
+    }
+
+    // Same contract as istreambyte_iterator::_read_into.
+    size_type _read_into(int_type* dest, size_type count) {
+        if (m_state == nullptr) {
+            return 0;
+        }
+
+        state& st = *m_state;
+        size_type done = std::min(count, st.m_to_read);
+        std::memcpy(dest, st.m_buf + st.m_buf_pos, done);
+        st.m_buf_pos += done;
+        st.m_to_read -= done;
+
+        if (done < count && st.m_streambuf != nullptr) {
+            const auto wanted = static_cast<std::streamsize>(count - done);
+            const auto got = st.m_streambuf->sgetn(dest + done, wanted);
+            done += static_cast<size_type>(got);
+
+            if (got < wanted) {
+                st.m_streambuf = nullptr;
             }
+        }
+
+        if (st.m_to_read == 0) {
+            _read_block();
+        }
+
+        return done;
+    }
+
+    void _read_block() {
+        state& st = *m_state;
+        st.m_buf_pos = 0;
+        st.m_to_read = 0;
+
+        if (st.m_streambuf == nullptr) {
+            return;
+        }
+
+        st.m_to_read = static_cast<size_type>(st.m_streambuf->sgetn(st.m_buf, static_cast<std::streamsize>(st.m_block_size)));
+
+        if (st.m_to_read < st.m_block_size) {
+            st.m_streambuf = nullptr;
+        }
+    }
+
+    void _release() noexcept {
+        if (m_state == nullptr || --m_state->m_refs != 0) {
+            return;
+        }
+
+        typename state::allocator_type state_alloc{m_state->m_alloc};
+        m_state->~state();
+        std::allocator_traits<typename state::allocator_type>::deallocate(state_alloc, m_state, 1);
+        m_state = nullptr;
+    }
+
+private:
+    state* m_state;
+};
+
+template <typename Alloc>
+class shared_istreambyte_iterator<Alloc>::shared_istreambyte_proxy {
+public:
+    [[nodiscard]] constexpr
+    byte_type operator*() const noexcept {
+        return m_value;
+    }
+
+private:
+    friend shared_istreambyte_iterator;
+    shared_istreambyte_proxy(byte_type value, const shared_istreambyte_iterator& it) noexcept
+        : m_value{value}, m_iterator{it}
+    { }
+
+    byte_type m_value;
+    shared_istreambyte_iterator m_iterator;
+};
+
+template <typename Alloc>
+inline
+bool operator==(const shared_istreambyte_iterator<Alloc>& lhs, const shared_istreambyte_iterator<Alloc>& lrs) noexcept
+{
+    return lhs.equal(lrs);
+}
+
+template <typename Alloc>
+inline
+bool operator!=(const shared_istreambyte_iterator<Alloc>& lhs, const shared_istreambyte_iterator<Alloc>& lrs) noexcept
+{
+    return !lhs.equal(lrs);
+}
+
+namespace detail {
+    // Bulk operations move data in slices of this size when the total is unknown.
+    inline constexpr std::size_t bulk_chunk_size = std::size_t{1} << 20;
+    // First slice appended to a vector of unknown final size; later slices double up to bulk_chunk_size.
+    inline constexpr std::size_t bulk_min_chunk_size = std::size_t{4} << 10;
+
+    struct block_access {
+        template <typename Iterator>
+        static std::size_t read_into(Iterator& it, std::byte* dest, std::size_t count) {
+            return it._read_into(reinterpret_cast<char*>(dest), count);
+        }
+
+        // Free room in an ostreambyte_iterator's block, for producers that fill it in place;
+        // empty once the iterator failed. commit_window(it, n) then accounts for n bytes of it.
+        template <typename Iterator>
+        static byte_span write_window(Iterator& it) {
+            return it._write_window();
+        }
+
+        template <typename Iterator>
+        static void commit_window(Iterator& it, std::size_t count) {
+            it._commit_window(count);
+        }
+    };
+
+    template <typename Iterator>
+    struct is_block_iterator : std::false_type { };
+
+    template <std::size_t buf_size, typename Source>
+    struct is_block_iterator<istreambyte_iterator<buf_size, Source>> : std::true_type { };
+
+    template <>
+    struct is_block_iterator<istreambuf_byte_iterator> : std::true_type { };
+
+    template <typename Alloc>
+    struct is_block_iterator<shared_istreambyte_iterator<Alloc>> : std::true_type { };
+
+    template <typename Iterator>
+    using enable_if_block_iterator_t = std::enable_if_t<is_block_iterator<Iterator>::value>;
+
+    // back_insert_iterator keeps its container protected; reach it through a member pointer.
+    template <typename Container>
+    struct back_insert_access : std::back_insert_iterator<Container> {
+        static Container& container_of(std::back_insert_iterator<Container>& it) noexcept {
+            return *(it.*(&back_insert_access::container));
+        }
+    };
+}
+
+// Reads up to dest.size() bytes straight from the streambuf into dest.
+// Returns the number of bytes read; less than dest.size() means the stream is exhausted.
+inline
+std::size_t read_bytes(std::basic_streambuf<char>* streambuf, byte_span dest) {
+    if (streambuf == nullptr) {
+        return 0;
+    }
+
+    return static_cast<std::size_t>(streambuf->sgetn(reinterpret_cast<char*>(dest.data()), 
+        static_cast<std::streamsize>(dest.size())));
+}
+
+inline
+std::size_t read_bytes(std::basic_istream<char>& stream, byte_span dest) {
+    return read_bytes(stream.rdbuf(), dest);
+}
+
+// Bulk counterparts of std::copy / std::copy_n for istreambyte_iterator and istreambuf_byte_iterator sources.
+// Whole blocks are moved with memcpy / sgetn instead of going through operator++ per byte.
+// They are found by ADL, so an unqualified copy(first, last, out) picks them over std::copy.
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+std::byte* copy(Iterator first, Iterator last, std::byte* dest) {
+    if (first == last) {
+        return dest;
+    }
+
+    std::size_t got = 0;
+    do {
+        got = detail::block_access::read_into(first, dest, detail::bulk_chunk_size);
+        dest += got;
+    } while (got == detail::bulk_chunk_size);
+
+    return dest;
+}
+
+template <typename Iterator, typename Alloc, typename = detail::enable_if_block_iterator_t<Iterator>>
+std::back_insert_iterator<std::vector<std::byte, Alloc>> 
+copy(Iterator first, Iterator last, std::back_insert_iterator<std::vector<std::byte, Alloc>> dest) 
+{
+    if (first == last) {
+        return dest;
+    }
+
+    auto& container = detail::back_insert_access<std::vector<std::byte, Alloc>>::container_of(dest);
+    std::size_t used = container.size();
+    std::size_t got = 0;
+    std::size_t chunk = 0;
+    // Start from what the source already holds and double from there, so a short stream does not
+    // zero-fill a whole bulk chunk and the vector keeps its usual geometric growth on a long one.
+    std::size_t wanted = std::max(detail::bulk_min_chunk_size, first.buffered().size());
+
+    do {
+        if (container.capacity() - used < wanted) {
+            container.reserve(std::max(container.capacity() * 2, used + wanted));
+        }
+
+        // Use whatever capacity there is before growing further.
+        chunk = container.capacity() - used;
+        container.resize(used + chunk);
+        got = detail::block_access::read_into(first, container.data() + used, chunk);
+        used += got;
+        container.resize(used);
+        wanted = std::min(chunk * 2, detail::bulk_chunk_size);
+    } while (got == chunk);
+
+    return dest;
+}
+
+// Stops early if the stream is exhausted; the returned iterator tells how much was copied.
+template <typename Iterator, typename Size, typename = detail::enable_if_block_iterator_t<Iterator>>
+std::byte* copy_n(Iterator first, Size count, std::byte* dest) {
+    if (count <= 0) {
+        return dest;
+    }
+
+    return dest + detail::block_access::read_into(first, dest, static_cast<std::size_t>(count));
+}
+
+template <typename Iterator, typename Size, typename Alloc, typename = detail::enable_if_block_iterator_t<Iterator>>
+std::back_insert_iterator<std::vector<std::byte, Alloc>> 
+copy_n(Iterator first, Size count, std::back_insert_iterator<std::vector<std::byte, Alloc>> dest) {
+    if (count <= 0) {
+        return dest;
+    }
+
+    auto& container = detail::back_insert_access<std::vector<std::byte, Alloc>>::container_of(dest);
+    const std::size_t used = container.size();
+    container.resize(used + static_cast<std::size_t>(count));
+
+    const auto got = detail::block_access::read_into(first, container.data() + used, static_cast<std::size_t>(count));
+    container.resize(used + got);
+
+    return dest;
+}
+
+// Input range over a block iterator that yields whole blocks as const_byte_span instead of single bytes.
+// A chunk stays valid until the iterator is incremented.
+template <typename BlockIterator>
+class byte_chunk_view {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const_byte_span;
+        using pointer = void;
+        using reference = const_byte_span;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr
+        iterator() noexcept
+            : m_view{nullptr}
+        { }
+
+        [[nodiscard]]
+        const_byte_span operator*() const noexcept {
+            return m_view->m_source.buffered();
+        }
+
+        iterator& operator++() {
+            m_view->m_source.consume(m_view->m_source.buffered().size());
+
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        [[nodiscard]]
+        bool operator==(const iterator& rhs) const noexcept {
+            return _at_end() == rhs._at_end();
+        }
+
+        [[nodiscard]]
+        bool operator!=(const iterator& rhs) const noexcept {
+            return !(*this == rhs);
+        }
+
+#ifdef __cpp_lib_ranges
+        [[nodiscard]] friend
+        bool operator==(const iterator& it, std::default_sentinel_t) noexcept {
+            return it._at_end();
+        }
+#endif
+
+    private:
+        friend byte_chunk_view;
+        constexpr explicit
+        iterator(byte_chunk_view* view) noexcept
+            : m_view{view}
+        { }
+
+        [[nodiscard]]
+        bool _at_end() const noexcept {
+            return m_view == nullptr || m_view->m_source.buffered().empty();
+        }
+
+        byte_chunk_view* m_view;
+    };
+
+public:
+    explicit byte_chunk_view(BlockIterator source)
+        : m_source{std::move(source)}
+    { }
+
+    [[nodiscard]]
+    iterator begin() noexcept {
+        return iterator{this};
+    }
+
+    [[nodiscard]]
+    iterator end() noexcept {
+        return iterator{};
+    }
+
+private:
+    BlockIterator m_source;
+};
+
+// Chunks of chunk_size bytes read with one sgetn each.
+inline
+byte_chunk_view<shared_istreambyte_iterator<>> byte_chunks(std::basic_streambuf<char>* streambuf, 
+    std::size_t chunk_size = shared_istreambyte_iterator<>::default_block_size) 
+{
+    return byte_chunk_view<shared_istreambyte_iterator<>>{shared_istreambyte_iterator<>{streambuf, chunk_size}};
+}
+
+inline
+byte_chunk_view<shared_istreambyte_iterator<>> byte_chunks(std::basic_istream<char>& stream, 
+    std::size_t chunk_size = shared_istreambyte_iterator<>::default_block_size) 
+{
+    return byte_chunks(stream.rdbuf(), chunk_size);
+}
+
+// Chunks are whatever the iterator buffers: its blocks, or the get area for istreambuf_byte_iterator.
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+byte_chunk_view<Iterator> byte_chunks(Iterator it) {
+    return byte_chunk_view<Iterator>{std::move(it)};
+}
+
+// When ostreambyte_iterator commits before its block is full. After bytes [first, last) were
+// buffered (pending counts everything buffered, them included) the iterator asks
+//     bool after_write(const char* first, const char* last, std::size_t pending);
+// and commits right away on true. A full block, flush() and destruction always commit.
+
+// Default: throughput first, nothing leaves before the block is full.
+struct flush_when_full {
+    constexpr
+    bool after_write(const char*, const char*, std::size_t) const noexcept {
+        return false;
+    }
+};
+
+// Commits once that many bytes wait; below buf_size it trades batching for latency.
+class flush_at_threshold {
+public:
+    constexpr explicit
+    flush_at_threshold(std::size_t bytes) noexcept
+        : m_bytes{bytes}
+    { }
+
+    constexpr
+    bool after_write(const char*, const char*, std::size_t pending) const noexcept {
+        return pending >= m_bytes;
+    }
+
+private:
+    std::size_t m_bytes;
+};
+
+// Commits after each write holding the delimiter: whole lines or records reach the sink.
+class flush_on_delimiter {
+public:
+    constexpr explicit
+    flush_on_delimiter(std::byte delimiter = std::byte{'\n'}) noexcept
+        : m_delimiter{delimiter}
+    { }
+
+    bool after_write(const char* first, const char* last, std::size_t) const noexcept {
+        return std::memchr(first, std::to_integer<int>(m_delimiter), static_cast<std::size_t>(last - first)) != nullptr;
+    }
+
+private:
+    std::byte m_delimiter;
+};
+
+// Bounds how long the oldest pending byte waits. The clock is read when a block starts and then
+// about every check_interval bytes, not per byte. Only writes check it: an idle iterator holds its
+// bytes until the next write or an explicit flush().
+template <typename Clock = std::chrono::steady_clock>
+class flush_after {
+public:
+    static constexpr std::size_t check_interval = 64;
+
+public:
+    explicit
+    flush_after(typename Clock::duration max_age) noexcept
+        : m_max_age{max_age}, m_oldest{}, m_countdown{0}
+    { }
+
+    bool after_write(const char* first, const char* last, std::size_t pending) noexcept {
+        const auto size = static_cast<std::size_t>(last - first);
+        if (pending == size) {
+            m_oldest = Clock::now();
+            m_countdown = check_interval;
+            return false;
+        }
+
+        m_countdown -= std::min(size, m_countdown);
+        if (m_countdown != 0) {
+            return false;
+        }
+
+        m_countdown = check_interval;
+        return Clock::now() - m_oldest >= m_max_age;
+    }
+
+private:
+    typename Clock::duration m_max_age;
+    typename Clock::time_point m_oldest;
+    std::size_t m_countdown;
+};
+
+// Commits when any of the policies asks; every policy still sees every write.
+template <typename... Policies>
+class flush_any {
+public:
+    constexpr explicit
+    flush_any(Policies... policies)
+        : m_policies{std::move(policies)...}
+    { }
+
+    bool after_write(const char* first, const char* last, std::size_t pending) {
+        return std::apply([&](auto&... policy) {
+            return (false | ... | policy.after_write(first, last, pending));
+        }, m_policies);
+    }
+
+private:
+    std::tuple<Policies...> m_policies;
+};
+
+// Outbut streambyte iterator to write to a streambuf. 
+// Uses an internal buffer and flushes when full (or as FlushPolicy asks), on flush() or on object deallocation.
+// The block lives in the iterator until it is first copied; it then moves to storage the copies
+// share, so copying does not flush and bytes keep the order they were written in whichever copy
+// wrote them. The last copy to go commits what is left.
+template<std::size_t buf_size = MRT_HARDWARE_CI_SIZE, typename Sink = streambuf_sink, typename FlushPolicy = flush_when_full>
+class ostreambyte_iterator {
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using ostream_type = std::basic_ostream<char_type, traits_type>;
+    using sink_type = Sink;
+    using flush_policy_type = FlushPolicy;
+
+private:
+    using byte_type = std::byte;
+    using array_type = std::array<char_type, buf_size>;
+    using size_type = std::size_t;
+
+    // The pending bytes and the policy watching them; m_data past m_pos is left uninitialised.
+    struct block {
+        explicit block(FlushPolicy policy)
+            : m_pos{0}, m_policy{std::move(policy)}
+        { }
+
+        size_type m_pos;
+        FlushPolicy m_policy;
+        alignas(MRT_HARDWARE_CI_SIZE) array_type m_data;
+    };
+
+public:
+    ostreambyte_iterator(streambuf_type* streambuf, FlushPolicy policy = FlushPolicy{})
+        : ostreambyte_iterator{Sink{streambuf}, std::move(policy)}
+    { }
+
+    ostreambyte_iterator(ostream_type& stream, FlushPolicy policy = FlushPolicy{})
+        : ostreambyte_iterator{stream.rdbuf(), std::move(policy)}
+    { }
+
+    // Non-deduced, so class template argument deduction still picks the stream constructors.
+    explicit ostreambyte_iterator(detail::type_identity_t<Sink> sink, FlushPolicy policy = FlushPolicy{})
+        : m_failure{false}, m_sink{std::move(sink)}, m_local{std::move(policy)}, m_block{&m_local}
+    { }
+
+    // Moves rhs's block to shared storage the first time it is copied.
+    ostreambyte_iterator(const ostreambyte_iterator& rhs)
+        : m_failure{rhs.m_failure}, m_sink{rhs.m_sink}, m_local{rhs.m_block->m_policy}, m_shared{rhs._share()},
+          m_block{m_shared.get()}
+    { }
+
+    ostreambyte_iterator& operator=(const ostreambyte_iterator& rhs) {
+        bool released = true;
+        if (m_block != rhs.m_block) {
+            std::shared_ptr<block> shared = rhs._share();
+            released = _release();
+            m_shared = std::move(shared);
+            m_block = m_shared.get();
+        }
+
+        // A failed commit of the block just dropped is this assignment's to report.
+        m_failure = rhs.m_failure || !released;
+        m_sink = rhs.m_sink;
+
+        return *this;
+    }
+
+    // Takes the pending bytes over, so returning an iterator by value does not allocate.
+    ostreambyte_iterator(ostreambyte_iterator&& rhs)
+        : m_failure{rhs.m_failure}, m_sink{rhs.m_sink}, m_local{rhs.m_block->m_policy}, m_block{&m_local}
+    {
+        _take(rhs);
+    }
+
+    ostreambyte_iterator& operator=(ostreambyte_iterator&& rhs) {
+        if (this != &rhs) {
+            const bool released = _release();
+            m_local.m_policy = rhs.m_block->m_policy;
+            _take(rhs);
+            m_failure = rhs.m_failure || !released;
+            m_sink = rhs.m_sink;
+        }
+
+        return *this;
+    }
+
+    ~ostreambyte_iterator() {
+        _release();
+    }
+
+    ostreambyte_iterator& operator=(byte_type rhs) {
+        if (!m_sink || !_put(static_cast<char_type>(rhs))) {
+            m_failure = true;
+        }
+
+        return *this;
+    }
+
+    // Writes a whole range at once. Large ranges bypass the internal buffer.
+    ostreambyte_iterator& operator=(const_byte_span rhs) {
+        if (!m_sink || !_write(reinterpret_cast<const char_type*>(rhs.data()), rhs.size())) {
+            m_failure = true;
+        }
+
+        return *this;
+    }
+
+    [[nodiscard]]
+    ostreambyte_iterator& operator*() noexcept {
+        return *this;
+    }
+
+    ostreambyte_iterator& operator++() noexcept {
+        return *this;
+    }
+
+    ostreambyte_iterator& operator++(int) noexcept {
+        return *this;
+    }
+
+    [[nodiscard]] constexpr
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // Hands the pending bytes to the sink now. Streambuf sinks may still buffer them (pubsync).
+    bool flush() {
+        const bool committed = _commit();
+        _clear_buffer();
+        m_failure = m_failure || !committed;
+
+        return committed;
+    }
+
+    [[nodiscard]]
+    const FlushPolicy& flush_policy() const noexcept {
+        return m_block->m_policy;
+    }
+
+private:
+    friend detail::block_access;
+
+    // A full block is committed first, so the window is never empty unless the iterator failed.
+    byte_span _write_window() {
+        if (!m_sink) {
+            m_failure = true;
+        } else if (_buf_size() == buf_size) {
+            m_failure = !flush() || m_failure;
+        }
+
+        if (m_failure) {
+            return {};
+        }
+
+        return {reinterpret_cast<byte_type*>(m_block->m_data.data() + m_block->m_pos), buf_size - m_block->m_pos};
+    }
+
+    void _commit_window(size_type count) {
+        m_block->m_pos += count;
+        const bool committed = _buf_size() == buf_size ? flush() : _check_policy(m_block->m_pos - count);
+        m_failure = m_failure || !committed;
+    }
+
+    bool _commit() {
+        if (!m_sink || _buf_size() == 0) {
+            return true;
+        }
+
+        return m_sink.write(m_block->m_data.data(), _buf_size()) == _buf_size();
+    }
+
+    std::shared_ptr<block> _share() const {
+        if (!m_shared) {
+            m_shared = std::make_shared<block>(m_local.m_policy);
+            m_shared->m_pos = m_local.m_pos;
+            std::memcpy(m_shared->m_data.data(), m_local.m_data.data(), m_local.m_pos);
+            m_block = m_shared.get();
+        }
+
+        return m_shared;
+    }
+
+    // Leaves rhs with an empty block of its own. Expects this one to be local and empty.
+    void _take(ostreambyte_iterator& rhs) {
+        if (rhs.m_shared) {
+            m_shared = std::move(rhs.m_shared);
+            m_block = m_shared.get();
+        } else {
+            m_local.m_pos = rhs.m_local.m_pos;
+            std::memcpy(m_local.m_data.data(), rhs.m_local.m_data.data(), rhs.m_local.m_pos);
+        }
+
+        rhs.m_block = &rhs.m_local;
+        rhs.m_local.m_pos = 0;
+    }
+
+    // The last copy commits what the others left pending.
+    bool _release() {
+        bool committed = true;
+        if (!m_shared || m_shared.use_count() == 1) {
+            committed = _commit();
+        }
+
+        m_shared.reset();
+        m_block = &m_local;
+        m_local.m_pos = 0;
+        return committed;
+    }
+
+    // Lets the policy look at what was just buffered at [first, pending).
+    bool _check_policy(size_type first) {
+        if (!m_block->m_policy.after_write(m_block->m_data.data() + first, m_block->m_data.data() + m_block->m_pos, m_block->m_pos)) {
+            return true;
+        }
+
+        const bool committed = _commit();
+        _clear_buffer();
+        return committed;
+    }
+
+    bool _put(char_type c) {
+        m_block->m_data[m_block->m_pos] = c;
+        ++m_block->m_pos;
+
+        bool committed = true;
+        if (_buf_size() == buf_size) {
+            committed = _commit();
+            _clear_buffer();
+        } else {
+            committed = _check_policy(m_block->m_pos - 1);
+        }
+
+        return committed;
+    }
 
+    bool _write(const char_type* data, size_type count) {
+        const size_type room = buf_size - _buf_size();
+
+        if (count < room) {
+            std::memcpy(m_block->m_data.data() + m_block->m_pos, data, count);
+            m_block->m_pos += count;
+            return _check_policy(m_block->m_pos - count);
+        }
+
+        bool committed = true;
+        if (count < buf_size) {
+            // Fits in a block: top up the pending one, flush it and keep the tail buffered.
+            std::memcpy(m_block->m_data.data() + m_block->m_pos, data, room);
+            m_block->m_pos = buf_size;
+            committed = _commit();
             _clear_buffer();
+
+            std::memcpy(m_block->m_data.data(), data + room, count - room);
+            m_block->m_pos = count - room;
+            return (m_block->m_pos == 0 || _check_policy(0)) && committed;
         }
 
-        return c;
+        // Flush what is pending, then hand the rest to the sink without staging.
+        committed = _commit();
+        _clear_buffer();
+
+        return m_sink.write(data, count) == count && committed;
     }
 
     constexpr
     void _clear_buffer() noexcept {
-        m_buf_pos = 0;
+        m_block->m_pos = 0;
     }
 
     [[nodiscard]] constexpr
     size_type _buf_size() const noexcept {
-        return m_buf_pos;
+        return m_block->m_pos;
+    }
+
+private:
+    bool m_failure;
+    Sink m_sink;
+    // Copying is logically const, so the first copy may move the block out of the original.
+    mutable block m_local;
+    mutable std::shared_ptr<block> m_shared;
+    mutable block* m_block;
+};
+
+// Fixed memory needs no staging: bytes are stored in place, buf_size and the flush policy are unused.
+template <std::size_t buf_size, typename FlushPolicy>
+class ostreambyte_iterator<buf_size, span_sink, FlushPolicy> {
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+    using sink_type = span_sink;
+
+private:
+    using byte_type = std::byte;
+    using size_type = std::size_t;
+
+public:
+    constexpr explicit
+    ostreambyte_iterator(span_sink sink) noexcept
+        : m_failure{false}, m_first{sink.bytes().data()}, m_last{sink.bytes().data() + sink.bytes().size()}
+    { }
+
+    constexpr explicit
+    ostreambyte_iterator(byte_span bytes) noexcept
+        : ostreambyte_iterator(span_sink{bytes})
+    { }
+
+    constexpr
+    ostreambyte_iterator& operator=(byte_type rhs) noexcept {
+        if (m_first == m_last) {
+            m_failure = true;
+        } else {
+            *m_first++ = rhs;
+        }
+
+        return *this;
+    }
+
+    ostreambyte_iterator& operator=(const_byte_span rhs) noexcept {
+        const size_type count = std::min(rhs.size(), static_cast<size_type>(m_last - m_first));
+        std::memcpy(m_first, rhs.data(), count);
+        m_first += count;
+        m_failure = m_failure || count < rhs.size();
+
+        return *this;
+    }
+
+    [[nodiscard]] constexpr
+    ostreambyte_iterator& operator*() noexcept {
+        return *this;
+    }
+
+    constexpr
+    ostreambyte_iterator& operator++() noexcept {
+        return *this;
+    }
+
+    constexpr
+    ostreambyte_iterator& operator++(int) noexcept {
+        return *this;
+    }
+
+    [[nodiscard]] constexpr
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // One past the last byte written.
+    [[nodiscard]] constexpr
+    byte_type* position() const noexcept {
+        return m_first;
+    }
+
+private:
+    friend detail::block_access;
+
+    byte_span _write_window() noexcept {
+        m_failure = m_failure || m_first == m_last;
+        return {m_first, static_cast<size_type>(m_last - m_first)};
+    }
+
+    void _commit_window(size_type count) noexcept {
+        m_first += count;
+    }
+
+private:
+    bool m_failure;
+    byte_type* m_first;
+    byte_type* m_last;
+};
+
+// Stores into bytes in memory with the ostreambyte_iterator interface.
+using span_byte_writer = ostreambyte_iterator<MRT_HARDWARE_CI_SIZE, span_sink>;
+
+namespace detail {
+    template <typename Iterator, typename = void>
+    struct is_contiguous_byte_iterator : std::false_type { };
+
+    template <typename T>
+    struct is_contiguous_byte_iterator<T*> : std::is_same<std::remove_cv_t<T>, std::byte> { };
+
+    template <typename Iterator>
+    struct is_contiguous_byte_iterator<Iterator, std::enable_if_t<
+        std::is_same_v<Iterator, std::vector<std::byte>::iterator>
+        || std::is_same_v<Iterator, std::vector<std::byte>::const_iterator>>> : std::true_type { };
+
+    template <typename Iterator>
+    inline constexpr bool is_contiguous_byte_iterator_v = is_contiguous_byte_iterator<Iterator>::value
+#ifdef __cpp_lib_concepts
+        || (std::contiguous_iterator<Iterator> && std::is_same_v<std::iter_value_t<Iterator>, std::byte>)
+#endif
+        ;
+
+    template <typename Iterator>
+    const_byte_span as_span(Iterator first, Iterator last) noexcept {
+        if (first == last) {
+            return {};
+        }
+
+        return {&*first, static_cast<std::size_t>(last - first)};
+    }
+}
+
+// Writes bytes straight to the streambuf. Returns the number of bytes written.
+inline
+std::size_t write_bytes(std::basic_streambuf<char>* streambuf, const_byte_span bytes) {
+    if (streambuf == nullptr) {
+        return 0;
+    }
+
+    return static_cast<std::size_t>(streambuf->sputn(reinterpret_cast<const char*>(bytes.data()), 
+        static_cast<std::streamsize>(bytes.size())));
+}
+
+inline
+std::size_t write_bytes(std::basic_ostream<char>& stream, const_byte_span bytes) {
+    return write_bytes(stream.rdbuf(), bytes);
+}
+
+// Bulk counterpart of std::copy for contiguous byte ranges into an ostreambyte_iterator.
+// Found by ADL like the istreambyte_iterator overloads.
+template <typename Iterator, std::size_t buf_size, typename Sink, typename FlushPolicy,
+    typename = std::enable_if_t<detail::is_contiguous_byte_iterator_v<Iterator>>>
+ostreambyte_iterator<buf_size, Sink, FlushPolicy> copy(Iterator first, Iterator last, ostreambyte_iterator<buf_size, Sink, FlushPolicy> dest) {
+    dest = detail::as_span(first, last);
+    return dest;
+}
+
+// Output iterator taking whole chunks (*it = span). Each chunk goes to sputn as is, without staging.
+class ostreamchunk_iterator {
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using ostream_type = std::basic_ostream<char_type, traits_type>;
+
+public:
+    ostreamchunk_iterator(streambuf_type* streambuf) noexcept
+        : m_failure{false}, m_streambuf{streambuf}
+    { }
+
+    ostreamchunk_iterator(ostream_type& stream) noexcept
+        : ostreamchunk_iterator{stream.rdbuf()}
+    { }
+
+    ostreamchunk_iterator& operator=(const_byte_span rhs) {
+        if (m_streambuf == nullptr || write_bytes(m_streambuf, rhs) != rhs.size()) {
+            m_failure = true;
+        }
+
+        return *this;
+    }
+
+    [[nodiscard]]
+    ostreamchunk_iterator& operator*() noexcept {
+        return *this;
+    }
+
+    ostreamchunk_iterator& operator++() noexcept {
+        return *this;
+    }
+
+    ostreamchunk_iterator& operator++(int) noexcept {
+        return *this;
+    }
+
+    [[nodiscard]] constexpr
+    bool failed() const noexcept {
+        return m_failure;
     }
 
 private:
     bool m_failure;
     streambuf_type* m_streambuf;
-    size_type m_buf_pos;
-    array_type m_buf;
 };
 
+#ifdef __cpp_lib_ranges
+namespace views {
+    // The stream as a std::ranges input range; the end is std::default_sentinel.
+    template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE>
+    [[nodiscard]]
+    std::ranges::subrange<istreambyte_iterator<buf_size>, std::default_sentinel_t> bytes(std::basic_streambuf<char>* streambuf) {
+        return {istreambyte_iterator<buf_size>{streambuf}, std::default_sentinel};
+    }
+
+    template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE>
+    [[nodiscard]]
+    std::ranges::subrange<istreambyte_iterator<buf_size>, std::default_sentinel_t> bytes(std::basic_istream<char>& stream) {
+        return bytes<buf_size>(stream.rdbuf());
+    }
+
+    // Any block iterator, e.g. a span_byte_iterator or an istreambuf_byte_iterator.
+    template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+    [[nodiscard]]
+    std::ranges::subrange<Iterator, std::default_sentinel_t> bytes(Iterator it) {
+        return {std::move(it), std::default_sentinel};
+    }
+}
+
+static_assert(std::input_iterator<istreambyte_iterator<>>);
+static_assert(std::sentinel_for<std::default_sentinel_t, istreambyte_iterator<>>);
+static_assert(std::input_iterator<span_byte_iterator>);
+static_assert(std::input_iterator<istreambuf_byte_iterator>);
+static_assert(std::input_iterator<shared_istreambyte_iterator<>>);
+static_assert(std::output_iterator<ostreambyte_iterator<>, std::byte>);
+static_assert(std::output_iterator<span_byte_writer, std::byte>);
+static_assert(std::output_iterator<ostreamchunk_iterator, const_byte_span>);
+#endif
+
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,570 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_ASYNC_HPP_
+#define MRT_STREAMBYTE_ASYNC_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace mrt {
+
+// Read-only streambuf that keeps `depth` blocks in flight: a background thread fills the next
+// blocks from the source while the consumer works through the current one.
+// The get area points straight into the filled block, so any streambyte iterator or
+// byte_chunks(istreambuf_byte_iterator{&prefetch}) reads it without an extra copy.
+// The source must not be used by anyone else while the prefetcher is alive.
+class prefetch_streambuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using istream_type = std::basic_istream<char_type, traits_type>;
+
+    static constexpr std::size_t default_block_size = std::size_t{1} << 18;
+    static constexpr std::size_t default_depth = 2;
+
+private:
+    using size_type = std::size_t;
+    static constexpr size_type no_block = static_cast<size_type>(-1);
+
+    struct filled_block {
+        size_type index;
+        size_type size;
+    };
+
+public:
+    explicit prefetch_streambuf(streambuf_type* source, size_type block_size = default_block_size, size_type depth = default_depth)
+        : m_source{source}, m_block_size{std::max(block_size, size_type{1})}, m_current{no_block},
+          m_done{source == nullptr}, m_stop{false}
+    {
+        depth = std::max(depth, size_type{1});
+        m_blocks.resize(depth, std::vector<char_type>(m_block_size));
+        for (size_type i = 0; i < depth; ++i) {
+            m_free.push_back(i);
+        }
+
+        if (!m_done) {
+            m_worker = std::thread{[this]() { _fill_loop(); }};
+        }
+    }
+
+    explicit prefetch_streambuf(istream_type& stream, size_type block_size = default_block_size, size_type depth = default_depth)
+        : prefetch_streambuf(stream.rdbuf(), block_size, depth)
+    { }
+
+    prefetch_streambuf(const prefetch_streambuf&) = delete;
+    prefetch_streambuf& operator=(const prefetch_streambuf&) = delete;
+
+    ~prefetch_streambuf() override {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stop = true;
+        }
+        m_wake_worker.notify_one();
+
+        if (m_worker.joinable()) {
+            m_worker.join();
+        }
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() != egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+
+        // The block just consumed can be refilled while we wait for the next one.
+        if (m_current != no_block) {
+            m_free.push_back(m_current);
+            m_current = no_block;
+            m_wake_worker.notify_one();
+        }
+
+        m_wake_consumer.wait(lock, [this]() { return !m_filled.empty() || m_done; });
+
+        if (m_filled.empty()) {
+            setg(nullptr, nullptr, nullptr);
+            if (m_error) {
+                std::rethrow_exception(std::exchange(m_error, nullptr));
+            }
+
+            return traits_type::eof();
+        }
+
+        const filled_block block = m_filled.front();
+        m_filled.pop_front();
+        m_current = block.index;
+
+        char_type* data = m_blocks[block.index].data();
+        setg(data, data, data + block.size);
+
+        return traits_type::to_int_type(*data);
+    }
+
+    std::streamsize showmanyc() override {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        std::streamsize ready = 0;
+        for (const auto& block : m_filled) {
+            ready += static_cast<std::streamsize>(block.size);
+        }
+
+        return ready == 0 && m_done ? -1 : ready;
+    }
+
+private:
+    void _fill_loop() {
+        for (;;) {
+            size_type index = 0;
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_wake_worker.wait(lock, [this]() { return !m_free.empty() || m_stop; });
+                if (m_stop) {
+                    return;
+                }
+
+                index = m_free.front();
+                m_free.pop_front();
+            }
+
+            // The I/O itself runs unlocked so the consumer keeps going.
+            size_type got = 0;
+            std::exception_ptr error;
+            try {
+                got = static_cast<size_type>(m_source->sgetn(m_blocks[index].data(), static_cast<std::streamsize>(m_block_size)));
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                if (got != 0) {
+                    m_filled.push_back({index, got});
+                } else {
+                    m_free.push_back(index);
+                }
+
+                if (error) {
+                    m_error = error;
+                }
+
+                if (got < m_block_size) {
+                    m_done = true;
+                }
+            }
+            m_wake_consumer.notify_one();
+
+            if (got < m_block_size) {
+                return;
+            }
+        }
+    }
+
+private:
+    streambuf_type* m_source;
+    size_type m_block_size;
+    std::vector<std::vector<char_type>> m_blocks;
+
+    // Guarded by m_mutex.
+    std::deque<size_type> m_free;
+    std::deque<filled_block> m_filled;
+    size_type m_current;
+    bool m_done;
+    bool m_stop;
+    std::exception_ptr m_error;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake_worker;
+    std::condition_variable m_wake_consumer;
+    std::thread m_worker;
+};
+
+
+// What async_byte_writer does with a write that does not fit in its ring.
+enum class backpressure {
+    block,   // wait for the I/O thread to make room
+    drop,    // discard the whole write and count it in dropped()
+    grow     // queue it in an unbounded overflow buffer behind the ring
+};
+
+// Write-only streambuf that moves the sink's latency off the writing thread: sputn copies into a
+// lock-free single producer / single consumer ring and a dedicated I/O thread drains it into the
+// sink in as large writes as are queued. With multiple_producers, writers are serialized by a
+// mutex in front of the ring; the consumer side is unchanged.
+// failed() turns true once the sink failed; from then on writes are refused (sputn returns 0,
+// so ostreambyte_iterator::failed() reports it too) and queued bytes are discarded.
+// Dropped writes are not failures. The sink must not be used by anyone else while the writer is alive.
+class async_byte_writer : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using ostream_type = std::basic_ostream<char_type, traits_type>;
+
+    static constexpr std::size_t default_capacity = std::size_t{1} << 20;
+
+private:
+    using size_type = std::size_t;
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit async_byte_writer(streambuf_type* sink, size_type capacity = default_capacity,
+                               backpressure when_full = backpressure::block, bool multiple_producers = false)
+        : m_sink{sink}, m_when_full{when_full}, m_multiple_producers{multiple_producers}, m_head{0}, m_tail{0},
+          m_consumer_sleeping{false}, m_producer_sleeping{false}, m_overflowed{false}, m_failure{sink == nullptr},
+          m_dropped{0}, m_overflow_queued{0}, m_flush_requested{0}, m_flush_done{0},
+          m_overflow_emitted{0}, m_stop{false}
+    {
+        size_type size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        m_ring.resize(size);
+        m_mask = size - 1;
+        m_worker = std::thread{[this]() { _drain_loop(); }};
+    }
+
+    explicit async_byte_writer(ostream_type& stream, size_type capacity = default_capacity,
+                               backpressure when_full = backpressure::block, bool multiple_producers = false)
+        : async_byte_writer(stream.rdbuf(), capacity, when_full, multiple_producers)
+    { }
+
+    async_byte_writer(const async_byte_writer&) = delete;
+    async_byte_writer& operator=(const async_byte_writer&) = delete;
+
+    // Everything queued is written before the I/O thread stops.
+    ~async_byte_writer() override {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stop = true;
+        }
+        m_wake_consumer.notify_one();
+        m_worker.join();
+    }
+
+public:
+    // False once the sink failed. A dropped write still returns true.
+    bool write(const_byte_span bytes) {
+        return _push(reinterpret_cast<const char_type*>(bytes.data()), bytes.size());
+    }
+
+    // Waits until everything queued so far reached the sink, then syncs the sink. Bytes queued
+    // after the call do not hold it up.
+    bool flush() {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        const std::uint64_t ticket = m_flush_requested.load(std::memory_order_relaxed) + 1;
+        m_flush_targets.push_back({ticket, m_head.load(std::memory_order_acquire), m_overflow_queued});
+        m_flush_requested.store(ticket, std::memory_order_relaxed);
+        m_wake_consumer.notify_one();
+        m_flushed.wait(lock, [this, ticket]() { return m_flush_done >= ticket; });
+
+        return !failed();
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure.load(std::memory_order_acquire);
+    }
+
+    // Bytes discarded by backpressure::drop.
+    [[nodiscard]]
+    std::uint64_t dropped() const noexcept {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+
+        const char_type value = traits_type::to_char_type(c);
+        return _push(&value, 1) ? c : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+        if (count <= 0) {
+            return 0;
+        }
+
+        return _push(s, static_cast<size_type>(count)) ? count : 0;
+    }
+
+    int sync() override {
+        return flush() ? 0 : -1;
+    }
+
+private:
+    [[nodiscard]]
+    size_type _room() const noexcept {
+        return m_ring.size() - (m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    // Producer side. Only the producer moves m_head, so it is read relaxed here.
+    bool _push(const char_type* data, size_type size) {
+        std::unique_lock<std::mutex> producer_lock{m_producer_mutex, std::defer_lock};
+        if (m_multiple_producers) {
+            producer_lock.lock();
+        }
+
+        while (size != 0) {
+            if (failed()) {
+                return false;
+            }
+
+            // Once bytes went to the overflow, later ones follow them there until the I/O thread took it.
+            if (!m_overflowed.load(std::memory_order_acquire)) {
+                const size_type room = _room();
+                const size_type take = m_when_full == backpressure::block ? std::min(room, size) : room >= size ? size : 0;
+                if (take != 0) {
+                    _copy_in(data, take);
+                    data += take;
+                    size -= take;
+                    _wake_consumer();
+                    continue;
+                }
+            }
+
+            switch (m_when_full) {
+            case backpressure::drop:
+                m_dropped.fetch_add(size, std::memory_order_relaxed);
+                return true;
+
+            case backpressure::grow: {
+                {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    if (!m_overflowed.load(std::memory_order_relaxed) && _room() >= size) {
+                        continue;
+                    }
+
+                    m_overflow.insert(m_overflow.end(), data, data + size);
+                    m_overflow_queued += size;
+                    m_overflowed.store(true, std::memory_order_release);
+                }
+                size = 0;
+                _wake_consumer();
+                break;
+            }
+
+            case backpressure::block: {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_producer_sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_space.wait(lock, [this]() { return _room() != 0 || failed(); });
+                m_producer_sleeping.store(false, std::memory_order_relaxed);
+                break;
+            }
+            }
+        }
+
+        return !failed();
+    }
+
+    void _copy_in(const char_type* data, size_type size) noexcept {
+        const size_type head = m_head.load(std::memory_order_relaxed);
+        const size_type offset = head & m_mask;
+        const size_type first = std::min(size, m_ring.size() - offset);
+        std::memcpy(m_ring.data() + offset, data, first);
+        std::memcpy(m_ring.data(), data + first, size - first);
+        m_head.store(head + size, std::memory_order_release);
+    }
+
+    // The fences pair with the ones before sleeping: either the sleeper sees the new index or
+    // we see it sleeping. Nothing is locked on the fast path.
+    void _wake_consumer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumer_sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_wake_consumer.notify_one();
+        }
+    }
+
+    void _wake_producer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_producer_sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_space.notify_all();
+        }
+    }
+
+    // After a failure bytes are still taken off the ring, so blocked producers wake up.
+    void _emit(const char_type* data, size_type size) {
+        if (failed()) {
+            return;
+        }
+
+        bool written = false;
+        try {
+            written = static_cast<size_type>(m_sink->sputn(data, static_cast<std::streamsize>(size))) == size;
+        } catch (...) {
+        }
+
+        if (!written) {
+            m_failure.store(true, std::memory_order_release);
+            _wake_producer();
+        }
+    }
+
+    // I/O thread: the whole contiguous run of queued bytes goes out in one sputn.
+    void _drain_loop() {
+        for (;;) {
+            const size_type tail = m_tail.load(std::memory_order_relaxed);
+            const size_type head = m_head.load(std::memory_order_acquire);
+            if (head != tail) {
+                const size_type offset = tail & m_mask;
+                const size_type count = std::min(head - tail, m_ring.size() - offset);
+                _emit(m_ring.data() + offset, count);
+                m_tail.store(tail + count, std::memory_order_release);
+                _wake_producer();
+                if (m_flush_requested.load(std::memory_order_relaxed) != m_flush_done) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    _complete_flushes();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{m_mutex};
+            if (m_head.load(std::memory_order_acquire) != tail) {
+                continue;
+            }
+
+            // The ring is empty, so the overflow holds the oldest bytes.
+            if (!m_overflow.empty()) {
+                std::vector<char_type> batch;
+                batch.swap(m_overflow);
+                m_overflowed.store(false, std::memory_order_release);
+                lock.unlock();
+
+                _emit(batch.data(), batch.size());
+                lock.lock();
+                m_overflow_emitted += batch.size();
+                _complete_flushes();
+                continue;
+            }
+
+            // Everything queued is out, so every pending flush is due.
+            _complete_flushes();
+
+            if (m_stop) {
+                return;
+            }
+
+            m_consumer_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_wake_consumer.wait(lock, [this, tail]() {
+                return m_head.load(std::memory_order_acquire) != tail || !m_overflow.empty() || m_stop
+                    || m_flush_done != m_flush_requested.load(std::memory_order_relaxed);
+            });
+            m_consumer_sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Under m_mutex. A flush is served once the bytes queued before it are out, however much
+    // was queued since, so steady producers cannot starve it.
+    void _complete_flushes() {
+        const size_type tail = m_tail.load(std::memory_order_relaxed);
+        bool completed = false;
+        // Indices wrap, so "tail has passed head" is a distance of less than half the range.
+        const auto passed = [tail](size_type head) { return tail - head <= ~size_type{0} / 2; };
+        while (!m_flush_targets.empty() && passed(m_flush_targets.front().head)
+               && m_overflow_emitted >= m_flush_targets.front().overflow) {
+            m_flush_done = m_flush_targets.front().ticket;
+            m_flush_targets.pop_front();
+            completed = true;
+        }
+
+        if (!completed) {
+            return;
+        }
+
+        if (!failed() && m_sink->pubsync() != 0) {
+            m_failure.store(true, std::memory_order_release);
+        }
+        m_flushed.notify_all();
+    }
+
+private:
+    // Where the stream stood when flush() was called.
+    struct flush_target {
+        std::uint64_t ticket;
+        size_type head;
+        std::uint64_t overflow;
+    };
+
+private:
+    streambuf_type* m_sink;
+    backpressure m_when_full;
+    bool m_multiple_producers;
+    std::vector<char_type> m_ring;
+    size_type m_mask;
+
+    // Indices grow forever and are masked on access; one cache line each, as one thread writes each.
+    alignas(MRT_HARDWARE_CI_SIZE) std::atomic<size_type> m_head;
+    alignas(MRT_HARDWARE_CI_SIZE) std::atomic<size_type> m_tail;
+
+    alignas(MRT_HARDWARE_CI_SIZE) std::atomic<bool> m_consumer_sleeping;
+    std::atomic<bool> m_producer_sleeping;
+    std::atomic<bool> m_overflowed;
+    std::atomic<bool> m_failure;
+    std::atomic<std::uint64_t> m_dropped;
+
+    std::mutex m_producer_mutex;
+
+    // Guarded by m_mutex.
+    std::vector<char_type> m_overflow;
+    std::uint64_t m_overflow_queued;
+    std::deque<flush_target> m_flush_targets;
+    std::atomic<std::uint64_t> m_flush_requested;
+    // Written by the I/O thread under m_mutex; it alone may read it without.
+    std::uint64_t m_flush_done;
+    // I/O thread only.
+    std::uint64_t m_overflow_emitted;
+    bool m_stop;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake_consumer;
+    std::condition_variable m_space;
+    std::condition_variable m_flushed;
+    std::thread m_worker;
+};
+
+}
+
+#endif
@@ -0,0 +1,450 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_BINARY_HPP_
+#define MRT_STREAMBYTE_BINARY_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Array byte swapping uses SSSE3 / AVX2 shuffles when the target flags allow it.
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace mrt {
+
+enum class byte_order {
+    little,
+    big,
+    native = detail::host_is_big_endian ? big : little
+};
+
+namespace detail {
+    template <std::size_t size>
+    struct unsigned_of_size;
+
+    template <> struct unsigned_of_size<1> { using type = std::uint8_t; };
+    template <> struct unsigned_of_size<2> { using type = std::uint16_t; };
+    template <> struct unsigned_of_size<4> { using type = std::uint32_t; };
+    template <> struct unsigned_of_size<8> { using type = std::uint64_t; };
+
+    template <typename T>
+    inline constexpr bool is_binary_value_v = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+    // Converts between host order and `order`; the same operation both ways.
+    template <typename T>
+    [[nodiscard]] inline
+    T to_order(T value, byte_order order) noexcept {
+        if constexpr (sizeof(T) == 1) {
+            return value;
+        } else {
+            if (order == byte_order::native) {
+                return value;
+            }
+
+            typename unsigned_of_size<sizeof(T)>::type bits;
+            std::memcpy(&bits, &value, sizeof(T));
+            bits = byteswap(bits);
+            std::memcpy(&value, &bits, sizeof(T));
+
+            return value;
+        }
+    }
+
+    // Byte swaps count elements of `width` bytes from src to dst. dst may equal src.
+    inline
+    void byteswap_copy(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width) noexcept {
+        std::size_t bytes = count * width;
+#if defined(__AVX2__)
+        const __m256i mask32 = width == 2 ? _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                                             1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                             : width == 4 ? _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                                          : _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        for (; bytes >= 32; bytes -= 32, src += 32, dst += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_shuffle_epi8(block, mask32));
+        }
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+        const __m128i mask16 = width == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                             : width == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                                          : _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        for (; bytes >= 16; bytes -= 16, src += 16, dst += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(block, mask16));
+        }
+#endif
+        // Scalar loop for the tail, or everything without SIMD; compilers turn it into bswaps.
+        for (; bytes >= width; bytes -= width, src += width, dst += width) {
+            if (width == 2) {
+                std::uint16_t v;
+                std::memcpy(&v, src, 2);
+                v = byteswap(v);
+                std::memcpy(dst, &v, 2);
+            } else if (width == 4) {
+                std::uint32_t v;
+                std::memcpy(&v, src, 4);
+                v = byteswap(v);
+                std::memcpy(dst, &v, 4);
+            } else {
+                std::uint64_t v;
+                std::memcpy(&v, src, 8);
+                v = byteswap(v);
+                std::memcpy(dst, &v, 8);
+            }
+        }
+    }
+
+    // Longest LEB128 encoding of a 64 bit value.
+    inline constexpr std::size_t max_varint_size = 10;
+
+    // Packs the low 7 bits of each byte of x together, byte 0 lowest.
+    [[nodiscard]] inline
+    std::uint64_t compact_varint_groups(std::uint64_t x) noexcept {
+        // Three shift / mask rounds; cheaper than pext on CPUs that microcode it.
+        x &= 0x7F7F7F7F7F7F7F7Full;
+        x = ((x & 0x7F007F007F007F00ull) >> 1) | (x & 0x007F007F007F007Full);
+        x = ((x & 0x3FFF00003FFF0000ull) >> 2) | (x & 0x00003FFF00003FFFull);
+        x = ((x & 0x0FFFFFFF00000000ull) >> 4) | (x & 0x000000000FFFFFFFull);
+        return x;
+    }
+
+    // Decodes one LEB128 value from p, which must have max_varint_size readable bytes.
+    // One 8 byte load finds the terminator, so there are no per byte branches or bounds checks.
+    // Returns the end of the encoding, or nullptr when it does not fit 64 bits.
+    [[nodiscard]] inline
+    const std::byte* decode_varint_unchecked(const std::byte* p, std::uint64_t& value) noexcept {
+        const std::uint64_t word = load_le64(p);
+        const std::uint64_t stops = ~word & 0x8080808080808080ull;
+        if (stops != 0) {
+            const unsigned length = count_trailing_zeros(stops) / 8 + 1;
+            const std::uint64_t bits = length == 8 ? word : word & ((std::uint64_t{1} << (length * 8)) - 1);
+            value = compact_varint_groups(bits);
+            return p + length;
+        }
+
+        value = compact_varint_groups(word);
+        const auto byte8 = std::to_integer<std::uint64_t>(p[8]);
+        value |= (byte8 & 0x7Fu) << 56;
+        if ((byte8 & 0x80u) == 0) {
+            return p + 9;
+        }
+
+        const auto byte9 = std::to_integer<std::uint64_t>(p[9]);
+        if (byte9 > 1) {
+            return nullptr;
+        }
+
+        value |= byte9 << 63;
+        return p + 10;
+    }
+
+    [[nodiscard]] constexpr
+    std::uint64_t zigzag_encode(std::int64_t value) noexcept {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    [[nodiscard]] constexpr
+    std::int64_t zigzag_decode(std::uint64_t value) noexcept {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1u);
+    }
+}
+
+// Typed reads on top of a block iterator (istreambyte_iterator, istreambuf_byte_iterator,
+// shared_istreambyte_iterator). Values are decoded straight out of the iterator's block; only
+// values straddling two blocks take the slower path.
+// Reading past the end sets failed() and yields zeroes; check it once after a record.
+template <typename BlockIterator>
+class binary_reader {
+public:
+    using iterator_type = BlockIterator;
+    using size_type = std::size_t;
+
+    static_assert(detail::is_block_iterator<BlockIterator>::value, "binary_reader needs a block iterator");
+
+public:
+    explicit binary_reader(BlockIterator source)
+        : m_source{std::move(source)}, m_failure{false}
+    { }
+
+public:
+    template <typename T>
+    [[nodiscard]]
+    T read(byte_order order = byte_order::little) {
+        static_assert(detail::is_binary_value_v<T>, "read<T> needs an arithmetic or enum type");
+
+        T value{};
+        const const_byte_span window = m_source.buffered();
+        if (window.size() >= sizeof(T)) {
+            std::memcpy(&value, window.data(), sizeof(T));
+            m_source.consume(sizeof(T));
+        } else if (!_read_raw(reinterpret_cast<std::byte*>(&value), sizeof(T))) {
+            return T{};
+        }
+
+        return detail::to_order(value, order);
+    }
+
+    // Reads count values into out with a single bulk copy, then swaps them in place if needed.
+    // Returns how many values were read.
+    template <typename T>
+    size_type read_array(T* out, size_type count, byte_order order = byte_order::little) {
+        static_assert(detail::is_binary_value_v<T>, "read_array<T> needs an arithmetic or enum type");
+
+        auto* bytes = reinterpret_cast<std::byte*>(out);
+        const size_type got = detail::block_access::read_into(m_source, bytes, count * sizeof(T)) / sizeof(T);
+        if (got < count) {
+            m_failure = true;
+        }
+
+        if constexpr (sizeof(T) != 1) {
+            if (order != byte_order::native) {
+                detail::byteswap_copy(bytes, bytes, got, sizeof(T));
+            }
+        }
+
+        return got;
+    }
+
+    // Raw bytes. Returns how many were read.
+    size_type read_bytes(byte_span out) {
+        const size_type got = detail::block_access::read_into(m_source, out.data(), out.size());
+        if (got < out.size()) {
+            m_failure = true;
+        }
+
+        return got;
+    }
+
+    // Unsigned LEB128.
+    [[nodiscard]]
+    std::uint64_t read_varint() {
+        const const_byte_span window = m_source.buffered();
+        if (window.size() >= detail::max_varint_size) {
+            std::uint64_t value = 0;
+            const std::byte* end = detail::decode_varint_unchecked(window.data(), value);
+            if (end == nullptr) {
+                m_failure = true;
+                return 0;
+            }
+
+            m_source.consume(static_cast<size_type>(end - window.data()));
+            return value;
+        }
+
+        return _read_varint_slow();
+    }
+
+    // Signed LEB128 with zigzag mapping (protobuf sint64).
+    [[nodiscard]]
+    std::int64_t read_zigzag() {
+        return detail::zigzag_decode(read_varint());
+    }
+
+    // Decodes up to count varints into out. Values are decoded in runs straight out of the block with
+    // one consume() per run; only the last max_varint_size bytes of each block go through the checked path.
+    // Returns how many values were read.
+    size_type read_varints(std::uint64_t* out, size_type count) {
+        size_type done = 0;
+        while (done < count && !m_failure) {
+            const const_byte_span window = m_source.buffered();
+            if (window.empty()) {
+                m_failure = true;
+                break;
+            }
+
+            const std::byte* first = window.data();
+            const std::byte* last = first + window.size();
+            const std::byte* cursor = first;
+            while (done < count && static_cast<size_type>(last - cursor) >= detail::max_varint_size) {
+                cursor = detail::decode_varint_unchecked(cursor, out[done]);
+                if (cursor == nullptr) {
+                    m_failure = true;
+                    return done;
+                }
+                ++done;
+            }
+
+            m_source.consume(static_cast<size_type>(cursor - first));
+            if (done < count && static_cast<size_type>(last - cursor) < detail::max_varint_size) {
+                out[done] = _read_varint_slow();
+                done += m_failure ? 0 : 1;
+            }
+        }
+
+        return done;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // True once every byte was read.
+    [[nodiscard]]
+    bool at_end() const noexcept {
+        return m_source.buffered().empty();
+    }
+
+    [[nodiscard]]
+    BlockIterator& source() noexcept {
+        return m_source;
+    }
+
+private:
+    bool _read_raw(std::byte* out, size_type count) {
+        if (detail::block_access::read_into(m_source, out, count) != count) {
+            m_failure = true;
+        }
+
+        return !m_failure;
+    }
+
+    std::uint64_t _read_varint_slow() {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const const_byte_span window = m_source.buffered();
+            if (window.empty()) {
+                break;
+            }
+
+            const auto byte = std::to_integer<std::uint64_t>(window[0]);
+            m_source.consume(1);
+            if (shift == 63 && byte > 1) {
+                break;
+            }
+
+            value |= (byte & 0x7Fu) << shift;
+            if ((byte & 0x80u) == 0) {
+                return value;
+            }
+        }
+
+        m_failure = true;
+        return 0;
+    }
+
+private:
+    BlockIterator m_source;
+    bool m_failure;
+};
+
+// Typed writes through an ostreambyte_iterator's buffer.
+template <std::size_t buf_size = 4096>
+class binary_writer {
+public:
+    using streambuf_type = typename ostreambyte_iterator<buf_size>::streambuf_type;
+    using ostream_type = typename ostreambyte_iterator<buf_size>::ostream_type;
+    using size_type = std::size_t;
+
+private:
+    // Swapped arrays are staged through a stack buffer of this size.
+    static constexpr size_type swap_block_size = 4096;
+
+public:
+    explicit binary_writer(streambuf_type* streambuf)
+        : m_out{streambuf}
+    { }
+
+    explicit binary_writer(ostream_type& stream)
+        : m_out{stream}
+    { }
+
+public:
+    template <typename T>
+    void write(T value, byte_order order = byte_order::little) {
+        static_assert(detail::is_binary_value_v<T>, "write<T> needs an arithmetic or enum type");
+
+        value = detail::to_order(value, order);
+        std::array<std::byte, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), &value, sizeof(T));
+        m_out = const_byte_span{bytes.data(), bytes.size()};
+    }
+
+    template <typename T>
+    void write_array(const T* data, size_type count, byte_order order = byte_order::little) {
+        static_assert(detail::is_binary_value_v<T>, "write_array<T> needs an arithmetic or enum type");
+
+        const auto* bytes = reinterpret_cast<const std::byte*>(data);
+        size_type size = count * sizeof(T);
+        if (sizeof(T) == 1 || order == byte_order::native) {
+            m_out = const_byte_span{bytes, size};
+            return;
+        }
+
+        constexpr size_type step = swap_block_size / sizeof(T) * sizeof(T);
+        std::array<std::byte, swap_block_size> swapped;
+        while (size != 0) {
+            const size_type chunk = std::min(size, step);
+            detail::byteswap_copy(swapped.data(), bytes, chunk / sizeof(T), sizeof(T));
+            m_out = const_byte_span{swapped.data(), chunk};
+            bytes += chunk;
+            size -= chunk;
+        }
+    }
+
+    void write_bytes(const_byte_span bytes) {
+        m_out = bytes;
+    }
+
+    void write_varint(std::uint64_t value) {
+        std::array<std::byte, detail::max_varint_size> bytes;
+        size_type size = 0;
+        for (; value >= 0x80u; value >>= 7) {
+            bytes[size++] = static_cast<std::byte>(value | 0x80u);
+        }
+        bytes[size++] = static_cast<std::byte>(value);
+
+        m_out = const_byte_span{bytes.data(), size};
+    }
+
+    void write_zigzag(std::int64_t value) {
+        write_varint(detail::zigzag_encode(value));
+    }
+
+    // Commits the pending block, so a failed final write shows up here rather than being lost
+    // in the destructor.
+    bool flush() {
+        return m_out.flush();
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_out.failed();
+    }
+
+private:
+    ostreambyte_iterator<buf_size> m_out;
+};
+
+}
+
+#endif
@@ -0,0 +1,330 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_BITS_HPP_
+#define MRT_STREAMBYTE_BITS_HPP_
+
+#include "streambyte.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace mrt {
+
+// Which end of each byte a bitstream starts at: lsb_first is deflate / Brotli / little endian
+// telemetry packing, msb_first is JPEG, H.26x and most Huffman code tables in the literature.
+enum class bit_order {
+    lsb_first,
+    msb_first
+};
+
+namespace detail {
+    [[nodiscard]] inline
+    std::uint64_t load_be64(const std::byte* p) noexcept {
+        std::uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return host_is_big_endian ? value : byteswap(value);
+    }
+
+    [[nodiscard]] constexpr
+    std::uint64_t low_bits(unsigned count) noexcept {
+        return count >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << count) - 1;
+    }
+}
+
+// Bitstream reader over a block iterator. Bits live in a 64 bit accumulator that is refilled
+// with one unaligned 8 byte load straight out of the iterator's block, so peek_bits /
+// consume_bits are a shift and a mask with no branch; only the last 7 bytes of a block are
+// loaded one at a time. After refill() at least max_peek_bits bits are available until the
+// stream runs out; past the end the accumulator reads as zeroes.
+// The iterator runs up to 8 bytes ahead of the bits consumed; align_to_byte() and bits() tell
+// where the bitstream really is.
+template <typename BlockIterator, bit_order order = bit_order::lsb_first>
+class bit_reader {
+public:
+    using iterator_type = BlockIterator;
+    using size_type = std::size_t;
+
+    static constexpr unsigned max_peek_bits = 56;
+
+    static_assert(detail::is_block_iterator<BlockIterator>::value, "bit_reader needs a block iterator");
+
+public:
+    explicit bit_reader(BlockIterator source)
+        : m_source{std::move(source)}, m_bits{0}, m_count{0}, m_failure{false}
+    { }
+
+public:
+    // Tops the accumulator up to 56 bits or more. Decoders call it once per symbol, then peek
+    // and consume without checks.
+    void refill() {
+        if (m_count >= max_peek_bits) {
+            return;
+        }
+
+        const const_byte_span window = m_source.buffered();
+        if (window.size() >= sizeof(std::uint64_t)) {
+            // Bytes loaded but not counted are loaded again at the same place next time.
+            if constexpr (order == bit_order::lsb_first) {
+                m_bits |= detail::load_le64(window.data()) << m_count;
+            } else {
+                m_bits |= detail::load_be64(window.data()) >> m_count;
+            }
+            m_source.consume((63 - m_count) >> 3);
+            m_count |= 56;
+        } else {
+            _refill_slow();
+        }
+    }
+
+    // The next count bits (count <= max_peek_bits) without consuming them; the first bit of
+    // the stream is the lowest bit for lsb_first and the highest for msb_first.
+    [[nodiscard]]
+    std::uint64_t peek_bits(unsigned count) const noexcept {
+        if constexpr (order == bit_order::lsb_first) {
+            return m_bits & detail::low_bits(count);
+        } else {
+            return (m_bits >> 1) >> (63 - count);
+        }
+    }
+
+    // count must not exceed bits_available().
+    void consume_bits(unsigned count) noexcept {
+        if constexpr (order == bit_order::lsb_first) {
+            m_bits >>= count;
+        } else {
+            m_bits <<= count;
+        }
+        m_count -= count;
+    }
+
+    // Checked read of count <= max_peek_bits bits. Reading past the end sets failed() and yields 0.
+    [[nodiscard]]
+    std::uint64_t read_bits(unsigned count) {
+        if (m_count < count) {
+            refill();
+            if (m_count < count) {
+                m_failure = true;
+                m_bits = 0;
+                m_count = 0;
+                return 0;
+            }
+        }
+
+        const std::uint64_t value = peek_bits(count);
+        consume_bits(count);
+
+        return value;
+    }
+
+    [[nodiscard]]
+    bool read_bit() {
+        return read_bits(1) != 0;
+    }
+
+    // Drops the bits left in the current byte.
+    void align_to_byte() noexcept {
+        consume_bits(m_count & 7u);
+    }
+
+    // Bits in the accumulator.
+    [[nodiscard]]
+    unsigned bits_available() const noexcept {
+        return m_count;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // True once every bit was consumed.
+    [[nodiscard]]
+    bool at_end() const noexcept {
+        return m_count == 0 && m_source.buffered().empty();
+    }
+
+    // Past the bytes held in the accumulator: align_to_byte() and bits_available() / 8 of them
+    // come first.
+    [[nodiscard]]
+    BlockIterator& source() noexcept {
+        return m_source;
+    }
+
+private:
+    void _refill_slow() {
+        // Stops short of 64 so the fast path's shift by m_count stays defined.
+        while (m_count < max_peek_bits) {
+            const const_byte_span window = m_source.buffered();
+            if (window.empty()) {
+                return;
+            }
+
+            const auto byte = std::to_integer<std::uint64_t>(window[0]);
+            if constexpr (order == bit_order::lsb_first) {
+                m_bits |= byte << m_count;
+            } else {
+                m_bits |= byte << (56 - m_count);
+            }
+            m_source.consume(1);
+            m_count += 8;
+        }
+    }
+
+private:
+    BlockIterator m_source;
+    std::uint64_t m_bits;
+    unsigned m_count;
+    bool m_failure;
+};
+
+// Bitstream writer through an ostreambyte_iterator's buffer. Bits gather in a 64 bit
+// accumulator and leave it as whole 32 bit words, so the iterator sees one fixed size copy per
+// 32 bits instead of a store per byte. flush() (or destruction) pads the last byte with zeroes.
+template <std::size_t buf_size = 4096, bit_order order = bit_order::lsb_first>
+class bit_writer {
+public:
+    using streambuf_type = typename ostreambyte_iterator<buf_size>::streambuf_type;
+    using ostream_type = typename ostreambyte_iterator<buf_size>::ostream_type;
+
+    static constexpr unsigned max_write_bits = 56;
+
+public:
+    explicit bit_writer(streambuf_type* streambuf)
+        : m_out{streambuf}, m_bits{0}, m_count{0}
+    { }
+
+    explicit bit_writer(ostream_type& stream)
+        : m_out{stream}, m_bits{0}, m_count{0}
+    { }
+
+    // Pending bits belong to one stream only.
+    bit_writer(const bit_writer&) = delete;
+    bit_writer& operator=(const bit_writer&) = delete;
+
+    ~bit_writer() {
+        _emit_tail();
+    }
+
+public:
+    // Writes the low count bits of value (count <= max_write_bits); higher bits are ignored.
+    void write_bits(std::uint64_t value, unsigned count) {
+        value &= detail::low_bits(count);
+        if (count > 32) {
+            if constexpr (order == bit_order::lsb_first) {
+                _put(value & 0xFFFFFFFFu, 32);
+                _put(value >> 32, count - 32);
+            } else {
+                _put(value >> 32, count - 32);
+                _put(value & 0xFFFFFFFFu, 32);
+            }
+        } else {
+            _put(value, count);
+        }
+    }
+
+    void write_bit(bool bit) {
+        _put(bit ? 1u : 0u, 1);
+    }
+
+    // Pads the current byte with zero bits.
+    void align_to_byte() {
+        if (const unsigned partial = m_count & 7u; partial != 0) {
+            _put(0, 8 - partial);
+        }
+    }
+
+    // Writes the padded tail and commits the iterator's buffer. More bits may follow, starting
+    // on a byte boundary.
+    bool flush() {
+        _emit_tail();
+        return m_out.flush();
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_out.failed();
+    }
+
+private:
+    // count <= 32, and m_count < 32 between calls, so nothing is shifted out.
+    void _put(std::uint64_t value, unsigned count) {
+        if constexpr (order == bit_order::lsb_first) {
+            m_bits |= value << m_count;
+        } else {
+            m_bits = (m_bits << count) | value;
+        }
+        m_count += count;
+
+        if (m_count >= 32) {
+            std::uint32_t word;
+            if constexpr (order == bit_order::lsb_first) {
+                word = static_cast<std::uint32_t>(m_bits);
+                m_bits >>= 32;
+            } else {
+                word = static_cast<std::uint32_t>(m_bits >> (m_count - 32));
+            }
+            m_count -= 32;
+            _store(word, 4);
+        }
+    }
+
+    void _emit_tail() {
+        align_to_byte();
+        if (m_count == 0) {
+            return;
+        }
+
+        std::uint32_t word;
+        if constexpr (order == bit_order::lsb_first) {
+            word = static_cast<std::uint32_t>(m_bits);
+        } else {
+            word = static_cast<std::uint32_t>(m_bits << (32 - m_count));
+        }
+        _store(word, m_count / 8);
+        m_bits = 0;
+        m_count = 0;
+    }
+
+    // The first `bytes` bytes of word in stream order.
+    void _store(std::uint32_t word, unsigned bytes) {
+        const bool swap = (order == bit_order::lsb_first) == detail::host_is_big_endian;
+        if (swap) {
+            word = detail::byteswap(word);
+        }
+
+        std::array<std::byte, 4> out;
+        std::memcpy(out.data(), &word, out.size());
+        m_out = const_byte_span{out.data(), bytes};
+    }
+
+private:
+    ostreambyte_iterator<buf_size> m_out;
+    std::uint64_t m_bits;
+    unsigned m_count;
+};
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_CDC_HPP_
+#define MRT_STREAMBYTE_CDC_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+namespace mrt {
+
+namespace detail {
+    // FastCDC's Gear table: one random 64 bit word per byte value, here from splitmix64 so every
+    // build cuts the same boundaries.
+    [[nodiscard]] constexpr
+    std::array<std::uint64_t, 256> make_gear_table() noexcept {
+        std::array<std::uint64_t, 256> table{};
+        std::uint64_t state = 0x5EEDCDC0FA57CDC1ull;
+        for (auto& entry : table) {
+            state += 0x9E3779B97F4A7C15ull;
+            std::uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            entry = z ^ (z >> 31);
+        }
+
+        return table;
+    }
+
+    inline constexpr std::array<std::uint64_t, 256> gear_table = make_gear_table();
+
+    // The gear hash shifts left, so its top bits depend on the last 64 bytes; masks test those.
+    [[nodiscard]] constexpr
+    std::uint64_t gear_mask(unsigned bits) noexcept {
+        return bits == 0 ? 0 : ~std::uint64_t{0} << (64 - std::min(bits, 63u));
+    }
+
+    // Scans [first, last) for a gear boundary; returns the position after it, or last.
+    [[nodiscard]] inline
+    const std::byte* gear_scan(const std::byte* first, const std::byte* last, std::uint64_t& hash, std::uint64_t mask) noexcept {
+        // Two bytes per round keep the loop overhead off the hash's serial dependency chain.
+        for (; last - first >= 2; first += 2) {
+            hash = (hash << 1) + gear_table[std::to_integer<std::uint8_t>(first[0])];
+            if ((hash & mask) == 0) {
+                return first + 1;
+            }
+
+            hash = (hash << 1) + gear_table[std::to_integer<std::uint8_t>(first[1])];
+            if ((hash & mask) == 0) {
+                return first + 2;
+            }
+        }
+
+        if (first != last) {
+            hash = (hash << 1) + gear_table[std::to_integer<std::uint8_t>(first[0])];
+            ++first;
+        }
+
+        return first;
+    }
+}
+
+// Content-defined chunks of a block iterator (FastCDC with normalized chunking): a boundary falls
+// where the gear hash of the last bytes matches a mask, so inserting or removing bytes only
+// moves the chunks around the edit and unchanged data dedupes. Chunks are min_size to
+// max_size bytes and average about avg_size; the first min_size bytes of a chunk are not hashed.
+// Chunks inside one block are spans into it; a chunk crossing a block boundary is gathered in a
+// buffer. Either way a chunk stays valid until the iterator is incremented.
+template <typename BlockIterator>
+class cdc_chunk_view {
+public:
+    using size_type = std::size_t;
+
+    static_assert(detail::is_block_iterator<BlockIterator>::value, "cdc_chunk_view needs a block iterator");
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const_byte_span;
+        using pointer = void;
+        using reference = const_byte_span;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr
+        iterator() noexcept
+            : m_view{nullptr}
+        { }
+
+        [[nodiscard]]
+        const_byte_span operator*() const noexcept {
+            return m_view->m_chunk;
+        }
+
+        iterator& operator++() {
+            m_view->_next();
+
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        [[nodiscard]]
+        bool operator==(const iterator& rhs) const noexcept {
+            return _at_end() == rhs._at_end();
+        }
+
+        [[nodiscard]]
+        bool operator!=(const iterator& rhs) const noexcept {
+            return !(*this == rhs);
+        }
+
+#ifdef __cpp_lib_ranges
+        [[nodiscard]] friend
+        bool operator==(const iterator& it, std::default_sentinel_t) noexcept {
+            return it._at_end();
+        }
+#endif
+
+    private:
+        friend cdc_chunk_view;
+        constexpr explicit
+        iterator(cdc_chunk_view* view) noexcept
+            : m_view{view}
+        { }
+
+        [[nodiscard]]
+        bool _at_end() const noexcept {
+            return m_view == nullptr || m_view->m_chunk.size() == 0;
+        }
+
+        cdc_chunk_view* m_view;
+    };
+
+public:
+    // avg_size is rounded down to a power of two; min_size <= avg_size <= max_size is enforced.
+    cdc_chunk_view(BlockIterator source, size_type min_size, size_type avg_size, size_type max_size)
+        : m_source{std::move(source)}, m_consumed{0}, m_started{false}
+    {
+        unsigned bits = 0;
+        while ((size_type{2} << bits) <= std::max<size_type>(avg_size, 1)) {
+            ++bits;
+        }
+
+        m_avg_size = size_type{1} << bits;
+        m_min_size = std::min(min_size, m_avg_size);
+        m_max_size = std::max(max_size, m_avg_size);
+        // Normalization level 2: harder to cut before avg_size, easier after.
+        m_mask_small = detail::gear_mask(bits + 2);
+        m_mask_large = detail::gear_mask(bits >= 2 ? bits - 2 : 0);
+    }
+
+    [[nodiscard]]
+    iterator begin() {
+        if (!m_started) {
+            m_started = true;
+            _next();
+        }
+
+        return iterator{this};
+    }
+
+    [[nodiscard]]
+    iterator end() noexcept {
+        return iterator{};
+    }
+
+private:
+    void _next() {
+        // The previous chunk, when it was a span into the block, is only consumed now.
+        m_source.consume(std::exchange(m_consumed, 0));
+        m_carry.clear();
+        m_chunk = {};
+
+        size_type length = 0;
+        std::uint64_t hash = 0;
+        for (;;) {
+            const const_byte_span window = m_source.buffered();
+            if (window.size() == 0) {
+                m_chunk = const_byte_span{m_carry.data(), m_carry.size()};
+                return;
+            }
+
+            const std::byte* first = window.data();
+            const std::byte* last = first + std::min(window.size(), m_max_size - length);
+            const std::byte* cursor = first + std::min<size_type>(m_min_size > length ? m_min_size - length : 0, last - first);
+            const std::byte* small_end = first + std::min<size_type>(m_avg_size > length ? m_avg_size - length : 0, last - first);
+
+            bool cut = false;
+            if (cursor < small_end) {
+                cursor = detail::gear_scan(cursor, small_end, hash, m_mask_small);
+                cut = cursor != small_end || (hash & m_mask_small) == 0;
+            }
+            if (!cut && cursor < last) {
+                cursor = detail::gear_scan(cursor, last, hash, m_mask_large);
+                cut = cursor != last || (hash & m_mask_large) == 0;
+            }
+
+            const auto taken = static_cast<size_type>(cursor - first);
+            length += taken;
+            cut = cut || length == m_max_size;
+
+            if (cut && m_carry.empty()) {
+                m_chunk = const_byte_span{first, taken};
+                m_consumed = taken;
+                return;
+            }
+
+            m_carry.insert(m_carry.end(), first, cursor);
+            m_source.consume(taken);
+            if (cut) {
+                m_chunk = const_byte_span{m_carry.data(), m_carry.size()};
+                return;
+            }
+        }
+    }
+
+private:
+    BlockIterator m_source;
+    size_type m_min_size;
+    size_type m_avg_size;
+    size_type m_max_size;
+    std::uint64_t m_mask_small;
+    std::uint64_t m_mask_large;
+    std::vector<std::byte> m_carry;
+    const_byte_span m_chunk;
+    size_type m_consumed;
+    bool m_started;
+};
+
+// Defaults follow the FastCDC paper: 2 KiB / 8 KiB / 64 KiB.
+inline constexpr std::size_t default_cdc_min_size = 2 * 1024;
+inline constexpr std::size_t default_cdc_avg_size = 8 * 1024;
+inline constexpr std::size_t default_cdc_max_size = 64 * 1024;
+
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+cdc_chunk_view<Iterator> cdc_chunks(Iterator it, std::size_t min_size = default_cdc_min_size,
+                                    std::size_t avg_size = default_cdc_avg_size, std::size_t max_size = default_cdc_max_size) {
+    return cdc_chunk_view<Iterator>{std::move(it), min_size, avg_size, max_size};
+}
+
+// Reads blocks of four maximum chunks, so most chunks are handed out without a copy.
+inline
+cdc_chunk_view<shared_istreambyte_iterator<>> cdc_chunks(std::basic_streambuf<char>* streambuf, std::size_t min_size = default_cdc_min_size,
+                                                         std::size_t avg_size = default_cdc_avg_size, std::size_t max_size = default_cdc_max_size) {
+    const std::size_t block_size = std::max(shared_istreambyte_iterator<>::default_block_size, 4 * max_size);
+    return cdc_chunk_view<shared_istreambyte_iterator<>>{shared_istreambyte_iterator<>{streambuf, block_size}, min_size, avg_size, max_size};
+}
+
+inline
+cdc_chunk_view<shared_istreambyte_iterator<>> cdc_chunks(std::basic_istream<char>& stream, std::size_t min_size = default_cdc_min_size,
+                                                         std::size_t avg_size = default_cdc_avg_size, std::size_t max_size = default_cdc_max_size) {
+    return cdc_chunks(stream.rdbuf(), min_size, avg_size, max_size);
+}
+
+}
+
+#endif
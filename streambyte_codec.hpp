@@ -0,0 +1,951 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_CODEC_HPP_
+#define MRT_STREAMBYTE_CODEC_HPP_
+
+#include "streambyte.hpp"
+#include "streambyte_compress.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Kernels are picked at compile time from the target flags (e.g. -mavx2); table driven scalar code otherwise.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MRT_STREAMBYTE_CODEC_NEON
+#endif
+
+namespace mrt {
+
+enum class base64_alphabet {
+    // RFC 4648 section 4: + and /.
+    standard,
+    // RFC 4648 section 5, safe in URLs and file names: - and _.
+    url
+};
+
+[[nodiscard]] constexpr
+std::size_t base64_encoded_size(std::size_t bytes, bool padding = true) noexcept {
+    return padding ? (bytes + 2) / 3 * 4 : bytes / 3 * 4 + (bytes % 3 == 0 ? 0 : bytes % 3 + 1);
+}
+
+// Upper bound; padding makes the actual size up to two bytes smaller.
+[[nodiscard]] constexpr
+std::size_t base64_decoded_size(std::size_t chars) noexcept {
+    return chars / 4 * 3 + (chars % 4 == 0 ? 0 : chars % 4 - 1);
+}
+
+namespace detail {
+    inline constexpr char base64_standard_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    inline constexpr char base64_url_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    inline constexpr char hex_lower_chars[] = "0123456789abcdef";
+    inline constexpr char hex_upper_chars[] = "0123456789ABCDEF";
+
+    // 0xff marks characters outside the alphabet, '=' included.
+    [[nodiscard]] constexpr
+    std::array<std::uint8_t, 256> make_base64_table(const char* chars) noexcept {
+        std::array<std::uint8_t, 256> table{};
+        for (auto& entry : table) {
+            entry = 0xff;
+        }
+
+        for (std::uint8_t i = 0; i < 64; ++i) {
+            table[static_cast<unsigned char>(chars[i])] = i;
+        }
+
+        return table;
+    }
+
+    [[nodiscard]] constexpr
+    std::array<std::uint8_t, 256> make_hex_table() noexcept {
+        std::array<std::uint8_t, 256> table{};
+        for (auto& entry : table) {
+            entry = 0xff;
+        }
+
+        for (std::uint8_t i = 0; i < 16; ++i) {
+            table[static_cast<unsigned char>(hex_lower_chars[i])] = i;
+            table[static_cast<unsigned char>(hex_upper_chars[i])] = i;
+        }
+
+        return table;
+    }
+
+    inline constexpr std::array<std::uint8_t, 256> base64_standard_table = make_base64_table(base64_standard_chars);
+    inline constexpr std::array<std::uint8_t, 256> base64_url_table = make_base64_table(base64_url_chars);
+    inline constexpr std::array<std::uint8_t, 256> hex_table = make_hex_table();
+
+    [[nodiscard]] constexpr
+    const char* base64_chars(base64_alphabet alphabet) noexcept {
+        return alphabet == base64_alphabet::url ? base64_url_chars : base64_standard_chars;
+    }
+
+    [[nodiscard]] constexpr
+    const std::uint8_t* base64_table(base64_alphabet alphabet) noexcept {
+        return alphabet == base64_alphabet::url ? base64_url_table.data() : base64_standard_table.data();
+    }
+
+    // Encodes `groups` whole 3 byte groups into 4 characters each.
+    inline
+    void base64_encode_groups(const std::uint8_t* in, std::size_t groups, char* out, base64_alphabet alphabet) noexcept {
+        const char* chars = base64_chars(alphabet);
+#if defined(__AVX2__)
+        // Mula / Lemire: each lane loads 16 bytes and keeps 12, so the last load reaches 4 bytes
+        // past the 24 it encodes; the scalar loop takes the final groups.
+        const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const char c62 = chars[62];
+        const char c63 = chars[63];
+        const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '0' - 52, static_cast<char>(c62 - 62),
+                                                 static_cast<char>(c63 - 63), 'A', 0, 0,
+                                                 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '0' - 52, static_cast<char>(c62 - 62),
+                                                 static_cast<char>(c63 - 63), 'A', 0, 0);
+        for (; groups >= 10; groups -= 8, in += 24, out += 32) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12));
+            const __m256i bytes = _mm256_shuffle_epi8(
+                _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), spread);
+
+            // Per 32 bit word [b1 b0 b2 b1]: move the four sextets to the bottom of their own byte.
+            const __m256i s0s2 = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)),
+                                                    _mm256_set1_epi32(0x04000040));
+            const __m256i s1s3 = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)),
+                                                    _mm256_set1_epi32(0x01000010));
+            const __m256i sextets = _mm256_or_si256(s0s2, s1s3);
+
+            // 0 for a-z, 1..12 for digits, 62 and 63, 13 for A-Z: an index into the offsets.
+            __m256i range = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+            range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets),
+                                                            _mm256_set1_epi8(13)));
+            const __m256i text = _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, range));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), text);
+        }
+#elif defined(MRT_STREAMBYTE_CODEC_NEON)
+        const uint8x16x4_t lut = {{vld1q_u8(reinterpret_cast<const std::uint8_t*>(chars)),
+                                   vld1q_u8(reinterpret_cast<const std::uint8_t*>(chars) + 16),
+                                   vld1q_u8(reinterpret_cast<const std::uint8_t*>(chars) + 32),
+                                   vld1q_u8(reinterpret_cast<const std::uint8_t*>(chars) + 48)}};
+        const uint8x16_t mask = vdupq_n_u8(0x3f);
+        for (; groups >= 16; groups -= 16, in += 48, out += 64) {
+            // De-interleaving load: val[k] holds byte k of sixteen groups.
+            const uint8x16x3_t bytes = vld3q_u8(in);
+            uint8x16x4_t text;
+            text.val[0] = vshrq_n_u8(bytes.val[0], 2);
+            text.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(bytes.val[1], 4), vshlq_n_u8(bytes.val[0], 4)), mask);
+            text.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(bytes.val[2], 6), vshlq_n_u8(bytes.val[1], 2)), mask);
+            text.val[3] = vandq_u8(bytes.val[2], mask);
+            for (auto& sextets : text.val) {
+                sextets = vqtbl4q_u8(lut, sextets);
+            }
+
+            vst4q_u8(reinterpret_cast<std::uint8_t*>(out), text);
+        }
+#endif
+        for (; groups != 0; --groups, in += 3, out += 4) {
+            const std::uint32_t word = std::uint32_t{in[0]} << 16 | std::uint32_t{in[1]} << 8 | in[2];
+            out[0] = chars[word >> 18];
+            out[1] = chars[word >> 12 & 63];
+            out[2] = chars[word >> 6 & 63];
+            out[3] = chars[word & 63];
+        }
+    }
+
+    // Decodes up to `quads` groups of 4 characters into 3 bytes each. Stops in front of the first
+    // group holding anything but alphabet characters (padding included) and returns the number decoded.
+    inline
+    std::size_t base64_decode_quads(const char* in, std::size_t quads, std::uint8_t* out, base64_alphabet alphabet) noexcept {
+        const std::size_t total = quads;
+#if defined(__AVX2__) || defined(MRT_STREAMBYTE_CODEC_NEON)
+        const char* chars = base64_chars(alphabet);
+#endif
+#if defined(__AVX2__)
+        // x <= n, unsigned.
+        const auto at_most = [](__m256i x, char n) {
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(n)), x);
+        };
+
+        for (; quads >= 8; quads -= 8, in += 32, out += 24) {
+            const __m256i text = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            const __m256i upper = _mm256_sub_epi8(text, _mm256_set1_epi8('A'));
+            const __m256i lower = _mm256_sub_epi8(text, _mm256_set1_epi8('a'));
+            const __m256i digit = _mm256_sub_epi8(text, _mm256_set1_epi8('0'));
+            const __m256i is_upper = at_most(upper, 25);
+            const __m256i is_lower = at_most(lower, 25);
+            const __m256i is_digit = at_most(digit, 9);
+            const __m256i is_62 = _mm256_cmpeq_epi8(text, _mm256_set1_epi8(chars[62]));
+            const __m256i is_63 = _mm256_cmpeq_epi8(text, _mm256_set1_epi8(chars[63]));
+            const __m256i valid = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(is_upper, is_lower), is_digit),
+                                                  _mm256_or_si256(is_62, is_63));
+            if (_mm256_movemask_epi8(valid) != -1) {
+                break;
+            }
+
+            __m256i sextets = _mm256_and_si256(is_upper, upper);
+            sextets = _mm256_or_si256(sextets, _mm256_and_si256(is_lower, _mm256_add_epi8(lower, _mm256_set1_epi8(26))));
+            sextets = _mm256_or_si256(sextets, _mm256_and_si256(is_digit, _mm256_add_epi8(digit, _mm256_set1_epi8(52))));
+            sextets = _mm256_or_si256(sextets, _mm256_and_si256(is_62, _mm256_set1_epi8(62)));
+            sextets = _mm256_or_si256(sextets, _mm256_and_si256(is_63, _mm256_set1_epi8(63)));
+
+            // Pairs of sextets into 12 bits, pairs of those into the 24 bit group, then drop the
+            // top byte of every word and close the gap between the lanes.
+            const __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+            const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            const __m256i packed = _mm256_shuffle_epi8(words, _mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            const __m256i bytes = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(bytes, 1));
+        }
+#elif defined(MRT_STREAMBYTE_CODEC_NEON)
+        const auto decode = [&](uint8x16_t text, uint8x16_t& invalid) {
+            const uint8x16_t upper = vsubq_u8(text, vdupq_n_u8('A'));
+            const uint8x16_t lower = vsubq_u8(text, vdupq_n_u8('a'));
+            const uint8x16_t digit = vsubq_u8(text, vdupq_n_u8('0'));
+            const uint8x16_t is_upper = vcleq_u8(upper, vdupq_n_u8(25));
+            const uint8x16_t is_lower = vcleq_u8(lower, vdupq_n_u8(25));
+            const uint8x16_t is_digit = vcleq_u8(digit, vdupq_n_u8(9));
+            const uint8x16_t is_62 = vceqq_u8(text, vdupq_n_u8(static_cast<std::uint8_t>(chars[62])));
+            const uint8x16_t is_63 = vceqq_u8(text, vdupq_n_u8(static_cast<std::uint8_t>(chars[63])));
+            invalid = vorrq_u8(invalid, vmvnq_u8(vorrq_u8(vorrq_u8(vorrq_u8(is_upper, is_lower), is_digit),
+                                                          vorrq_u8(is_62, is_63))));
+
+            return vbslq_u8(is_upper, upper, vbslq_u8(is_lower, vaddq_u8(lower, vdupq_n_u8(26)),
+                            vbslq_u8(is_digit, vaddq_u8(digit, vdupq_n_u8(52)),
+                            vbslq_u8(is_62, vdupq_n_u8(62), vdupq_n_u8(63)))));
+        };
+
+        for (; quads >= 16; quads -= 16, in += 64, out += 48) {
+            const uint8x16x4_t text = vld4q_u8(reinterpret_cast<const std::uint8_t*>(in));
+            uint8x16_t invalid = vdupq_n_u8(0);
+            const uint8x16_t s0 = decode(text.val[0], invalid);
+            const uint8x16_t s1 = decode(text.val[1], invalid);
+            const uint8x16_t s2 = decode(text.val[2], invalid);
+            const uint8x16_t s3 = decode(text.val[3], invalid);
+            if (vmaxvq_u8(invalid) != 0) {
+                break;
+            }
+
+            uint8x16x3_t bytes;
+            bytes.val[0] = vorrq_u8(vshlq_n_u8(s0, 2), vshrq_n_u8(s1, 4));
+            bytes.val[1] = vorrq_u8(vshlq_n_u8(s1, 4), vshrq_n_u8(s2, 2));
+            bytes.val[2] = vorrq_u8(vshlq_n_u8(s2, 6), s3);
+            vst3q_u8(out, bytes);
+        }
+#endif
+        const std::uint8_t* table = base64_table(alphabet);
+        for (; quads != 0; --quads, in += 4, out += 3) {
+            const std::uint8_t s0 = table[static_cast<unsigned char>(in[0])];
+            const std::uint8_t s1 = table[static_cast<unsigned char>(in[1])];
+            const std::uint8_t s2 = table[static_cast<unsigned char>(in[2])];
+            const std::uint8_t s3 = table[static_cast<unsigned char>(in[3])];
+            if (((s0 | s1 | s2 | s3) & 0x80) != 0) {
+                break;
+            }
+
+            const std::uint32_t word = std::uint32_t{s0} << 18 | std::uint32_t{s1} << 12 | std::uint32_t{s2} << 6 | s3;
+            out[0] = static_cast<std::uint8_t>(word >> 16);
+            out[1] = static_cast<std::uint8_t>(word >> 8);
+            out[2] = static_cast<std::uint8_t>(word);
+        }
+
+        return total - quads;
+    }
+
+    inline
+    void hex_encode_bytes(const std::uint8_t* in, std::size_t size, char* out, bool uppercase) noexcept {
+        const char* chars = uppercase ? hex_upper_chars : hex_lower_chars;
+#if defined(__AVX2__)
+        const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chars)));
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        for (; size >= 32; size -= 32, in += 32, out += 64) {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            const __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble);
+            const __m256i low = _mm256_and_si256(bytes, nibble);
+            // The unpacks work per lane: first holds bytes 0-7 and 16-23, second 8-15 and 24-31.
+            const __m256i first = _mm256_shuffle_epi8(lut, _mm256_unpacklo_epi8(high, low));
+            const __m256i second = _mm256_shuffle_epi8(lut, _mm256_unpackhi_epi8(high, low));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(first, second, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+        }
+#elif defined(MRT_STREAMBYTE_CODEC_NEON)
+        const uint8x16_t lut = vld1q_u8(reinterpret_cast<const std::uint8_t*>(chars));
+        for (; size >= 16; size -= 16, in += 16, out += 32) {
+            const uint8x16_t bytes = vld1q_u8(in);
+            const uint8x16x2_t text = {{vqtbl1q_u8(lut, vshrq_n_u8(bytes, 4)),
+                                        vqtbl1q_u8(lut, vandq_u8(bytes, vdupq_n_u8(0x0f)))}};
+            vst2q_u8(reinterpret_cast<std::uint8_t*>(out), text);
+        }
+#endif
+        for (; size != 0; --size, ++in, out += 2) {
+            out[0] = chars[*in >> 4];
+            out[1] = chars[*in & 15];
+        }
+    }
+
+    // Decodes up to `pairs` pairs of hex digits (either case); stops in front of the first pair
+    // holding anything else and returns the number decoded.
+    inline
+    std::size_t hex_decode_pairs(const char* in, std::size_t pairs, std::uint8_t* out) noexcept {
+        const std::size_t total = pairs;
+#if defined(__AVX2__)
+        const auto nibbles = [](__m256i text, __m256i& valid) {
+            const __m256i digit = _mm256_sub_epi8(text, _mm256_set1_epi8('0'));
+            // Folding to lower case puts A-F on a-f; nothing else lands there.
+            const __m256i letter = _mm256_sub_epi8(_mm256_or_si256(text, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+            const __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+            const __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+            valid = _mm256_or_si256(is_digit, is_letter);
+
+            return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                                   _mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+        };
+
+        for (; pairs >= 32; pairs -= 32, in += 64, out += 32) {
+            __m256i valid_first;
+            __m256i valid_second;
+            const __m256i first = nibbles(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)), valid_first);
+            const __m256i second = nibbles(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32)), valid_second);
+            if (_mm256_movemask_epi8(_mm256_and_si256(valid_first, valid_second)) != -1) {
+                break;
+            }
+
+            // high * 16 + low for every pair, then narrow the 16 bit results back to bytes.
+            const __m256i weights = _mm256_set1_epi16(0x0110);
+            const __m256i words_first = _mm256_maddubs_epi16(first, weights);
+            const __m256i words_second = _mm256_maddubs_epi16(second, weights);
+            const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words_first, words_second), 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), bytes);
+        }
+#elif defined(MRT_STREAMBYTE_CODEC_NEON)
+        const auto nibbles = [](uint8x16_t text, uint8x16_t& invalid) {
+            const uint8x16_t digit = vsubq_u8(text, vdupq_n_u8('0'));
+            const uint8x16_t letter = vsubq_u8(vorrq_u8(text, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+            const uint8x16_t is_digit = vcleq_u8(digit, vdupq_n_u8(9));
+            const uint8x16_t is_letter = vcleq_u8(letter, vdupq_n_u8(5));
+            invalid = vorrq_u8(invalid, vmvnq_u8(vorrq_u8(is_digit, is_letter)));
+
+            return vbslq_u8(is_digit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+        };
+
+        for (; pairs >= 16; pairs -= 16, in += 32, out += 16) {
+            // De-interleaving load: val[0] holds the high digits, val[1] the low ones.
+            const uint8x16x2_t text = vld2q_u8(reinterpret_cast<const std::uint8_t*>(in));
+            uint8x16_t invalid = vdupq_n_u8(0);
+            const uint8x16_t high = nibbles(text.val[0], invalid);
+            const uint8x16_t low = nibbles(text.val[1], invalid);
+            if (vmaxvq_u8(invalid) != 0) {
+                break;
+            }
+
+            vst1q_u8(out, vorrq_u8(vshlq_n_u8(high, 4), low));
+        }
+#endif
+        for (; pairs != 0; --pairs, in += 2, ++out) {
+            const std::uint8_t high = hex_table[static_cast<unsigned char>(in[0])];
+            const std::uint8_t low = hex_table[static_cast<unsigned char>(in[1])];
+            if (((high | low) & 0x80) != 0) {
+                break;
+            }
+
+            *out = static_cast<std::uint8_t>(high << 4 | low);
+        }
+
+        return total - pairs;
+    }
+}
+
+namespace detail {
+    // Drives one of the codecs below straight into dest's block. step(out, out_last) returns true
+    // once it needs no more room; it is first tried without any, so trailing input that produces
+    // nothing (a partial group, padding) never asks for a window a full span_byte_writer lacks.
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy, typename Step>
+    bool transcode_into(ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest, Step&& step) {
+        byte_span window{};
+        for (;;) {
+            char* const first = reinterpret_cast<char*>(window.data());
+            char* out = first;
+            const bool done = step(out, first + window.size());
+            if (!window.empty()) {
+                block_access::commit_window(dest, static_cast<std::size_t>(out - first));
+            }
+
+            if (done) {
+                return true;
+            }
+
+            window = block_access::write_window(dest);
+            if (window.empty()) {
+                return false;
+            }
+        }
+    }
+
+    // What compress_streambuf calls: encodes [data, data + size) through a staging block.
+    template <typename Encoder, typename Sink>
+    bool encode_staged(Encoder& encoder, std::vector<char>& buffer, const char* data, std::size_t size,
+                       encode_mode mode, Sink&& sink) {
+        char* const first = buffer.data();
+        char* const last = first + buffer.size();
+        const char* const data_last = data + size;
+        while (data != data_last) {
+            char* out = first;
+            encoder.encode_into(data, data_last, out, last);
+            if (out != first && !sink(first, static_cast<std::size_t>(out - first))) {
+                return false;
+            }
+        }
+
+        if (mode == encode_mode::end) {
+            char* out = first;
+            encoder.finish_into(out, last);
+            if (out != first && !sink(first, static_cast<std::size_t>(out - first))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Encoder, std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool encode_into_iterator(Encoder& encoder, const_byte_span bytes, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        const char* in = reinterpret_cast<const char*>(bytes.data());
+        const char* const in_last = in + bytes.size();
+        return transcode_into(dest, [&](char*& out, char* out_last) {
+            return encoder.encode_into(in, in_last, out, out_last) && in == in_last;
+        });
+    }
+
+    template <typename Decoder, std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool decode_into_iterator(Decoder& decoder, const_byte_span text, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        const char* in = reinterpret_cast<const char*>(text.data());
+        const char* const in_last = in + text.size();
+        return transcode_into(dest, [&](char*& out, char* out_last) {
+            return !decoder.decode(in, in_last, out, out_last) || in == in_last;
+        }) && !decoder.failed();
+    }
+}
+
+// Base64 encoding stage. Plugs into compress_streambuf like the compression codecs, or writes
+// into an ostreambyte_iterator's block through encode_to() / finish_to(), one call per block or
+// chunk. Input that does not fill a 3 byte group is carried to the next call; finishing writes
+// it out with its padding. A flush cannot cut a group short, so it emits whole groups only.
+class base64_encoder {
+public:
+    static constexpr std::size_t default_block_size = std::size_t{3} << 14;
+
+public:
+    explicit base64_encoder(base64_alphabet alphabet = base64_alphabet::standard, bool padding = true) noexcept
+        : m_alphabet{alphabet}, m_padding{padding}, m_carry{}, m_carry_size{0},
+          m_pending{}, m_pending_first{0}, m_pending_last{0}
+    { }
+
+public:
+    [[nodiscard]]
+    std::size_t block_size() const noexcept {
+        return default_block_size;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return false;
+    }
+
+    // Encodes as much of [in, in_last) as fits in [out, out_last); never fails, always returns true.
+    bool encode_into(const char*& in, const char* in_last, char*& out, char* out_last) noexcept {
+        if (!_drain(out, out_last)) {
+            return true;
+        }
+
+        if (m_carry_size != 0) {
+            while (m_carry_size < 3 && in != in_last) {
+                m_carry[m_carry_size++] = static_cast<std::uint8_t>(*in++);
+            }
+
+            if (m_carry_size < 3) {
+                return true;
+            }
+
+            _stage_group(m_carry.data(), 4);
+            m_carry_size = 0;
+            if (!_drain(out, out_last)) {
+                return true;
+            }
+        }
+
+        const std::size_t groups = std::min(static_cast<std::size_t>(in_last - in) / 3,
+                                            static_cast<std::size_t>(out_last - out) / 4);
+        detail::base64_encode_groups(reinterpret_cast<const std::uint8_t*>(in), groups, out, m_alphabet);
+        in += groups * 3;
+        out += groups * 4;
+
+        if (in_last - in >= 3) {
+            // Less than a group's worth of room left: split the next one across windows.
+            if (out != out_last) {
+                _stage_group(reinterpret_cast<const std::uint8_t*>(in), 4);
+                in += 3;
+                _drain(out, out_last);
+            }
+
+            return true;
+        }
+
+        while (in != in_last) {
+            m_carry[m_carry_size++] = static_cast<std::uint8_t>(*in++);
+        }
+
+        return true;
+    }
+
+    // Writes the carried tail, padded if asked; returns true once all of it is out.
+    bool finish_into(char*& out, char* out_last) noexcept {
+        if (!_drain(out, out_last)) {
+            return false;
+        }
+
+        if (m_carry_size != 0) {
+            const std::uint8_t tail[3] = {m_carry[0], m_carry_size > 1 ? m_carry[1] : std::uint8_t{0}, 0};
+            _stage_group(tail, m_padding ? 4 : m_carry_size + 1);
+            for (std::size_t i = m_carry_size + 1; i < m_pending_last; ++i) {
+                m_pending[i] = '=';
+            }
+
+            m_carry_size = 0;
+        }
+
+        return _drain(out, out_last);
+    }
+
+    template <typename Sink>
+    bool encode(const char* data, std::size_t size, encode_mode mode, Sink&& sink) {
+        if (m_buffer.empty()) {
+            m_buffer.resize(base64_encoded_size(default_block_size));
+        }
+
+        return detail::encode_staged(*this, m_buffer, data, size, mode, sink);
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool encode_to(const_byte_span bytes, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::encode_into_iterator(*this, bytes, dest);
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool finish_to(ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::transcode_into(dest, [&](char*& out, char* out_last) { return finish_into(out, out_last); });
+    }
+
+private:
+    void _stage_group(const std::uint8_t* bytes, std::size_t chars) noexcept {
+        detail::base64_encode_groups(bytes, 1, m_pending.data(), m_alphabet);
+        m_pending_first = 0;
+        m_pending_last = chars;
+    }
+
+    // Returns true once nothing is pending.
+    bool _drain(char*& out, char* out_last) noexcept {
+        while (m_pending_first != m_pending_last && out != out_last) {
+            *out++ = m_pending[m_pending_first++];
+        }
+
+        return m_pending_first == m_pending_last;
+    }
+
+private:
+    base64_alphabet m_alphabet;
+    bool m_padding;
+    std::array<std::uint8_t, 3> m_carry;
+    std::size_t m_carry_size;
+    std::array<char, 4> m_pending;
+    std::size_t m_pending_first;
+    std::size_t m_pending_last;
+    std::vector<char> m_buffer;
+};
+
+// Base64 decoding stage, for decompress_streambuf or decode_to(). Whole groups go through the
+// SIMD kernel; the rest, padding included, one character at a time. Decoding is strict, so
+// whitespace and line breaks fail it. Padding is optional, but a group cut after one character
+// is an error, and padded streams may follow each other.
+class base64_decoder {
+public:
+    static constexpr std::size_t default_buffer_size = std::size_t{1} << 16;
+
+public:
+    explicit base64_decoder(base64_alphabet alphabet = base64_alphabet::standard) noexcept
+        : m_alphabet{alphabet}, m_bits{0}, m_bit_count{0}, m_position{0}, m_padding{0}, m_failure{false}
+    { }
+
+public:
+    [[nodiscard]] std::size_t input_size() const noexcept { return default_buffer_size; }
+    [[nodiscard]] std::size_t output_size() const noexcept { return default_buffer_size / 4 * 3; }
+    [[nodiscard]] bool failed() const noexcept { return m_failure; }
+
+    [[nodiscard]]
+    bool idle() const noexcept {
+        return !m_failure && m_padding == 0 && m_position != 1;
+    }
+
+    bool decode(const char*& in, const char* in_last, char*& out, char* out_last) noexcept {
+        const std::uint8_t* table = detail::base64_table(m_alphabet);
+        while (in != in_last && !m_failure) {
+            if (m_position == 0) {
+                const std::size_t quads = std::min(static_cast<std::size_t>(in_last - in) / 4,
+                                                   static_cast<std::size_t>(out_last - out) / 3);
+                const std::size_t done = detail::base64_decode_quads(in, quads, reinterpret_cast<std::uint8_t*>(out), m_alphabet);
+                in += done * 4;
+                out += done * 3;
+                if (in == in_last) {
+                    break;
+                }
+            }
+
+            const char c = *in;
+            if (c == '=') {
+                _pad();
+                ++in;
+                continue;
+            }
+
+            const std::uint8_t sextet = table[static_cast<unsigned char>(c)];
+            if (sextet > 63 || m_padding != 0) {
+                m_failure = true;
+                break;
+            }
+
+            // Every character but a group's first completes a byte.
+            if (m_position != 0 && out == out_last) {
+                break;
+            }
+
+            m_bits = m_bits << 6 | sextet;
+            m_bit_count += 6;
+            if (m_bit_count >= 8) {
+                m_bit_count -= 8;
+                *out++ = static_cast<char>(m_bits >> m_bit_count);
+                m_bits &= (1u << m_bit_count) - 1;
+            }
+
+            m_position = (m_position + 1) & 3;
+            ++in;
+        }
+
+        return !m_failure;
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool decode_to(const_byte_span text, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::decode_into_iterator(*this, text, dest);
+    }
+
+    // True when the text ended on a group boundary (or a valid unpadded tail).
+    [[nodiscard]]
+    bool finish() const noexcept {
+        return idle();
+    }
+
+private:
+    void _pad() noexcept {
+        if (m_padding != 0) {
+            m_padding = 0;
+            m_position = 0;
+        } else if (m_position == 2) {
+            m_padding = 1;
+            m_position = 3;
+        } else if (m_position == 3) {
+            m_position = 0;
+        } else {
+            m_failure = true;
+        }
+
+        m_bits = 0;
+        m_bit_count = 0;
+    }
+
+private:
+    base64_alphabet m_alphabet;
+    std::uint32_t m_bits;
+    unsigned m_bit_count;
+    unsigned m_position;
+    unsigned m_padding;
+    bool m_failure;
+};
+
+// Hex encoding stage, two digits per byte, lower case unless asked.
+class hex_encoder {
+public:
+    static constexpr std::size_t default_block_size = std::size_t{1} << 15;
+
+public:
+    explicit hex_encoder(bool uppercase = false) noexcept
+        : m_uppercase{uppercase}, m_pending{}, m_pending_first{0}, m_pending_last{0}
+    { }
+
+public:
+    [[nodiscard]]
+    std::size_t block_size() const noexcept {
+        return default_block_size;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return false;
+    }
+
+    bool encode_into(const char*& in, const char* in_last, char*& out, char* out_last) noexcept {
+        if (!_drain(out, out_last)) {
+            return true;
+        }
+
+        const std::size_t bytes = std::min(static_cast<std::size_t>(in_last - in), static_cast<std::size_t>(out_last - out) / 2);
+        detail::hex_encode_bytes(reinterpret_cast<const std::uint8_t*>(in), bytes, out, m_uppercase);
+        in += bytes;
+        out += bytes * 2;
+
+        if (in != in_last && out != out_last) {
+            detail::hex_encode_bytes(reinterpret_cast<const std::uint8_t*>(in), 1, m_pending.data(), m_uppercase);
+            m_pending_first = 0;
+            m_pending_last = 2;
+            ++in;
+            _drain(out, out_last);
+        }
+
+        return true;
+    }
+
+    bool finish_into(char*& out, char* out_last) noexcept {
+        return _drain(out, out_last);
+    }
+
+    template <typename Sink>
+    bool encode(const char* data, std::size_t size, encode_mode mode, Sink&& sink) {
+        if (m_buffer.empty()) {
+            m_buffer.resize(default_block_size * 2);
+        }
+
+        return detail::encode_staged(*this, m_buffer, data, size, mode, sink);
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool encode_to(const_byte_span bytes, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::encode_into_iterator(*this, bytes, dest);
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool finish_to(ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::transcode_into(dest, [&](char*& out, char* out_last) { return finish_into(out, out_last); });
+    }
+
+private:
+    bool _drain(char*& out, char* out_last) noexcept {
+        while (m_pending_first != m_pending_last && out != out_last) {
+            *out++ = m_pending[m_pending_first++];
+        }
+
+        return m_pending_first == m_pending_last;
+    }
+
+private:
+    bool m_uppercase;
+    std::array<char, 2> m_pending;
+    std::size_t m_pending_first;
+    std::size_t m_pending_last;
+    std::vector<char> m_buffer;
+};
+
+// Hex decoding stage; accepts both cases, fails on anything else and on an odd digit count.
+class hex_decoder {
+public:
+    static constexpr std::size_t default_buffer_size = std::size_t{1} << 16;
+
+private:
+    static constexpr std::uint8_t no_digit = 0xff;
+
+public:
+    hex_decoder() noexcept
+        : m_high{no_digit}, m_failure{false}
+    { }
+
+public:
+    [[nodiscard]] std::size_t input_size() const noexcept { return default_buffer_size; }
+    [[nodiscard]] std::size_t output_size() const noexcept { return default_buffer_size / 2; }
+    [[nodiscard]] bool failed() const noexcept { return m_failure; }
+    [[nodiscard]] bool idle() const noexcept { return !m_failure && m_high == no_digit; }
+
+    bool decode(const char*& in, const char* in_last, char*& out, char* out_last) noexcept {
+        while (in != in_last && !m_failure) {
+            if (m_high == no_digit) {
+                const std::size_t pairs = std::min(static_cast<std::size_t>(in_last - in) / 2,
+                                                   static_cast<std::size_t>(out_last - out));
+                const std::size_t done = detail::hex_decode_pairs(in, pairs, reinterpret_cast<std::uint8_t*>(out));
+                in += done * 2;
+                out += done;
+                if (in == in_last) {
+                    break;
+                }
+            }
+
+            const std::uint8_t digit = detail::hex_table[static_cast<unsigned char>(*in)];
+            if (digit == no_digit) {
+                m_failure = true;
+                break;
+            }
+
+            if (m_high == no_digit) {
+                m_high = digit;
+            } else if (out == out_last) {
+                break;
+            } else {
+                *out++ = static_cast<char>(m_high << 4 | digit);
+                m_high = no_digit;
+            }
+
+            ++in;
+        }
+
+        return !m_failure;
+    }
+
+    template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool decode_to(const_byte_span text, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        return detail::decode_into_iterator(*this, text, dest);
+    }
+
+    [[nodiscard]]
+    bool finish() const noexcept {
+        return idle();
+    }
+
+private:
+    std::uint8_t m_high;
+    bool m_failure;
+};
+
+using base64_encode_streambuf = compress_streambuf<base64_encoder>;
+using base64_decode_streambuf = decompress_streambuf<base64_decoder>;
+using hex_encode_streambuf = compress_streambuf<hex_encoder>;
+using hex_decode_streambuf = decompress_streambuf<hex_decoder>;
+
+namespace detail {
+    template <typename Iterator, typename Stage, std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool encode_blocks(Iterator first, Iterator last, Stage& stage, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        while (first != last) {
+            const const_byte_span window = first.buffered();
+            if (!stage.encode_to(window, dest)) {
+                return false;
+            }
+
+            first.consume(window.size());
+        }
+
+        return stage.finish_to(dest);
+    }
+
+    template <typename Iterator, typename Stage, std::size_t buf_size, typename Sink, typename FlushPolicy>
+    bool decode_blocks(Iterator first, Iterator last, Stage& stage, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+        while (first != last) {
+            const const_byte_span window = first.buffered();
+            if (!stage.decode_to(window, dest)) {
+                return false;
+            }
+
+            first.consume(window.size());
+        }
+
+        return stage.finish();
+    }
+
+    [[nodiscard]] inline
+    const_byte_span text_bytes(std::string_view text) noexcept {
+        return {reinterpret_cast<const std::byte*>(text.data()), text.size()};
+    }
+}
+
+// Encodes what is left of a stream block by block into dest's buffer; false when dest failed.
+template <typename Iterator, std::size_t buf_size, typename Sink, typename FlushPolicy,
+    typename = detail::enable_if_block_iterator_t<Iterator>>
+bool base64_encode(Iterator first, Iterator last, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest,
+                   base64_alphabet alphabet = base64_alphabet::standard, bool padding = true) {
+    base64_encoder encoder{alphabet, padding};
+    return detail::encode_blocks(std::move(first), std::move(last), encoder, dest);
+}
+
+template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+bool base64_encode(const_byte_span bytes, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest,
+                   base64_alphabet alphabet = base64_alphabet::standard, bool padding = true) {
+    base64_encoder encoder{alphabet, padding};
+    return encoder.encode_to(bytes, dest) && encoder.finish_to(dest);
+}
+
+// Decodes base64 text into dest; false on invalid or truncated text, or when dest failed.
+template <typename Iterator, std::size_t buf_size, typename Sink, typename FlushPolicy,
+    typename = detail::enable_if_block_iterator_t<Iterator>>
+bool base64_decode(Iterator first, Iterator last, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest,
+                   base64_alphabet alphabet = base64_alphabet::standard) {
+    base64_decoder decoder{alphabet};
+    return detail::decode_blocks(std::move(first), std::move(last), decoder, dest);
+}
+
+template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+bool base64_decode(std::string_view text, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest,
+                   base64_alphabet alphabet = base64_alphabet::standard) {
+    base64_decoder decoder{alphabet};
+    return decoder.decode_to(detail::text_bytes(text), dest) && decoder.finish();
+}
+
+template <typename Iterator, std::size_t buf_size, typename Sink, typename FlushPolicy,
+    typename = detail::enable_if_block_iterator_t<Iterator>>
+bool hex_encode(Iterator first, Iterator last, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest, bool uppercase = false) {
+    hex_encoder encoder{uppercase};
+    return detail::encode_blocks(std::move(first), std::move(last), encoder, dest);
+}
+
+template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+bool hex_encode(const_byte_span bytes, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest, bool uppercase = false) {
+    hex_encoder encoder{uppercase};
+    return encoder.encode_to(bytes, dest) && encoder.finish_to(dest);
+}
+
+template <typename Iterator, std::size_t buf_size, typename Sink, typename FlushPolicy,
+    typename = detail::enable_if_block_iterator_t<Iterator>>
+bool hex_decode(Iterator first, Iterator last, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+    hex_decoder decoder;
+    return detail::decode_blocks(std::move(first), std::move(last), decoder, dest);
+}
+
+template <std::size_t buf_size, typename Sink, typename FlushPolicy>
+bool hex_decode(std::string_view text, ostreambyte_iterator<buf_size, Sink, FlushPolicy>& dest) {
+    hex_decoder decoder;
+    return decoder.decode_to(detail::text_bytes(text), dest) && decoder.finish();
+}
+
+}
+
+#endif
@@ -0,0 +1,596 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_COMPRESS_HPP_
+#define MRT_STREAMBYTE_COMPRESS_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <ios>
+#include <memory>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+// Codecs are opt-in so the header does not pull libraries in behind the user's back:
+// define MRT_STREAMBYTE_ZSTD (link -lzstd) and / or MRT_STREAMBYTE_LZ4 (link -llz4).
+#if defined(MRT_STREAMBYTE_ZSTD)
+#include <zstd.h>
+#endif
+
+#if defined(MRT_STREAMBYTE_LZ4)
+#include <lz4frame.h>
+#endif
+
+namespace mrt {
+
+// How much of the compressed stream an encode call has to settle.
+enum class encode_mode {
+    // Compress what was given; the codec may keep some of it buffered.
+    more,
+    // Everything given so far must be decodable from what was written.
+    flush,
+    // Close the frame.
+    end
+};
+
+// Write-only streambuf compressing everything written to it into `target`.
+// Encoder is the codec:
+//     std::size_t block_size() const;          // preferred input size per call
+//     bool failed() const;
+//     template <typename Sink>                  // Sink: bool(const char*, std::size_t)
+//     bool encode(const char* data, std::size_t size, encode_mode mode, Sink&& sink);
+// Small writes are staged in a block_size put area; writes of a block or more are compressed
+// straight out of the caller's buffer, so peak memory stays at one block plus the codec's window.
+// The frame is closed by finish(), or by the destructor.
+template <typename Encoder>
+class compress_streambuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using encoder_type = Encoder;
+
+public:
+    explicit compress_streambuf(streambuf_type* target, Encoder encoder = Encoder{})
+        : m_target{target}, m_encoder{std::move(encoder)}, m_failure{target == nullptr}, m_finished{false}
+    {
+        m_buffer.resize(std::max(m_encoder.block_size(), std::size_t{1}));
+        _reset_put_area();
+    }
+
+    explicit compress_streambuf(std::basic_ios<char_type, traits_type>& stream, Encoder encoder = Encoder{})
+        : compress_streambuf(stream.rdbuf(), std::move(encoder))
+    { }
+
+    compress_streambuf(const compress_streambuf&) = delete;
+    compress_streambuf& operator=(const compress_streambuf&) = delete;
+
+    ~compress_streambuf() override {
+        finish();
+    }
+
+public:
+    // Compresses what is left, closes the frame and flushes the target. Further writes fail.
+    bool finish() {
+        if (m_finished) {
+            return !failed();
+        }
+
+        m_finished = true;
+        if (_encode_pending(encode_mode::end) && m_target->pubsync() == -1) {
+            m_failure = true;
+        }
+
+        setp(nullptr, nullptr);
+        return !failed();
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure || m_encoder.failed();
+    }
+
+    [[nodiscard]]
+    const Encoder& encoder() const noexcept {
+        return m_encoder;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (m_finished || !_encode_pending(encode_mode::more)) {
+            return traits_type::eof();
+        }
+
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+        if (m_finished || count <= 0) {
+            return 0;
+        }
+
+        const auto size = static_cast<std::size_t>(count);
+        const auto room = static_cast<std::size_t>(epptr() - pptr());
+        if (size < room) {
+            traits_type::copy(pptr(), s, size);
+            pbump(static_cast<int>(size));
+            return count;
+        }
+
+        if (!_encode_pending(encode_mode::more)) {
+            return 0;
+        }
+
+        if (size < m_buffer.size()) {
+            traits_type::copy(pptr(), s, size);
+            pbump(static_cast<int>(size));
+            return count;
+        }
+
+        return _encode(s, size, encode_mode::more) ? count : 0;
+    }
+
+    int sync() override {
+        if (m_finished) {
+            return failed() ? -1 : 0;
+        }
+
+        if (!_encode_pending(encode_mode::flush)) {
+            return -1;
+        }
+
+        return m_target->pubsync();
+    }
+
+private:
+    void _reset_put_area() noexcept {
+        char_type* data = m_buffer.data();
+        setp(data, data + m_buffer.size());
+    }
+
+    bool _encode_pending(encode_mode mode) {
+        const auto staged = static_cast<std::size_t>(pptr() - pbase());
+        const bool ok = _encode(pbase(), staged, mode);
+        _reset_put_area();
+
+        return ok;
+    }
+
+    bool _encode(const char_type* data, std::size_t size, encode_mode mode) {
+        if (failed()) {
+            return false;
+        }
+
+        auto sink = [this](const char_type* out, std::size_t out_size) {
+            return m_target->sputn(out, static_cast<std::streamsize>(out_size)) == static_cast<std::streamsize>(out_size);
+        };
+
+        if (!m_encoder.encode(data, size, mode, sink)) {
+            m_failure = true;
+        }
+
+        return !m_failure;
+    }
+
+private:
+    streambuf_type* m_target;
+    Encoder m_encoder;
+    std::vector<char_type> m_buffer;
+    bool m_failure;
+    bool m_finished;
+};
+
+// Read-only streambuf decompressing `source`. Decoder is the codec:
+//     std::size_t input_size() const;           // compressed bytes read from the source at once
+//     std::size_t output_size() const;          // size of the get area
+//     bool failed() const;
+//     bool idle() const;                        // between frames, nothing buffered
+//     bool decode(const char*& in, const char* in_last, char*& out, char* out_last);
+// Concatenated frames decode as one stream. Bulk reads (what the streambyte iterators issue per
+// block) are decoded straight into the caller's buffer; the get area only serves byte-wise reads.
+// A source ending in the middle of a frame reads as end of stream with failed() set.
+template <typename Decoder>
+class decompress_streambuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using decoder_type = Decoder;
+
+public:
+    explicit decompress_streambuf(streambuf_type* source, Decoder decoder = Decoder{})
+        : m_source{source}, m_decoder{std::move(decoder)}, m_in_first{nullptr}, m_in_last{nullptr},
+          m_source_done{source == nullptr}, m_failure{source == nullptr}
+    {
+        m_input.resize(std::max(m_decoder.input_size(), std::size_t{1}));
+        m_output.resize(std::max(m_decoder.output_size(), std::size_t{1}));
+    }
+
+    explicit decompress_streambuf(std::basic_ios<char_type, traits_type>& stream, Decoder decoder = Decoder{})
+        : decompress_streambuf(stream.rdbuf(), std::move(decoder))
+    { }
+
+    decompress_streambuf(const decompress_streambuf&) = delete;
+    decompress_streambuf& operator=(const decompress_streambuf&) = delete;
+
+public:
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure || m_decoder.failed();
+    }
+
+    [[nodiscard]]
+    const Decoder& decoder() const noexcept {
+        return m_decoder;
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() != egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        char_type* data = m_output.data();
+        const std::size_t got = _decode_into(data, m_output.size());
+        if (got == 0) {
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+
+        setg(data, data, data + got);
+        return traits_type::to_int_type(*data);
+    }
+
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+        std::streamsize done = std::min<std::streamsize>(egptr() - gptr(), std::max<std::streamsize>(count, 0));
+        if (done > 0) {
+            traits_type::copy(s, gptr(), static_cast<std::size_t>(done));
+            gbump(static_cast<int>(done));
+        }
+
+        while (done < count) {
+            const std::size_t got = _decode_into(s + done, static_cast<std::size_t>(count - done));
+            if (got == 0) {
+                break;
+            }
+
+            done += static_cast<std::streamsize>(got);
+        }
+
+        return done;
+    }
+
+private:
+    // Decodes at least one byte into [out, out + capacity) unless the stream is over.
+    std::size_t _decode_into(char_type* out, std::size_t capacity) {
+        char_type* cursor = out;
+        while (cursor == out && !failed()) {
+            if (m_in_first == m_in_last && !m_source_done) {
+                const std::streamsize got = m_source->sgetn(m_input.data(), static_cast<std::streamsize>(m_input.size()));
+                m_in_first = m_input.data();
+                m_in_last = m_in_first + std::max<std::streamsize>(got, 0);
+                m_source_done = got <= 0;
+            }
+
+            const char_type* in = m_in_first;
+            if (!m_decoder.decode(in, m_in_last, cursor, out + capacity)) {
+                m_failure = true;
+                break;
+            }
+            m_in_first = in;
+
+            if (cursor == out && m_source_done && m_in_first == m_in_last) {
+                // Nothing more will come; a frame cut short is an error rather than a clean end.
+                m_failure = m_failure || !m_decoder.idle();
+                break;
+            }
+        }
+
+        return static_cast<std::size_t>(cursor - out);
+    }
+
+private:
+    streambuf_type* m_source;
+    Decoder m_decoder;
+    std::vector<char_type> m_input;
+    std::vector<char_type> m_output;
+    const char_type* m_in_first;
+    const char_type* m_in_last;
+    bool m_source_done;
+    bool m_failure;
+};
+
+#if defined(MRT_STREAMBYTE_ZSTD)
+namespace detail {
+    struct zstd_cctx_deleter {
+        void operator()(ZSTD_CCtx* ctx) const noexcept { ZSTD_freeCCtx(ctx); }
+    };
+
+    struct zstd_dctx_deleter {
+        void operator()(ZSTD_DCtx* ctx) const noexcept { ZSTD_freeDCtx(ctx); }
+    };
+}
+
+// Zstandard frame encoder. workers > 0 compresses on that many background threads
+// when libzstd was built with multithreading; it quietly stays single threaded otherwise.
+class zstd_encoder {
+public:
+    static constexpr int default_level = 3;
+
+public:
+    explicit zstd_encoder(int level = default_level, unsigned workers = 0)
+        : m_ctx{ZSTD_createCCtx()}, m_output(ZSTD_CStreamOutSize()), m_failure{m_ctx == nullptr}
+    {
+        if (m_failure) {
+            return;
+        }
+
+        m_failure = ZSTD_isError(ZSTD_CCtx_setParameter(m_ctx.get(), ZSTD_c_compressionLevel, level)) != 0;
+        if (workers != 0) {
+            ZSTD_CCtx_setParameter(m_ctx.get(), ZSTD_c_nbWorkers, static_cast<int>(workers));
+        }
+    }
+
+public:
+    [[nodiscard]]
+    std::size_t block_size() const noexcept {
+        return ZSTD_CStreamInSize();
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    template <typename Sink>
+    bool encode(const char* data, std::size_t size, encode_mode mode, Sink&& sink) {
+        if (m_failure) {
+            return false;
+        }
+
+        const ZSTD_EndDirective directive = mode == encode_mode::end ? ZSTD_e_end
+                                          : mode == encode_mode::flush ? ZSTD_e_flush : ZSTD_e_continue;
+        ZSTD_inBuffer in{data, size, 0};
+        for (;;) {
+            ZSTD_outBuffer out{m_output.data(), m_output.size(), 0};
+            const std::size_t remaining = ZSTD_compressStream2(m_ctx.get(), &out, &in, directive);
+            if (ZSTD_isError(remaining) || (out.pos != 0 && !sink(m_output.data(), out.pos))) {
+                m_failure = true;
+                return false;
+            }
+
+            if (mode == encode_mode::more ? in.pos == in.size : remaining == 0) {
+                return true;
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<ZSTD_CCtx, detail::zstd_cctx_deleter> m_ctx;
+    std::vector<char> m_output;
+    bool m_failure;
+};
+
+class zstd_decoder {
+public:
+    zstd_decoder()
+        : m_ctx{ZSTD_createDCtx()}, m_failure{m_ctx == nullptr}, m_idle{true}
+    { }
+
+public:
+    [[nodiscard]] std::size_t input_size() const noexcept { return ZSTD_DStreamInSize(); }
+    [[nodiscard]] std::size_t output_size() const noexcept { return ZSTD_DStreamOutSize(); }
+    [[nodiscard]] bool failed() const noexcept { return m_failure; }
+    [[nodiscard]] bool idle() const noexcept { return m_idle; }
+
+    bool decode(const char*& in, const char* in_last, char*& out, char* out_last) {
+        if (m_failure) {
+            return false;
+        }
+
+        if (in == in_last && m_idle) {
+            return true;
+        }
+
+        ZSTD_inBuffer input{in, static_cast<std::size_t>(in_last - in), 0};
+        ZSTD_outBuffer output{out, static_cast<std::size_t>(out_last - out), 0};
+        const std::size_t hint = ZSTD_decompressStream(m_ctx.get(), &output, &input);
+        if (ZSTD_isError(hint)) {
+            m_failure = true;
+            return false;
+        }
+
+        in += input.pos;
+        out += output.pos;
+        // 0 means the frame is complete and fully flushed.
+        m_idle = hint == 0;
+
+        return true;
+    }
+
+private:
+    std::unique_ptr<ZSTD_DCtx, detail::zstd_dctx_deleter> m_ctx;
+    bool m_failure;
+    bool m_idle;
+};
+
+using zstd_compress_streambuf = compress_streambuf<zstd_encoder>;
+using zstd_decompress_streambuf = decompress_streambuf<zstd_decoder>;
+#endif
+
+#if defined(MRT_STREAMBYTE_LZ4)
+namespace detail {
+    struct lz4_cctx_deleter {
+        void operator()(LZ4F_cctx* ctx) const noexcept { LZ4F_freeCompressionContext(ctx); }
+    };
+
+    struct lz4_dctx_deleter {
+        void operator()(LZ4F_dctx* ctx) const noexcept { LZ4F_freeDecompressionContext(ctx); }
+    };
+}
+
+// LZ4 frame encoder. LZ4 has no threaded mode; it is the low latency option.
+class lz4_encoder {
+public:
+    static constexpr std::size_t default_block_size = std::size_t{1} << 16;
+
+public:
+    explicit lz4_encoder(int level = 0, bool content_checksum = false)
+        : m_preferences{}, m_started{false}, m_failure{false}
+    {
+        LZ4F_cctx* ctx = nullptr;
+        m_failure = LZ4F_isError(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION)) != 0;
+        m_ctx.reset(ctx);
+
+        m_preferences.compressionLevel = level;
+        m_preferences.frameInfo.blockSizeID = LZ4F_max64KB;
+        m_preferences.frameInfo.contentChecksumFlag = content_checksum ? LZ4F_contentChecksumEnabled : LZ4F_noContentChecksum;
+
+        // Large enough for a block, a flush, the frame header and the end mark.
+        m_output.resize(LZ4F_compressBound(default_block_size, &m_preferences) + LZ4F_HEADER_SIZE_MAX);
+    }
+
+public:
+    [[nodiscard]]
+    std::size_t block_size() const noexcept {
+        return default_block_size;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    template <typename Sink>
+    bool encode(const char* data, std::size_t size, encode_mode mode, Sink&& sink) {
+        auto emit = [&](std::size_t produced) {
+            m_failure = m_failure || LZ4F_isError(produced) || (produced != 0 && !sink(m_output.data(), produced));
+            return !m_failure;
+        };
+
+        if (m_failure) {
+            return false;
+        }
+
+        if (!m_started) {
+            if (!emit(LZ4F_compressBegin(m_ctx.get(), m_output.data(), m_output.size(), &m_preferences))) {
+                return false;
+            }
+            m_started = true;
+        }
+
+        while (size != 0) {
+            const std::size_t chunk = std::min(size, default_block_size);
+            if (!emit(LZ4F_compressUpdate(m_ctx.get(), m_output.data(), m_output.size(), data, chunk, nullptr))) {
+                return false;
+            }
+
+            data += chunk;
+            size -= chunk;
+        }
+
+        if (mode == encode_mode::flush) {
+            return emit(LZ4F_flush(m_ctx.get(), m_output.data(), m_output.size(), nullptr));
+        }
+
+        if (mode == encode_mode::end) {
+            m_started = false;
+            return emit(LZ4F_compressEnd(m_ctx.get(), m_output.data(), m_output.size(), nullptr));
+        }
+
+        return true;
+    }
+
+private:
+    std::unique_ptr<LZ4F_cctx, detail::lz4_cctx_deleter> m_ctx;
+    LZ4F_preferences_t m_preferences;
+    std::vector<char> m_output;
+    bool m_started;
+    bool m_failure;
+};
+
+class lz4_decoder {
+public:
+    static constexpr std::size_t default_buffer_size = std::size_t{1} << 16;
+
+public:
+    lz4_decoder()
+        : m_failure{false}, m_idle{true}
+    {
+        LZ4F_dctx* ctx = nullptr;
+        m_failure = LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION)) != 0;
+        m_ctx.reset(ctx);
+    }
+
+public:
+    [[nodiscard]] std::size_t input_size() const noexcept { return default_buffer_size; }
+    [[nodiscard]] std::size_t output_size() const noexcept { return default_buffer_size; }
+    [[nodiscard]] bool failed() const noexcept { return m_failure; }
+    [[nodiscard]] bool idle() const noexcept { return m_idle; }
+
+    bool decode(const char*& in, const char* in_last, char*& out, char* out_last) {
+        if (m_failure) {
+            return false;
+        }
+
+        if (in == in_last && m_idle) {
+            return true;
+        }
+
+        std::size_t in_size = static_cast<std::size_t>(in_last - in);
+        std::size_t out_size = static_cast<std::size_t>(out_last - out);
+        const std::size_t hint = LZ4F_decompress(m_ctx.get(), out, &out_size, in, &in_size, nullptr);
+        if (LZ4F_isError(hint)) {
+            m_failure = true;
+            return false;
+        }
+
+        in += in_size;
+        out += out_size;
+        // 0 means the frame is complete and fully flushed; the context then starts over.
+        m_idle = hint == 0;
+
+        return true;
+    }
+
+private:
+    std::unique_ptr<LZ4F_dctx, detail::lz4_dctx_deleter> m_ctx;
+    bool m_failure;
+    bool m_idle;
+};
+
+using lz4_compress_streambuf = compress_streambuf<lz4_encoder>;
+using lz4_decompress_streambuf = decompress_streambuf<lz4_decoder>;
+#endif
+
+}
+
+#endif
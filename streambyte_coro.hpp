@@ -0,0 +1,465 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_CORO_HPP_
+#define MRT_STREAMBYTE_CORO_HPP_
+
+#include "streambyte.hpp"
+
+// Needs C++20 coroutines and POSIX non-blocking descriptors; the bundled executor needs epoll (Linux).
+#if defined(__cpp_impl_coroutine) && defined(__has_include) && !defined(_WIN32)
+#if __has_include(<coroutine>)
+#define MRT_STREAMBYTE_CORO
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace mrt {
+
+template <typename T = void>
+class task;
+
+namespace detail {
+    template <typename T>
+    struct task_result {
+        std::optional<T> m_value;
+
+        template <typename U>
+        void return_value(U&& value) {
+            m_value.emplace(std::forward<U>(value));
+        }
+
+        T take() {
+            return std::move(*m_value);
+        }
+    };
+
+    template <>
+    struct task_result<void> {
+        void return_void() noexcept { }
+        void take() noexcept { }
+    };
+
+    template <typename T>
+    struct task_promise : task_result<T> {
+        std::coroutine_handle<> m_continuation;
+        std::exception_ptr m_error;
+
+        task<T> get_return_object() noexcept;
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        // Hands control straight back to whoever awaited the task.
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<task_promise> self) noexcept {
+                const std::coroutine_handle<> next = self.promise().m_continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept { }
+        };
+
+        final_awaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void unhandled_exception() noexcept {
+            m_error = std::current_exception();
+        }
+    };
+
+    // Fire and forget wrapper used by spawn(): runs eagerly and frees itself at the end.
+    struct detached_task {
+        struct promise_type {
+            detached_task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept { }
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+}
+
+// Lazily started coroutine; co_await it to run it and get its result.
+template <typename T>
+class task {
+public:
+    using promise_type = detail::task_promise<T>;
+
+public:
+    task(task&& rhs) noexcept
+        : m_handle{std::exchange(rhs.m_handle, nullptr)}
+    { }
+
+    task& operator=(task&& rhs) noexcept {
+        if (this != &rhs) {
+            _destroy();
+            m_handle = std::exchange(rhs.m_handle, nullptr);
+        }
+
+        return *this;
+    }
+
+    ~task() {
+        _destroy();
+    }
+
+public:
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> m_handle;
+
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                m_handle.promise().m_continuation = awaiting;
+                return m_handle;
+            }
+
+            T await_resume() {
+                if (m_handle.promise().m_error) {
+                    std::rethrow_exception(m_handle.promise().m_error);
+                }
+
+                return m_handle.promise().take();
+            }
+        };
+
+        return awaiter{m_handle};
+    }
+
+private:
+    friend promise_type;
+
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept
+        : m_handle{handle}
+    { }
+
+    void _destroy() noexcept {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = nullptr;
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename T>
+inline
+task<T> detail::task_promise<T>::get_return_object() noexcept {
+    return task<T>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+
+#ifdef __linux__
+// Minimal single threaded epoll loop. Any executor with the same readable(fd) / writable(fd)
+// awaitables and spawn(task<void>) (a thin Asio adaptor, for instance) works with the async
+// reader and writer below.
+class epoll_executor {
+private:
+    struct watch {
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+        bool registered = false;
+    };
+
+    struct readiness {
+        epoll_executor* m_executor;
+        int m_fd;
+        bool m_write;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) {
+            m_executor->_arm(m_fd, awaiting, m_write);
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+public:
+    epoll_executor()
+        : m_epoll{::epoll_create1(EPOLL_CLOEXEC)}, m_waiting{0}
+    { }
+
+    epoll_executor(const epoll_executor&) = delete;
+    epoll_executor& operator=(const epoll_executor&) = delete;
+
+    ~epoll_executor() {
+        if (m_epoll >= 0) {
+            ::close(m_epoll);
+        }
+    }
+
+public:
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_epoll < 0;
+    }
+
+    // co_await executor.readable(fd): resumes once fd can be read without blocking.
+    [[nodiscard]]
+    readiness readable(int fd) noexcept {
+        return {this, fd, false};
+    }
+
+    [[nodiscard]]
+    readiness writable(int fd) noexcept {
+        return {this, fd, true};
+    }
+
+    // Starts work right away; it runs up to its first suspension before spawn returns.
+    // An exception escaping work terminates.
+    void spawn(task<void> work) {
+        _run_detached(std::move(work));
+    }
+
+    // Runs until no coroutine waits on a descriptor any more.
+    void run() {
+        std::vector<epoll_event> events(64);
+        while (m_waiting != 0 && !failed()) {
+            const int ready = ::epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                break;
+            }
+
+            for (int i = 0; i < ready; ++i) {
+                _dispatch(events[i].data.fd, events[i].events);
+            }
+        }
+    }
+
+private:
+    static detail::detached_task _run_detached(task<void> work) {
+        co_await std::move(work);
+    }
+
+    void _arm(int fd, std::coroutine_handle<> awaiting, bool write) {
+        watch& w = m_watches[fd];
+        (write ? w.writer : w.reader) = awaiting;
+        ++m_waiting;
+        _update(fd, w);
+    }
+
+    void _update(int fd, watch& w) {
+        epoll_event event{};
+        event.data.fd = fd;
+        event.events = EPOLLONESHOT | (w.reader ? EPOLLIN | EPOLLRDHUP : 0u) | (w.writer ? EPOLLOUT : 0u);
+
+        if (::epoll_ctl(m_epoll, w.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) == 0) {
+            w.registered = true;
+            return;
+        }
+
+        // Not pollable (e.g. a regular file) or closed: let the waiters retry their call right away.
+        _dispatch(fd, EPOLLERR);
+    }
+
+    void _dispatch(int fd, std::uint32_t events) {
+        const auto found = m_watches.find(fd);
+        if (found == m_watches.end()) {
+            return;
+        }
+
+        watch& w = found->second;
+        const bool failure = (events & (EPOLLERR | EPOLLHUP)) != 0;
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+        if (w.reader && (failure || (events & (EPOLLIN | EPOLLRDHUP)) != 0)) {
+            reader = std::exchange(w.reader, nullptr);
+            --m_waiting;
+        }
+        if (w.writer && (failure || (events & EPOLLOUT) != 0)) {
+            writer = std::exchange(w.writer, nullptr);
+            --m_waiting;
+        }
+
+        // One shot: re-arm for whoever is still waiting, drop the watch otherwise.
+        if (w.reader || w.writer) {
+            _update(fd, w);
+        } else {
+            if (w.registered) {
+                ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            }
+            m_watches.erase(found);
+        }
+
+        // Resumed last: they may arm the same descriptor again.
+        if (reader) {
+            reader.resume();
+        }
+        if (writer) {
+            writer.resume();
+        }
+    }
+
+private:
+    int m_epoll;
+    std::size_t m_waiting;
+    std::unordered_map<int, watch> m_watches;
+};
+#endif
+
+namespace detail {
+    inline
+    bool set_nonblocking(int fd) noexcept {
+        const int flags = ::fcntl(fd, F_GETFL);
+        return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+}
+
+// Reads a non-blocking descriptor (socket, pipe) one chunk at a time:
+//     while (auto chunk = co_await reader.next_chunk(); !chunk.empty()) { ... }
+// Memory is one buffer of block_size per connection, like istreambyte_iterator's block:
+// a chunk stays valid until the next call.
+template <typename Executor>
+class async_byte_reader {
+public:
+    static constexpr std::size_t default_block_size = std::size_t{1} << 16;
+
+public:
+    async_byte_reader(Executor& executor, int fd, std::size_t block_size = default_block_size)
+        : m_executor{&executor}, m_fd{fd}, m_buffer(std::max(block_size, std::size_t{1})),
+          m_failure{!detail::set_nonblocking(fd)}
+    { }
+
+public:
+    // Empty at the end of the stream or on error (see failed()).
+    task<const_byte_span> next_chunk() {
+        for (;;) {
+            const ssize_t got = ::read(m_fd, m_buffer.data(), m_buffer.size());
+            if (got >= 0) {
+                co_return const_byte_span{m_buffer.data(), static_cast<std::size_t>(got)};
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await m_executor->readable(m_fd);
+            } else if (errno != EINTR) {
+                m_failure = true;
+                co_return const_byte_span{};
+            }
+        }
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+private:
+    Executor* m_executor;
+    int m_fd;
+    std::vector<std::byte> m_buffer;
+    bool m_failure;
+};
+
+// Buffered writer for a non-blocking descriptor. write() only suspends when the buffer is full
+// and the descriptor cannot take more; flush() suspends until everything was written.
+template <typename Executor>
+class async_socket_writer {
+public:
+    static constexpr std::size_t default_block_size = std::size_t{1} << 16;
+
+public:
+    async_socket_writer(Executor& executor, int fd, std::size_t block_size = default_block_size)
+        : m_executor{&executor}, m_fd{fd}, m_buffer(std::max(block_size, std::size_t{1})), m_pending{0},
+          m_failure{!detail::set_nonblocking(fd)}
+    { }
+
+public:
+    task<void> write(const_byte_span bytes) {
+        while (!bytes.empty() && !m_failure) {
+            const std::size_t take = std::min(bytes.size(), m_buffer.size() - m_pending);
+            std::memcpy(m_buffer.data() + m_pending, bytes.data(), take);
+            m_pending += take;
+            bytes = bytes.subspan(take);
+
+            if (m_pending == m_buffer.size()) {
+                co_await flush();
+            }
+        }
+    }
+
+    task<void> flush() {
+        std::size_t done = 0;
+        while (done < m_pending && !m_failure) {
+            const ssize_t put = ::write(m_fd, m_buffer.data() + done, m_pending - done);
+            if (put >= 0) {
+                done += static_cast<std::size_t>(put);
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await m_executor->writable(m_fd);
+            } else if (errno != EINTR) {
+                m_failure = true;
+            }
+        }
+
+        m_pending = 0;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+private:
+    Executor* m_executor;
+    int m_fd;
+    std::vector<std::byte> m_buffer;
+    std::size_t m_pending;
+    bool m_failure;
+};
+
+}
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,1429 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_FD_HPP_
+#define MRT_STREAMBYTE_FD_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
+#include <istream>
+#include <ostream>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace mrt {
+
+namespace detail {
+#ifdef _WIN32
+    using fd_handle = HANDLE;
+
+    [[nodiscard]] inline
+    fd_handle invalid_fd() noexcept {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // One read; returns the byte count, 0 at the end, -1 on error.
+    inline
+    long long fd_read(fd_handle handle, char* data, std::size_t size) noexcept {
+        DWORD got = 0;
+        const auto chunk = static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30));
+        return ReadFile(handle, data, chunk, &got, nullptr) ? static_cast<long long>(got) : -1;
+    }
+
+    inline
+    long long fd_write(fd_handle handle, const char* data, std::size_t size) noexcept {
+        DWORD put = 0;
+        const auto chunk = static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30));
+        return WriteFile(handle, data, chunk, &put, nullptr) ? static_cast<long long>(put) : -1;
+    }
+
+    // Same layout as a POSIX iovec, for the gather writer.
+    struct io_vec {
+        void* iov_base;
+        std::size_t iov_len;
+    };
+#else
+    using fd_handle = int;
+
+    [[nodiscard]] constexpr
+    fd_handle invalid_fd() noexcept {
+        return -1;
+    }
+
+    // One read; returns the byte count, 0 at the end, -1 on error.
+    inline
+    long long fd_read(fd_handle fd, char* data, std::size_t size) noexcept {
+        ssize_t got;
+        do {
+            got = ::read(fd, data, size);
+        } while (got < 0 && errno == EINTR);
+
+        return got;
+    }
+
+    inline
+    long long fd_write(fd_handle fd, const char* data, std::size_t size) noexcept {
+        ssize_t put;
+        do {
+            put = ::write(fd, data, size);
+        } while (put < 0 && errno == EINTR);
+
+        return put;
+    }
+
+    using io_vec = ::iovec;
+#endif
+
+    // The file system's preferred transfer size (st_blksize): 4 KiB on most local disks, often
+    // far more on network or striped file systems. 0 when unknown.
+    inline
+    std::size_t preferred_io_size(fd_handle handle) noexcept {
+#ifdef _WIN32
+        (void)handle;
+        return 0;
+#else
+        struct stat info{};
+        if (::fstat(handle, &info) != 0 || info.st_blksize <= 0) {
+            return 0;
+        }
+
+        const auto block = static_cast<std::size_t>(info.st_blksize);
+        return (block & (block - 1)) == 0 ? block : 0;
+#endif
+    }
+
+    // Direct I/O wants whole device blocks in memory, size and file offset. The page size covers
+    // common 512 byte / 4 KiB sectors; a larger st_blksize (RAID stripes) is honoured when sane.
+    inline
+    std::size_t io_alignment(fd_handle handle) noexcept {
+#ifdef _WIN32
+        (void)handle;
+        SYSTEM_INFO system{};
+        GetSystemInfo(&system);
+        return system.dwPageSize != 0 ? system.dwPageSize : 4096;
+#else
+        const long page = ::sysconf(_SC_PAGESIZE);
+        const std::size_t alignment = page > 0 ? static_cast<std::size_t>(page) : 4096;
+        const std::size_t block = preferred_io_size(handle);
+
+        return block <= (std::size_t{1} << 20) ? std::max(alignment, block) : alignment;
+#endif
+    }
+
+    // Heap block with a chosen alignment; std::vector cannot over-align its storage.
+    class aligned_buffer {
+    public:
+        aligned_buffer() noexcept
+            : m_data{nullptr}, m_size{0}, m_alignment{alignof(std::max_align_t)}
+        { }
+
+        aligned_buffer(const aligned_buffer&) = delete;
+        aligned_buffer& operator=(const aligned_buffer&) = delete;
+
+        ~aligned_buffer() {
+            _release();
+        }
+
+    public:
+        void assign(std::size_t size, std::size_t alignment) {
+            if (size == m_size && alignment == m_alignment) {
+                return;
+            }
+
+            _release();
+            m_data = static_cast<char*>(::operator new(size, std::align_val_t{alignment}));
+            m_size = size;
+            m_alignment = alignment;
+        }
+
+        [[nodiscard]] char* data() const noexcept { return m_data; }
+        [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+        [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+        [[nodiscard]] std::size_t alignment() const noexcept { return m_alignment; }
+
+    private:
+        void _release() noexcept {
+            if (m_data != nullptr) {
+                ::operator delete(m_data, std::align_val_t{m_alignment});
+            }
+
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+    private:
+        char* m_data;
+        std::size_t m_size;
+        std::size_t m_alignment;
+    };
+}
+
+// Descriptor as an istreambyte_iterator source: read(2) per block, no streambuf in between.
+// The descriptor stays owned by the caller.
+class fd_source {
+public:
+    using native_handle_type = detail::fd_handle;
+
+public:
+    fd_source() noexcept
+        : m_handle{detail::invalid_fd()}
+    { }
+
+    explicit
+    fd_source(native_handle_type handle) noexcept
+        : m_handle{handle}
+    { }
+
+public:
+    // Loops over short reads (pipes, sockets) so only the end of the data yields fewer bytes.
+    std::size_t read(char* dest, std::size_t count) noexcept {
+        std::size_t done = 0;
+        while (done < count) {
+            const long long got = detail::fd_read(m_handle, dest + done, count - done);
+            if (got <= 0) {
+                break;
+            }
+
+            done += static_cast<std::size_t>(got);
+        }
+
+        return done;
+    }
+
+    [[nodiscard]] explicit
+    operator bool() const noexcept {
+        return m_handle != detail::invalid_fd();
+    }
+
+    [[nodiscard]]
+    native_handle_type native_handle() const noexcept {
+        return m_handle;
+    }
+
+private:
+    native_handle_type m_handle;
+};
+
+// Descriptor as an ostreambyte_iterator sink: write(2) per block.
+class fd_sink {
+public:
+    using native_handle_type = detail::fd_handle;
+
+public:
+    fd_sink() noexcept
+        : m_handle{detail::invalid_fd()}
+    { }
+
+    explicit
+    fd_sink(native_handle_type handle) noexcept
+        : m_handle{handle}
+    { }
+
+public:
+    std::size_t write(const char* data, std::size_t count) noexcept {
+        std::size_t done = 0;
+        while (done < count) {
+            const long long put = detail::fd_write(m_handle, data + done, count - done);
+            if (put <= 0) {
+                break;
+            }
+
+            done += static_cast<std::size_t>(put);
+        }
+
+        return done;
+    }
+
+    [[nodiscard]] explicit
+    operator bool() const noexcept {
+        return m_handle != detail::invalid_fd();
+    }
+
+    [[nodiscard]]
+    native_handle_type native_handle() const noexcept {
+        return m_handle;
+    }
+
+private:
+    native_handle_type m_handle;
+};
+
+// Whether fd_bytebuf goes through the page cache. direct uses O_DIRECT (F_NOCACHE on macOS,
+// FILE_FLAG_NO_BUFFERING on Windows) so bulk jobs do not evict everyone else's hot pages.
+// Where the system or file system has no such mode the file is opened cached instead.
+enum class fd_caching {
+    cached,
+    direct
+};
+
+// Byte streambuf over a raw file descriptor (a HANDLE on Windows).
+// There is no locale, codecvt or sentry on the way: underflow / overflow are one read / write
+// of a caller-sized buffer, and bulk sgetn / sputn of a buffer or more (every streambyte
+// iterator block) go straight to the system call without staging.
+// Like std::filebuf, one buffer serves reads or writes, whichever was used last.
+//
+// With fd_caching::direct the buffer is aligned and rounded up to the device block size, bulk
+// transfers only bypass it for aligned memory, and a write tail that does not fill a block is
+// written through the cache. read_at / write_at keep the system's O_DIRECT alignment rules.
+class fd_bytebuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using pos_type = traits_type::pos_type;
+    using off_type = traits_type::off_type;
+    using size_type = std::size_t;
+    using native_handle_type = detail::fd_handle;
+
+    static constexpr size_type default_buffer_size = std::size_t{1} << 16;
+
+    // Pass as buffer_size to start from the file system's preferred transfer size and adapt at
+    // runtime: the buffer doubles over sustained sequential reads and halves over small flushes.
+    static constexpr size_type adaptive_buffer_size = 0;
+    static constexpr size_type min_adaptive_buffer_size = std::size_t{1} << 14;
+    static constexpr size_type max_adaptive_buffer_size = std::size_t{1} << 22;
+
+public:
+    fd_bytebuf() noexcept
+        : m_handle{detail::invalid_fd()}, m_owns{false}, m_failure{false}, m_caching{fd_caching::cached},
+          m_aligned{true}, m_adaptive{false}, m_full_reads{0}, m_small_flushes{0}, m_buffer_size{default_buffer_size}
+    { }
+
+    // Opens path. The modes follow std::filebuf: out alone truncates, app appends, in | out keeps the content.
+    explicit fd_bytebuf(const char* path, std::ios_base::openmode mode = std::ios_base::in, size_type buffer_size = default_buffer_size,
+                        fd_caching caching = fd_caching::cached)
+        : fd_bytebuf()
+    {
+        _request_buffer_size(buffer_size);
+        open(path, mode, caching);
+    }
+
+    explicit fd_bytebuf(const std::string& path, std::ios_base::openmode mode = std::ios_base::in, size_type buffer_size = default_buffer_size,
+                        fd_caching caching = fd_caching::cached)
+        : fd_bytebuf(path.c_str(), mode, buffer_size, caching)
+    { }
+
+    // Uses an already open descriptor. It is closed with the buffer only when owns is true.
+    // A file opened with O_DIRECT is handled as fd_caching::direct.
+    explicit fd_bytebuf(native_handle_type handle, bool owns, size_type buffer_size = default_buffer_size)
+        : fd_bytebuf()
+    {
+        m_handle = handle;
+        m_owns = owns;
+        m_failure = handle == detail::invalid_fd();
+        _request_buffer_size(buffer_size);
+        if (!m_failure) {
+            m_caching = _opened_caching();
+            if (m_caching == fd_caching::direct) {
+                _moved_to(_seek(0, SEEK_CUR));
+            }
+            _allocate();
+        }
+    }
+
+    fd_bytebuf(const fd_bytebuf&) = delete;
+    fd_bytebuf& operator=(const fd_bytebuf&) = delete;
+
+    ~fd_bytebuf() override {
+        close();
+    }
+
+public:
+    bool open(const char* path, std::ios_base::openmode mode, fd_caching caching = fd_caching::cached) {
+        close();
+
+        m_caching = caching;
+        m_handle = _open(path, mode);
+        m_owns = true;
+        m_failure = m_handle == detail::invalid_fd();
+        m_aligned = true;
+        if (!m_failure) {
+            // Appending starts wherever the file ends, aligned or not.
+            if (m_caching == fd_caching::direct && (mode & std::ios_base::app) != 0) {
+                _moved_to(_seek(0, SEEK_END));
+            }
+            _allocate();
+        }
+
+        return !m_failure;
+    }
+
+    // Flushes pending output and releases the descriptor if owned.
+    bool close() {
+        if (!is_open()) {
+            return !m_failure;
+        }
+
+        const bool flushed = _flush_put_area();
+        if (m_owns) {
+#ifdef _WIN32
+            CloseHandle(m_handle);
+#else
+            ::close(m_handle);
+#endif
+        }
+#ifdef _WIN32
+        if (m_cached_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_cached_handle);
+            m_cached_handle = INVALID_HANDLE_VALUE;
+        }
+#endif
+
+        m_handle = detail::invalid_fd();
+        m_owns = false;
+        setg(nullptr, nullptr, nullptr);
+        setp(nullptr, nullptr);
+
+        m_failure = m_failure || !flushed;
+        return !m_failure;
+    }
+
+    [[nodiscard]]
+    bool is_open() const noexcept {
+        return m_handle != detail::invalid_fd();
+    }
+
+    // True once opening, reading or writing failed. End of file is not a failure.
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // Current buffer size; it changes over time with adaptive_buffer_size.
+    [[nodiscard]]
+    size_type buffer_size() const noexcept {
+        return m_buffer.size();
+    }
+
+    // The mode actually in use: direct may have fallen back to cached.
+    [[nodiscard]]
+    fd_caching caching() const noexcept {
+        return m_caching;
+    }
+
+    [[nodiscard]]
+    native_handle_type native_handle() const noexcept {
+        return m_handle;
+    }
+
+    // pread: reads at offset without moving the stream position nor touching the buffer.
+    size_type read_at(std::uint64_t offset, byte_span out) {
+        size_type done = 0;
+        while (done < out.size()) {
+            const long long got = _pread(reinterpret_cast<char_type*>(out.data()) + done, out.size() - done, offset + done);
+            if (got <= 0) {
+                m_failure = m_failure || got < 0;
+                break;
+            }
+
+            done += static_cast<size_type>(got);
+        }
+
+        return done;
+    }
+
+    // pwrite counterpart of read_at.
+    size_type write_at(std::uint64_t offset, const_byte_span bytes) {
+        size_type done = 0;
+        while (done < bytes.size()) {
+            const long long put = _pwrite(reinterpret_cast<const char_type*>(bytes.data()) + done, bytes.size() - done, offset + done);
+            if (put <= 0) {
+                m_failure = true;
+                break;
+            }
+
+            done += static_cast<size_type>(put);
+        }
+
+        return done;
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() != egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        if (!_flush_put_area()) {
+            return traits_type::eof();
+        }
+
+        // Direct reads restart from the block holding the position and skip its head.
+        size_type skip = 0;
+        if (!m_aligned && !_realign(skip)) {
+            return traits_type::eof();
+        }
+
+        // Every recent refill was full: the reader streams, fewer and larger reads pay off.
+        if (m_adaptive && m_full_reads >= adapt_after) {
+            _resize(m_buffer.size() * 2);
+        }
+
+        char_type* data = m_buffer.data();
+        const long long got = _read(data, m_buffer.size());
+        if (got > 0) {
+            _advanced(static_cast<size_type>(got));
+        }
+        m_full_reads = static_cast<size_type>(std::max(got, 0LL)) == m_buffer.size() ? m_full_reads + 1 : 0;
+
+        if (got <= static_cast<long long>(skip)) {
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+
+        setg(data, data + skip, data + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+        std::streamsize done = std::min<std::streamsize>(egptr() - gptr(), std::max<std::streamsize>(count, 0));
+        if (done > 0) {
+            traits_type::copy(s, gptr(), static_cast<size_type>(done));
+            gbump(static_cast<int>(done));
+        }
+
+        if (done == count || !_flush_put_area()) {
+            return done;
+        }
+
+        // A buffer or more is read in place; a small remainder refills the buffer.
+        size_type bulk = _bulk_size(s + done, static_cast<size_type>(count - done));
+        while (bulk != 0) {
+            const long long got = _read(s + done, bulk);
+            if (got <= 0) {
+                return done;
+            }
+
+            _advanced(static_cast<size_type>(got));
+            done += static_cast<std::streamsize>(got);
+            bulk -= static_cast<size_type>(got);
+            if (!m_aligned) {
+                break;
+            }
+        }
+
+        while (done < count && !traits_type::eq_int_type(underflow(), traits_type::eof())) {
+            const std::streamsize take = std::min<std::streamsize>(egptr() - gptr(), count - done);
+            traits_type::copy(s + done, gptr(), static_cast<size_type>(take));
+            gbump(static_cast<int>(take));
+            done += take;
+        }
+
+        return done;
+    }
+
+    int_type overflow(int_type c) override {
+        if (!_start_writing() || !_flush_put_area()) {
+            return traits_type::eof();
+        }
+        m_small_flushes = 0;
+
+        char_type* data = m_buffer.data();
+        setp(data, data + m_buffer.size());
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+        if (count <= 0 || !_start_writing()) {
+            return 0;
+        }
+
+        const auto size = static_cast<size_type>(count);
+        if (pbase() != nullptr && size <= static_cast<size_type>(epptr() - pptr())) {
+            traits_type::copy(pptr(), s, size);
+            pbump(static_cast<int>(size));
+            return count;
+        }
+
+        if (!_flush_put_area()) {
+            return 0;
+        }
+
+        size_type done = _bulk_size(s, size);
+        if (done != 0) {
+            if (!_write_all(s, done)) {
+                return 0;
+            }
+            _advanced(done);
+        }
+
+        // Whatever could not bypass the buffer goes through it, a full buffer at a time.
+        while (done < size) {
+            if (pbase() == nullptr) {
+                char_type* data = m_buffer.data();
+                setp(data, data + m_buffer.size());
+            }
+
+            const size_type take = std::min(size - done, static_cast<size_type>(epptr() - pptr()));
+            traits_type::copy(pptr(), s + done, take);
+            pbump(static_cast<int>(take));
+            done += take;
+
+            if (done < size && !_flush_put_area()) {
+                return static_cast<std::streamsize>(done);
+            }
+        }
+
+        return count;
+    }
+
+    int sync() override {
+        const auto pending = static_cast<size_type>(pptr() - pbase());
+        if (!_flush_put_area()) {
+            return -1;
+        }
+
+        // Give back what was read ahead so the descriptor position matches the stream position.
+        const auto unread = static_cast<long long>(egptr() - gptr());
+        setg(nullptr, nullptr, nullptr);
+        if (unread != 0) {
+            const long long position = _seek(-unread, SEEK_CUR);
+            if (position < 0) {
+                return -1;
+            }
+            _moved_to(position);
+            m_full_reads = 0;
+        }
+
+        // Bursts of small writes flushed one by one never use most of a large buffer.
+        if (m_adaptive && pending != 0) {
+            m_small_flushes = pending * 4 < m_buffer.size() ? m_small_flushes + 1 : 0;
+            if (m_small_flushes >= adapt_after) {
+                _resize(m_buffer.size() / 2);
+            }
+        }
+
+        return 0;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+        if (sync() != 0) {
+            return pos_type(off_type(-1));
+        }
+
+        const int whence = dir == std::ios_base::beg ? SEEK_SET : dir == std::ios_base::cur ? SEEK_CUR : SEEK_END;
+        const long long position = _seek(static_cast<long long>(off), whence);
+        _moved_to(position);
+        m_full_reads = 0;
+
+        return pos_type(off_type(position));
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    // Leaving read mode: the read-ahead is given back to the descriptor first.
+    bool _start_writing() {
+        if (!is_open()) {
+            return false;
+        }
+
+        if (eback() != nullptr) {
+            if (sync() != 0) {
+                m_failure = true;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool _flush_put_area() {
+        if (pbase() == nullptr) {
+            return true;
+        }
+
+        const auto pending = static_cast<size_type>(pptr() - pbase());
+        const bool written = pending == 0 || (m_caching == fd_caching::direct ? _write_direct(pbase(), pending) : _write_all(pbase(), pending));
+        setp(nullptr, nullptr);
+
+        return written;
+    }
+
+    // The part of a bulk transfer that may skip the buffer: all of it when cached, whole
+    // blocks from aligned memory at an aligned position when direct.
+    size_type _bulk_size(const char_type* data, size_type size) const noexcept {
+        if (size < m_buffer.size()) {
+            return 0;
+        }
+
+        if (m_caching == fd_caching::cached) {
+            return size;
+        }
+
+        const size_type alignment = m_buffer.alignment();
+        if (!m_aligned || reinterpret_cast<std::uintptr_t>(data) % alignment != 0) {
+            return 0;
+        }
+
+        return size - size % alignment;
+    }
+
+    // Writes the put area of a direct buffer: up to the next block boundary and the tail
+    // through the cache, whole blocks in between from the (aligned) buffer start.
+    bool _write_direct(char_type* data, size_type size) {
+        const size_type alignment = m_buffer.alignment();
+        if (!m_aligned) {
+            const long long position = _seek(0, SEEK_CUR);
+            if (position < 0) {
+                m_failure = true;
+                return false;
+            }
+
+            const auto misalignment = static_cast<size_type>(position) % alignment;
+            const size_type gap = std::min(size, misalignment == 0 ? 0 : alignment - misalignment);
+            if (gap != 0 && !_write_cached(data, gap)) {
+                return false;
+            }
+
+            _moved_to(position + static_cast<long long>(gap));
+            size -= gap;
+            std::memmove(data, data + gap, size);
+        }
+
+        const size_type blocks = m_aligned ? size - size % alignment : 0;
+        if (blocks != 0 && !_write_all(data, blocks)) {
+            return false;
+        }
+
+        if (blocks != size) {
+            if (!_write_cached(data + blocks, size - blocks)) {
+                return false;
+            }
+            m_aligned = false;
+        }
+
+        return true;
+    }
+
+    // Direct only: moves the descriptor back to the start of its block. skip is how far into
+    // the block the stream position is.
+    bool _realign(size_type& skip) {
+        const long long position = _seek(0, SEEK_CUR);
+        if (position < 0) {
+            m_failure = true;
+            return false;
+        }
+
+        skip = static_cast<size_type>(position) % m_buffer.alignment();
+        if (skip != 0 && _seek(-static_cast<long long>(skip), SEEK_CUR) < 0) {
+            m_failure = true;
+            return false;
+        }
+
+        m_aligned = true;
+        return true;
+    }
+
+    void _moved_to(long long position) noexcept {
+        m_aligned = m_caching == fd_caching::cached || (position >= 0 && static_cast<size_type>(position) % m_buffer.alignment() == 0);
+    }
+
+    void _advanced(size_type count) noexcept {
+        m_aligned = m_aligned && (m_caching == fd_caching::cached || count % m_buffer.alignment() == 0);
+    }
+
+    // Consecutive full reads (or small flushes) before an adaptive buffer changes size.
+    static constexpr size_type adapt_after = 4;
+
+    void _request_buffer_size(size_type size) noexcept {
+        m_adaptive = size == adaptive_buffer_size;
+        m_buffer_size = std::max(size, size_type{1});
+    }
+
+    // The buffer is rounded up to whole blocks for direct I/O.
+    void _allocate() {
+        const size_type alignment = m_caching == fd_caching::direct ? detail::io_alignment(m_handle) : size_type{MRT_HARDWARE_CI_SIZE};
+        if (m_adaptive) {
+            m_buffer_size = std::clamp(detail::preferred_io_size(m_handle), min_adaptive_buffer_size, max_adaptive_buffer_size);
+        }
+
+        _assign_buffer(alignment);
+    }
+
+    // Only called with both areas drained.
+    void _resize(size_type size) {
+        const size_type alignment = m_buffer.alignment();
+        m_buffer_size = std::clamp(size, std::max(min_adaptive_buffer_size, alignment), max_adaptive_buffer_size);
+        _assign_buffer(alignment);
+    }
+
+    void _assign_buffer(size_type alignment) {
+        m_buffer.assign((m_buffer_size + alignment - 1) / alignment * alignment, alignment);
+        m_full_reads = 0;
+        m_small_flushes = 0;
+    }
+
+    long long _read(char_type* data, size_type size) noexcept {
+        const long long got = detail::fd_read(m_handle, data, size);
+        m_failure = m_failure || got < 0;
+
+        return got;
+    }
+
+    long long _write(const char_type* data, size_type size) noexcept {
+        return detail::fd_write(m_handle, data, size);
+    }
+
+    bool _write_all(const char_type* data, size_type size) {
+        while (size != 0) {
+            const long long put = _write(data, size);
+            if (put <= 0) {
+                m_failure = true;
+                return false;
+            }
+
+            data += put;
+            size -= static_cast<size_type>(put);
+        }
+
+        return true;
+    }
+
+#ifdef _WIN32
+    native_handle_type _open(const char* path, std::ios_base::openmode mode) noexcept {
+        const bool in = (mode & std::ios_base::in) != 0;
+        const bool out = (mode & (std::ios_base::out | std::ios_base::app)) != 0;
+        const bool truncate = (mode & std::ios_base::trunc) != 0 || (out && !in && (mode & std::ios_base::app) == 0);
+        const bool direct = m_caching == fd_caching::direct;
+
+        // A cached handle for unaligned tails is reopened next to a direct one, hence the wider sharing.
+        const DWORD access = (in ? GENERIC_READ : 0) | (out ? ((mode & std::ios_base::app) != 0 ? FILE_APPEND_DATA : GENERIC_WRITE) : 0);
+        const DWORD share = FILE_SHARE_READ | (direct ? FILE_SHARE_WRITE : 0);
+        const DWORD disposition = !out ? OPEN_EXISTING : truncate ? CREATE_ALWAYS : OPEN_ALWAYS;
+        const DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct ? FILE_FLAG_NO_BUFFERING : 0);
+        return CreateFileA(path, access, share, nullptr, disposition, flags, nullptr);
+    }
+
+    fd_caching _opened_caching() const noexcept {
+        return fd_caching::cached;
+    }
+
+    // Unaligned writes cannot go through a FILE_FLAG_NO_BUFFERING handle: a second, cached
+    // handle on the same file writes them at the current position.
+    bool _write_cached(const char_type* data, size_type size) {
+        if (m_cached_handle == INVALID_HANDLE_VALUE) {
+            m_cached_handle = ReOpenFile(m_handle, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0);
+        }
+
+        const long long position = _seek(0, SEEK_CUR);
+        if (m_cached_handle == INVALID_HANDLE_VALUE || position < 0) {
+            m_failure = true;
+            return false;
+        }
+
+        for (size_type done = 0; done < size;) {
+            OVERLAPPED at{};
+            at.Offset = static_cast<DWORD>(position + done);
+            at.OffsetHigh = static_cast<DWORD>(static_cast<std::uint64_t>(position + done) >> 32);
+            DWORD put = 0;
+            const auto chunk = static_cast<DWORD>(std::min<size_type>(size - done, 1u << 30));
+            if (!WriteFile(m_cached_handle, data + done, chunk, &put, &at) || put == 0) {
+                m_failure = true;
+                return false;
+            }
+
+            done += put;
+        }
+
+        return _seek(position + static_cast<long long>(size), SEEK_SET) >= 0;
+    }
+
+    long long _pread(char_type* data, size_type size, std::uint64_t offset) noexcept {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD got = 0;
+        const auto chunk = static_cast<DWORD>(std::min<size_type>(size, 1u << 30));
+        if (!ReadFile(m_handle, data, chunk, &got, &at)) {
+            return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+        }
+
+        return got;
+    }
+
+    long long _pwrite(const char_type* data, size_type size, std::uint64_t offset) noexcept {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD put = 0;
+        const auto chunk = static_cast<DWORD>(std::min<size_type>(size, 1u << 30));
+        return WriteFile(m_handle, data, chunk, &put, &at) ? static_cast<long long>(put) : -1;
+    }
+
+    long long _seek(long long offset, int whence) noexcept {
+        LARGE_INTEGER distance{};
+        distance.QuadPart = offset;
+        LARGE_INTEGER position{};
+        const DWORD method = whence == SEEK_SET ? FILE_BEGIN : whence == SEEK_CUR ? FILE_CURRENT : FILE_END;
+        return SetFilePointerEx(m_handle, distance, &position, method) ? position.QuadPart : -1;
+    }
+#else
+    native_handle_type _open(const char* path, std::ios_base::openmode mode) noexcept {
+        const bool in = (mode & std::ios_base::in) != 0;
+        const bool append = (mode & std::ios_base::app) != 0;
+        const bool out = (mode & std::ios_base::out) != 0 || append;
+
+        int flags = O_CLOEXEC | (in && out ? O_RDWR : out ? O_WRONLY : O_RDONLY);
+        if (out) {
+            flags |= O_CREAT;
+        }
+        if (append) {
+            flags |= O_APPEND;
+        }
+        if ((mode & std::ios_base::trunc) != 0 || (out && !in && !append)) {
+            flags |= O_TRUNC;
+        }
+
+        int fd = _open_flags(path, m_caching == fd_caching::direct ? flags | _direct_flag() : flags);
+        // tmpfs and friends refuse O_DIRECT with EINVAL: stay cached there.
+        if (fd < 0 && errno == EINVAL && m_caching == fd_caching::direct) {
+            m_caching = fd_caching::cached;
+            fd = _open_flags(path, flags);
+        }
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        if (fd >= 0 && m_caching == fd_caching::direct) {
+            ::fcntl(fd, F_NOCACHE, 1);
+        }
+#endif
+
+        return fd;
+    }
+
+    static int _open_flags(const char* path, int flags) noexcept {
+        int fd;
+        do {
+            fd = ::open(path, flags, 0666);
+        } while (fd < 0 && errno == EINTR);
+
+        return fd;
+    }
+
+    static constexpr int _direct_flag() noexcept {
+#if defined(O_DIRECT)
+        return O_DIRECT;
+#else
+        return 0;
+#endif
+    }
+
+    // Only regular files: O_DIRECT on a pipe means packet mode.
+    fd_caching _opened_caching() const noexcept {
+#if defined(O_DIRECT)
+        struct stat info{};
+        const int flags = ::fcntl(m_handle, F_GETFL);
+        if (flags >= 0 && (flags & O_DIRECT) != 0 && ::fstat(m_handle, &info) == 0 && S_ISREG(info.st_mode)) {
+            return fd_caching::direct;
+        }
+#endif
+        return fd_caching::cached;
+    }
+
+    void _set_direct(bool direct) noexcept {
+#if defined(O_DIRECT)
+        const int flags = ::fcntl(m_handle, F_GETFL);
+        if (flags >= 0) {
+            ::fcntl(m_handle, F_SETFL, direct ? flags | O_DIRECT : flags & ~O_DIRECT);
+        }
+#else
+        // F_NOCACHE has no alignment rules: nothing to switch.
+        (void)direct;
+#endif
+    }
+
+    // Unaligned pieces go through the page cache: O_DIRECT is cleared for the write only.
+    bool _write_cached(const char_type* data, size_type size) {
+        _set_direct(false);
+        const bool written = _write_all(data, size);
+        _set_direct(true);
+
+        return written;
+    }
+
+    long long _pread(char_type* data, size_type size, std::uint64_t offset) noexcept {
+        ssize_t got;
+        do {
+            got = ::pread(m_handle, data, size, static_cast<off_t>(offset));
+        } while (got < 0 && errno == EINTR);
+
+        return got;
+    }
+
+    long long _pwrite(const char_type* data, size_type size, std::uint64_t offset) noexcept {
+        ssize_t put;
+        do {
+            put = ::pwrite(m_handle, data, size, static_cast<off_t>(offset));
+        } while (put < 0 && errno == EINTR);
+
+        return put;
+    }
+
+    long long _seek(long long offset, int whence) noexcept {
+        return static_cast<long long>(::lseek(m_handle, static_cast<off_t>(offset), whence));
+    }
+#endif
+
+private:
+    native_handle_type m_handle;
+    bool m_owns;
+    bool m_failure;
+    fd_caching m_caching;
+    // Whether the descriptor offset sits on a block boundary; always true when cached.
+    bool m_aligned;
+    bool m_adaptive;
+    size_type m_full_reads;
+    size_type m_small_flushes;
+    size_type m_buffer_size;
+    detail::aligned_buffer m_buffer;
+#ifdef _WIN32
+    native_handle_type m_cached_handle = INVALID_HANDLE_VALUE;
+#endif
+};
+
+
+// Gather writer for framed output: write({header, payload, trailer}) copies small pieces into a
+// buffer and hands large ones to writev(2) by reference, so big payloads are never copied.
+// A write() holding a referenced piece ends with one writev of everything pending, so its spans
+// only need to live for the call; writes of small pieces only are batched until the buffer fills
+// or flush(). On Windows pieces are written one WriteFile at a time (WriteFileGather needs
+// unbuffered, page aligned I/O), which still saves the copy.
+class gather_writer {
+public:
+    using native_handle_type = detail::fd_handle;
+    using size_type = std::size_t;
+
+    static constexpr size_type default_buffer_size = 64 * 1024;
+    static constexpr size_type default_copy_threshold = 1024;
+
+public:
+    explicit gather_writer(native_handle_type handle, size_type buffer_size = default_buffer_size,
+                           size_type copy_threshold = default_copy_threshold)
+        : m_handle{handle}, m_buffer(std::max<size_type>(buffer_size, 1)), m_used{0},
+          m_copy_threshold{std::min(copy_threshold, m_buffer.size())}, m_calls{0},
+          m_failure{handle == detail::invalid_fd()}
+    {
+        m_pieces.reserve(max_pieces);
+    }
+
+    // Writes after what the streambuf holds: it is synced first.
+    explicit gather_writer(fd_bytebuf& file, size_type buffer_size = default_buffer_size,
+                           size_type copy_threshold = default_copy_threshold)
+        : gather_writer(file.native_handle(), buffer_size, copy_threshold)
+    {
+        m_failure = m_failure || file.pubsync() != 0;
+    }
+
+    gather_writer(const gather_writer&) = delete;
+    gather_writer& operator=(const gather_writer&) = delete;
+
+    ~gather_writer() {
+        flush();
+    }
+
+public:
+    bool write(std::initializer_list<const_byte_span> pieces) {
+        return write(pieces.begin(), pieces.end());
+    }
+
+    bool write(const_byte_span piece) {
+        return write(&piece, &piece + 1);
+    }
+
+    // Any range of const_byte_span.
+    template <typename It>
+    bool write(It first, It last) {
+        bool referenced = false;
+        for (; first != last && !m_failure; ++first) {
+            const const_byte_span piece = *first;
+            if (piece.size() == 0) {
+                continue;
+            }
+
+            const auto* data = reinterpret_cast<const char*>(piece.data());
+            if (piece.size() >= m_copy_threshold) {
+                _add(data, piece.size());
+                referenced = true;
+            } else {
+                if (m_buffer.size() - m_used < piece.size()) {
+                    _flush();
+                }
+
+                std::memcpy(m_buffer.data() + m_used, data, piece.size());
+                _add(m_buffer.data() + m_used, piece.size());
+                m_used += piece.size();
+            }
+        }
+
+        if (referenced) {
+            _flush();
+        }
+
+        return !m_failure;
+    }
+
+    bool flush() {
+        _flush();
+        return !m_failure;
+    }
+
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // writev / WriteFile calls issued so far.
+    [[nodiscard]]
+    std::uint64_t system_calls() const noexcept {
+        return m_calls;
+    }
+
+    [[nodiscard]]
+    native_handle_type native_handle() const noexcept {
+        return m_handle;
+    }
+
+private:
+#if defined(IOV_MAX) && IOV_MAX < 64
+    static constexpr size_type max_pieces = IOV_MAX;
+#else
+    static constexpr size_type max_pieces = 64;
+#endif
+
+    // Consecutive buffered pieces share one entry.
+    void _add(const char* data, size_type size) {
+        if (!m_pieces.empty()) {
+            auto& back = m_pieces.back();
+            if (static_cast<const char*>(back.iov_base) + back.iov_len == data) {
+                back.iov_len += size;
+                return;
+            }
+        }
+
+        if (m_pieces.size() == max_pieces) {
+            // A piece just copied in moves down with the buffer.
+            const bool buffered = data == m_buffer.data() + m_used;
+            _flush();
+            if (buffered) {
+                std::memmove(m_buffer.data(), data, size);
+                data = m_buffer.data();
+            }
+        }
+
+        m_pieces.push_back(detail::io_vec{const_cast<char*>(data), size});
+    }
+
+    void _flush() {
+        if (!m_failure && !m_pieces.empty()) {
+            m_failure = !_write_all();
+        }
+
+        m_pieces.clear();
+        m_used = 0;
+    }
+
+#ifdef _WIN32
+    bool _write_all() noexcept {
+        for (const auto& piece : m_pieces) {
+            const auto* data = static_cast<const char*>(piece.iov_base);
+            for (size_type done = 0; done < piece.iov_len;) {
+                ++m_calls;
+                const long long put = detail::fd_write(m_handle, data + done, piece.iov_len - done);
+                if (put <= 0) {
+                    return false;
+                }
+                done += static_cast<size_type>(put);
+            }
+        }
+
+        return true;
+    }
+#else
+    // Short writes resume in the middle of the entry they stopped in.
+    bool _write_all() noexcept {
+        detail::io_vec* next = m_pieces.data();
+        detail::io_vec* const last = next + m_pieces.size();
+        while (next != last) {
+            ++m_calls;
+            ssize_t put;
+            do {
+                put = ::writev(m_handle, next, static_cast<int>(last - next));
+            } while (put < 0 && errno == EINTR);
+
+            if (put <= 0) {
+                return false;
+            }
+
+            auto left = static_cast<size_type>(put);
+            while (next != last && left >= next->iov_len) {
+                left -= next->iov_len;
+                ++next;
+            }
+
+            if (next != last) {
+                next->iov_base = static_cast<char*>(next->iov_base) + left;
+                next->iov_len -= left;
+            }
+        }
+
+        return true;
+    }
+#endif
+
+private:
+    native_handle_type m_handle;
+    std::vector<char> m_buffer;
+    size_type m_used;
+    size_type m_copy_threshold;
+    std::vector<detail::io_vec> m_pieces;
+    std::uint64_t m_calls;
+    bool m_failure;
+};
+
+
+// How copy_stream moved the bytes.
+enum class copy_method {
+    none,            // nothing to copy, or the copy failed before it started
+    clone,           // FICLONE: the destination shares the source's extents (btrfs, XFS, ...)
+    copy_file_range, // in-kernel copy, server side on NFS 4.2 / SMB
+    sendfile,        // in-kernel copy through the page cache
+    buffered         // sgetn / sputn through a user space block
+};
+
+struct copy_result {
+    std::uint64_t bytes = 0;
+    copy_method method = copy_method::none;
+    bool failed = false;
+};
+
+// Reaching std::filebuf's descriptor relies on libstdc++ internals that may change without notice.
+// Define MRT_STREAMBYTE_NO_FILEBUF_FD to leave it out; copy_stream then copies std::filebuf streams
+// through its buffered path and keeps kernel copies for fd_bytebuf.
+#if defined(__GLIBCXX__) && !defined(_WIN32) && !defined(MRT_STREAMBYTE_NO_FILEBUF_FD)
+#define MRT_STREAMBYTE_FILEBUF_FD 1
+#endif
+
+namespace detail {
+#ifdef MRT_STREAMBYTE_FILEBUF_FD
+    // Version-fragile: libstdc++ keeps the descriptor in the reserved, protected _M_file, and a
+    // member pointer named through a derived class reaches it without touching the filebuf.
+    struct filebuf_fd : std::basic_filebuf<char> {
+        static int get(std::basic_filebuf<char>& file) noexcept {
+            return (file.*&filebuf_fd::_M_file).fd();
+        }
+    };
+#endif
+
+    // The descriptor behind a streambuf when there is one we know how to reach.
+    inline
+    fd_handle streambuf_fd(std::basic_streambuf<char>* streambuf) noexcept {
+        if (auto* fd_file = dynamic_cast<fd_bytebuf*>(streambuf); fd_file != nullptr && fd_file->is_open()) {
+            return fd_file->native_handle();
+        }
+#ifdef MRT_STREAMBYTE_FILEBUF_FD
+        if (auto* file = dynamic_cast<std::basic_filebuf<char>*>(streambuf); file != nullptr && file->is_open()) {
+            return filebuf_fd::get(*file);
+        }
+#endif
+        return invalid_fd();
+    }
+
+#ifdef __linux__
+    // Errors meaning "not between these two files", after which the next method is tried.
+    [[nodiscard]] inline
+    bool unsupported_copy(int error) noexcept {
+        return error == EXDEV || error == EINVAL || error == ENOSYS || error == EOPNOTSUPP || error == EBADF
+            || error == ETXTBSY || error == EPERM;
+    }
+
+    // Kernel copy from the descriptor offsets, advancing them. True once the source is exhausted;
+    // false with failed unset when the kernel refused, so the next method picks up from there.
+    // A 0 before any byte moved is not trusted as the end: procfs and sysfs files report it (and a
+    // size of 0) yet have content, so the next method, and at last read(), gets to look.
+    template <typename Call>
+    bool kernel_copy(copy_result& result, copy_method method, Call&& call) noexcept {
+        constexpr std::size_t chunk = std::size_t{1} << 30;
+        for (;;) {
+            const ssize_t moved = call(chunk);
+            if (moved > 0) {
+                result.bytes += static_cast<std::uint64_t>(moved);
+                result.method = method;
+            } else if (moved == 0) {
+                return result.bytes != 0;
+            } else if (errno != EINTR) {
+                result.failed = !unsupported_copy(errno);
+                return false;
+            }
+        }
+    }
+
+    [[nodiscard]] inline
+    bool clone_whole_file(fd_handle in, fd_handle out, std::uint64_t& size) noexcept {
+        struct stat in_info{};
+        struct stat out_info{};
+        if (::fstat(in, &in_info) != 0 || ::fstat(out, &out_info) != 0 || !S_ISREG(in_info.st_mode)
+            || !S_ISREG(out_info.st_mode) || out_info.st_size != 0 || in_info.st_size == 0) {
+            return false;
+        }
+
+        // FICLONE from <linux/fs.h>, which clashes with <sys/mount.h> on older glibc.
+        constexpr unsigned long ficlone = _IOW(0x94, 9, int);
+        if (::ioctl(out, ficlone, in) != 0) {
+            return false;
+        }
+
+        size = static_cast<std::uint64_t>(in_info.st_size);
+        return ::lseek(in, 0, SEEK_END) >= 0 && ::lseek(out, static_cast<off_t>(size), SEEK_SET) >= 0;
+    }
+#endif
+
+    inline
+    void buffered_copy(copy_result& result, std::basic_streambuf<char>* in, std::basic_streambuf<char>* out) {
+        std::vector<char> block(std::size_t{1} << 20);
+        for (;;) {
+            const std::streamsize got = in->sgetn(block.data(), static_cast<std::streamsize>(block.size()));
+            if (got <= 0) {
+                break;
+            }
+
+            const std::streamsize put = out->sputn(block.data(), got);
+            result.bytes += static_cast<std::uint64_t>(std::max<std::streamsize>(put, 0));
+            result.method = copy_method::buffered;
+            if (put != got) {
+                result.failed = true;
+                break;
+            }
+        }
+
+        if (out->pubsync() != 0) {
+            result.failed = true;
+        }
+    }
+}
+
+// Copies everything from in's position to its end into out at out's position, and leaves both
+// positioned after the copy. When both streambufs are backed by descriptors (fd_bytebuf, or
+// std::filebuf with libstdc++), the kernel does it: a reflink when a whole file goes into an
+// empty one, then copy_file_range, then sendfile. Anything else, and whatever the kernel
+// refused, is copied through a 1 MiB block.
+inline
+copy_result copy_stream(std::basic_streambuf<char>* in, std::basic_streambuf<char>* out) {
+    copy_result result;
+    if (in == nullptr || out == nullptr) {
+        result.failed = true;
+        return result;
+    }
+
+#ifdef __linux__
+    const detail::fd_handle in_fd = detail::streambuf_fd(in);
+    const detail::fd_handle out_fd = detail::streambuf_fd(out);
+    if (in_fd != detail::invalid_fd() && out_fd != detail::invalid_fd()) {
+        // Seeking to the current position drops read-ahead and flushes pending output, so the
+        // descriptor offsets are the stream positions again.
+        const auto in_pos = in->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+        const auto out_pos = out->pubseekoff(0, std::ios_base::cur, std::ios_base::out);
+        const auto invalid = std::streampos(std::streamoff(-1));
+        if (in_pos != invalid && out_pos != invalid
+            && in->pubseekpos(in_pos, std::ios_base::in) != invalid && out->pubseekpos(out_pos, std::ios_base::out) != invalid) {
+            bool finished = std::streamoff(in_pos) == 0 && std::streamoff(out_pos) == 0
+                && detail::clone_whole_file(in_fd, out_fd, result.bytes);
+            if (finished) {
+                result.method = copy_method::clone;
+            }
+
+            if (!finished) {
+                finished = detail::kernel_copy(result, copy_method::copy_file_range, [&](std::size_t chunk) {
+                    return ::copy_file_range(in_fd, nullptr, out_fd, nullptr, chunk, 0);
+                });
+            }
+
+            if (!finished && !result.failed) {
+                finished = detail::kernel_copy(result, copy_method::sendfile, [&](std::size_t chunk) {
+                    return ::sendfile(out_fd, in_fd, nullptr, chunk);
+                });
+            }
+
+            // Let the streambufs catch up with the offsets the kernel moved.
+            in->pubseekpos(std::streamoff(::lseek(in_fd, 0, SEEK_CUR)), std::ios_base::in);
+            out->pubseekpos(std::streamoff(::lseek(out_fd, 0, SEEK_CUR)), std::ios_base::out);
+            if (finished || result.failed) {
+                return result;
+            }
+        }
+    }
+#endif
+
+    detail::buffered_copy(result, in, out);
+    return result;
+}
+
+inline
+copy_result copy_stream(std::istream& in, std::ostream& out) {
+    const copy_result result = copy_stream(in.rdbuf(), out.rdbuf());
+    if (result.failed) {
+        out.setstate(std::ios_base::badbit);
+    }
+
+    return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,405 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_HASH_HPP_
+#define MRT_STREAMBYTE_HASH_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+// The CRC32C kernel is picked at compile time from the target flags (e.g. -msse4.2); slice-by-8 tables otherwise.
+#if (defined(__SSE4_2__) || defined(__AVX__)) && (defined(__x86_64__) || defined(_M_X64))
+#include <nmmintrin.h>
+#define MRT_STREAMBYTE_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+#include <arm_acle.h>
+#define MRT_STREAMBYTE_CRC32C_ARM
+#endif
+
+namespace mrt {
+
+namespace detail {
+    [[nodiscard]] constexpr
+    std::uint64_t rotl64(std::uint64_t value, unsigned bits) noexcept {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    using crc32c_tables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+    // Reflected Castagnoli polynomial; table k advances a byte through k further zero bytes.
+    [[nodiscard]] constexpr
+    crc32c_tables make_crc32c_tables() noexcept {
+        crc32c_tables tables{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1u) != 0 ? 0x82F63B78u : 0u);
+            }
+            tables[0][i] = crc;
+        }
+
+        for (std::size_t k = 1; k < tables.size(); ++k) {
+            for (std::size_t i = 0; i < 256; ++i) {
+                const std::uint32_t previous = tables[k - 1][i];
+                tables[k][i] = (previous >> 8) ^ tables[0][previous & 0xFFu];
+            }
+        }
+
+        return tables;
+    }
+
+    inline constexpr crc32c_tables crc32c_table = make_crc32c_tables();
+
+    [[nodiscard]] inline
+    std::uint32_t crc32c_update(std::uint32_t crc, const std::byte* p, std::size_t n) noexcept {
+#if defined(MRT_STREAMBYTE_CRC32C_SSE42)
+        std::uint64_t wide = crc;
+        for (; n >= 8; p += 8, n -= 8) {
+            wide = _mm_crc32_u64(wide, load_le64(p));
+        }
+
+        crc = static_cast<std::uint32_t>(wide);
+        for (; n != 0; ++p, --n) {
+            crc = _mm_crc32_u8(crc, std::to_integer<std::uint8_t>(*p));
+        }
+#elif defined(MRT_STREAMBYTE_CRC32C_ARM)
+        for (; n >= 8; p += 8, n -= 8) {
+            crc = __crc32cd(crc, load_le64(p));
+        }
+
+        for (; n != 0; ++p, --n) {
+            crc = __crc32cb(crc, std::to_integer<std::uint8_t>(*p));
+        }
+#else
+        const crc32c_tables& t = crc32c_table;
+        for (; n >= 8; p += 8, n -= 8) {
+            const std::uint32_t lo = load_le32(p) ^ crc;
+            const std::uint32_t hi = load_le32(p + 4);
+            crc = t[7][lo & 0xFFu] ^ t[6][(lo >> 8) & 0xFFu] ^ t[5][(lo >> 16) & 0xFFu] ^ t[4][lo >> 24]
+                ^ t[3][hi & 0xFFu] ^ t[2][(hi >> 8) & 0xFFu] ^ t[1][(hi >> 16) & 0xFFu] ^ t[0][hi >> 24];
+        }
+
+        for (; n != 0; ++p, --n) {
+            crc = t[0][(crc ^ std::to_integer<std::uint32_t>(*p)) & 0xFFu] ^ (crc >> 8);
+        }
+#endif
+        return crc;
+    }
+}
+
+// Hashers share one tiny interface: update(const_byte_span) any number of times, then value().
+
+// CRC32C (Castagnoli), as used by iSCSI, ext4 and most storage formats.
+// Uses the SSE4.2 / ARMv8 crc32c instructions when the target has them.
+class crc32c {
+public:
+    using result_type = std::uint32_t;
+
+public:
+    constexpr
+    crc32c() noexcept
+        : m_state{0xFFFFFFFFu}
+    { }
+
+    void update(const_byte_span bytes) noexcept {
+        m_state = detail::crc32c_update(m_state, bytes.data(), bytes.size());
+    }
+
+    [[nodiscard]] constexpr
+    result_type value() const noexcept {
+        return ~m_state;
+    }
+
+    constexpr
+    void reset() noexcept {
+        m_state = 0xFFFFFFFFu;
+    }
+
+private:
+    std::uint32_t m_state;
+};
+
+// XXH64. Input is buffered into 32 byte stripes so it can be fed in blocks of any size;
+// the four lanes are independent, which keeps the pipeline full without SIMD.
+class xxhash64 {
+public:
+    using result_type = std::uint64_t;
+
+private:
+    static constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    static constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr std::uint64_t prime3 = 0x165667B19E3779F9ull;
+    static constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ull;
+    static constexpr std::size_t stripe_size = 32;
+
+public:
+    explicit
+    xxhash64(std::uint64_t seed = 0) noexcept
+        : m_seed{seed}
+    {
+        reset();
+    }
+
+    void update(const_byte_span bytes) noexcept {
+        const std::byte* p = bytes.data();
+        std::size_t n = bytes.size();
+        m_length += n;
+
+        if (m_pending != 0) {
+            const std::size_t take = std::min(n, stripe_size - m_pending);
+            std::memcpy(m_stripe.data() + m_pending, p, take);
+            m_pending += take;
+            p += take;
+            n -= take;
+
+            if (m_pending != stripe_size) {
+                return;
+            }
+
+            _consume_stripe(m_stripe.data());
+            m_pending = 0;
+        }
+
+        for (; n >= stripe_size; p += stripe_size, n -= stripe_size) {
+            _consume_stripe(p);
+        }
+
+        if (n != 0) {
+            std::memcpy(m_stripe.data(), p, n);
+            m_pending = n;
+        }
+    }
+
+    [[nodiscard]]
+    result_type value() const noexcept {
+        std::uint64_t h;
+        if (m_length >= stripe_size) {
+            h = detail::rotl64(m_lanes[0], 1) + detail::rotl64(m_lanes[1], 7)
+              + detail::rotl64(m_lanes[2], 12) + detail::rotl64(m_lanes[3], 18);
+            for (const std::uint64_t lane : m_lanes) {
+                h = (h ^ _round(0, lane)) * prime1 + prime4;
+            }
+        } else {
+            h = m_seed + prime5;
+        }
+
+        h += m_length;
+
+        const std::byte* p = m_stripe.data();
+        std::size_t n = m_pending;
+        for (; n >= 8; p += 8, n -= 8) {
+            h = detail::rotl64(h ^ _round(0, detail::load_le64(p)), 27) * prime1 + prime4;
+        }
+
+        if (n >= 4) {
+            h = detail::rotl64(h ^ (std::uint64_t{detail::load_le32(p)} * prime1), 23) * prime2 + prime3;
+            p += 4;
+            n -= 4;
+        }
+
+        for (; n != 0; ++p, --n) {
+            h = detail::rotl64(h ^ (std::to_integer<std::uint64_t>(*p) * prime5), 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+
+        return h;
+    }
+
+    void reset() noexcept {
+        m_lanes = {m_seed + prime1 + prime2, m_seed + prime2, m_seed, m_seed - prime1};
+        m_length = 0;
+        m_pending = 0;
+    }
+
+private:
+    [[nodiscard]] static constexpr
+    std::uint64_t _round(std::uint64_t lane, std::uint64_t input) noexcept {
+        return detail::rotl64(lane + input * prime2, 31) * prime1;
+    }
+
+    void _consume_stripe(const std::byte* p) noexcept {
+        m_lanes[0] = _round(m_lanes[0], detail::load_le64(p));
+        m_lanes[1] = _round(m_lanes[1], detail::load_le64(p + 8));
+        m_lanes[2] = _round(m_lanes[2], detail::load_le64(p + 16));
+        m_lanes[3] = _round(m_lanes[3], detail::load_le64(p + 24));
+    }
+
+private:
+    std::uint64_t m_seed;
+    std::array<std::uint64_t, 4> m_lanes;
+    std::array<std::byte, stripe_size> m_stripe;
+    std::uint64_t m_length;
+    std::size_t m_pending;
+};
+
+// Pass-through streambuf that feeds every byte moving between its user and `target` to a hasher,
+// so the digest is computed in the same pass as the I/O instead of a second sweep over the data.
+// Bulk reads and writes (what the streambyte iterators issue per block) are forwarded as a whole
+// and hashed in place; only single byte reads go through a small get area of its own.
+// On the read side the digest covers every byte pulled from the target, read-ahead included.
+template <typename Hasher>
+class hashing_streambuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using hasher_type = Hasher;
+
+    static constexpr std::size_t default_buffer_size = 4096;
+
+public:
+    explicit hashing_streambuf(streambuf_type* target, Hasher hasher = Hasher{}, std::size_t buffer_size = default_buffer_size)
+        : m_target{target}, m_hasher{std::move(hasher)}, m_buffer(std::max(buffer_size, std::size_t{1}))
+    { }
+
+    explicit hashing_streambuf(std::basic_ios<char_type, traits_type>& stream, Hasher hasher = Hasher{}, std::size_t buffer_size = default_buffer_size)
+        : hashing_streambuf(stream.rdbuf(), std::move(hasher), buffer_size)
+    { }
+
+    hashing_streambuf(const hashing_streambuf&) = delete;
+    hashing_streambuf& operator=(const hashing_streambuf&) = delete;
+
+public:
+    [[nodiscard]]
+    const Hasher& hasher() const noexcept {
+        return m_hasher;
+    }
+
+    [[nodiscard]]
+    Hasher& hasher() noexcept {
+        return m_hasher;
+    }
+
+    [[nodiscard]]
+    auto value() const {
+        return m_hasher.value();
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() != egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        char_type* data = m_buffer.data();
+        const std::streamsize got = m_target == nullptr ? 0 : m_target->sgetn(data, static_cast<std::streamsize>(m_buffer.size()));
+        if (got <= 0) {
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+
+        _hash(data, got);
+        setg(data, data, data + got);
+
+        return traits_type::to_int_type(*data);
+    }
+
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+        // Whatever sits in the get area was hashed when it was filled.
+        const std::streamsize buffered = std::min<std::streamsize>(egptr() - gptr(), count);
+        if (buffered > 0) {
+            traits_type::copy(s, gptr(), static_cast<std::size_t>(buffered));
+            gbump(static_cast<int>(buffered));
+        }
+
+        if (buffered == count || m_target == nullptr) {
+            return buffered;
+        }
+
+        const std::streamsize got = m_target->sgetn(s + buffered, count - buffered);
+        _hash(s + buffered, got);
+
+        return buffered + std::max<std::streamsize>(got, 0);
+    }
+
+    std::streamsize showmanyc() override {
+        return m_target == nullptr ? -1 : m_target->in_avail();
+    }
+
+    int_type overflow(int_type c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+
+        const char_type ch = traits_type::to_char_type(c);
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+        if (m_target == nullptr) {
+            return 0;
+        }
+
+        // Only what the target accepted ends up in the digest.
+        const std::streamsize written = m_target->sputn(s, count);
+        _hash(s, written);
+
+        return written;
+    }
+
+    int sync() override {
+        return m_target == nullptr ? -1 : m_target->pubsync();
+    }
+
+private:
+    void _hash(const char_type* s, std::streamsize count) {
+        if (count > 0) {
+            m_hasher.update({reinterpret_cast<const std::byte*>(s), static_cast<std::size_t>(count)});
+        }
+    }
+
+private:
+    streambuf_type* m_target;
+    Hasher m_hasher;
+    std::vector<char_type> m_buffer;
+};
+
+// Hashes what is left of a stream block by block, straight out of the iterator's buffer.
+template <typename Iterator, typename Hasher, typename = detail::enable_if_block_iterator_t<Iterator>>
+Hasher hash_bytes(Iterator first, Iterator last, Hasher hasher) {
+    while (first != last) {
+        const const_byte_span window = first.buffered();
+        hasher.update(window);
+        first.consume(window.size());
+    }
+
+    return hasher;
+}
+
+}
+
+#endif
@@ -0,0 +1,304 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_MMAP_HPP_
+#define MRT_STREAMBYTE_MMAP_HPP_
+
+#include "streambyte.hpp"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mrt {
+
+// Access pattern hints handed to the kernel for a mapping.
+enum class map_advice {
+    normal,
+    sequential,
+    random
+};
+
+struct map_options {
+    map_advice advice = map_advice::normal;
+    // Ask the kernel to start paging the whole file in right away.
+    bool will_need = false;
+    // Back the mapping with huge pages when the platform and filesystem allow it (best effort).
+    bool huge_pages = false;
+};
+
+// Read-only memory mapping of a whole file.
+// Iterators are plain const std::byte* so it drops into the same algorithms as istreambyte_iterator,
+// with random access and no copy at all.
+class mapped_bytes {
+public:
+    using value_type = std::byte;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using const_pointer = const std::byte*;
+    using const_iterator = const_pointer;
+    using iterator = const_iterator;
+
+public:
+    constexpr
+    mapped_bytes() noexcept
+        : m_data{nullptr}, m_size{0}, m_failure{false}
+    { }
+
+    explicit mapped_bytes(const char* path, map_options options = {}) noexcept
+        : mapped_bytes()
+    {
+        m_failure = !_map(path, options);
+    }
+
+    explicit mapped_bytes(const std::string& path, map_options options = {}) noexcept
+        : mapped_bytes(path.c_str(), options)
+    { }
+
+    mapped_bytes(const mapped_bytes&) = delete;
+    mapped_bytes& operator=(const mapped_bytes&) = delete;
+
+    mapped_bytes(mapped_bytes&& rhs) noexcept
+        : m_data{std::exchange(rhs.m_data, nullptr)}, m_size{std::exchange(rhs.m_size, 0)},
+          m_failure{std::exchange(rhs.m_failure, false)}
+    { }
+
+    mapped_bytes& operator=(mapped_bytes&& rhs) noexcept {
+        if (this != &rhs) {
+            _unmap();
+            m_data = std::exchange(rhs.m_data, nullptr);
+            m_size = std::exchange(rhs.m_size, 0);
+            m_failure = std::exchange(rhs.m_failure, false);
+        }
+
+        return *this;
+    }
+
+    ~mapped_bytes() {
+        _unmap();
+    }
+
+public:
+    [[nodiscard]] constexpr const_pointer data() const noexcept { return m_data; }
+    [[nodiscard]] constexpr size_type size() const noexcept { return m_size; }
+    [[nodiscard]] constexpr bool empty() const noexcept { return m_size == 0; }
+    [[nodiscard]] constexpr const_iterator begin() const noexcept { return m_data; }
+    [[nodiscard]] constexpr const_iterator end() const noexcept { return m_data + m_size; }
+    [[nodiscard]] constexpr std::byte operator[](size_type i) const noexcept { return m_data[i]; }
+
+    [[nodiscard]] constexpr
+    const_byte_span span() const noexcept {
+        return {m_data, m_size};
+    }
+
+    // True when the file could not be opened or mapped. Empty files map successfully to an empty range.
+    [[nodiscard]] constexpr
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // Changes the access pattern hint for [offset, offset + length) of the mapping.
+    bool advise(map_advice advice, size_type offset = 0, size_type length = static_cast<size_type>(-1)) const noexcept {
+        if (m_data == nullptr || offset >= m_size) {
+            return false;
+        }
+
+        length = std::min(length, m_size - offset);
+#ifdef _WIN32
+        (void)advice;
+        (void)length;
+        return true;
+#else
+        return _madvise(offset, length, _advice_flag(advice));
+#endif
+    }
+
+    // Asks the kernel to page [offset, offset + length) in ahead of use.
+    bool will_need(size_type offset = 0, size_type length = static_cast<size_type>(-1)) const noexcept {
+        if (m_data == nullptr || offset >= m_size) {
+            return false;
+        }
+
+        length = std::min(length, m_size - offset);
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte*>(m_data + offset), length};
+        return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+#else
+        return true;
+#endif
+#else
+        return _madvise(offset, length, MADV_WILLNEED);
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    bool _map(const char* path, map_options options) noexcept {
+        DWORD flags = FILE_ATTRIBUTE_NORMAL;
+        if (options.advice == map_advice::sequential) {
+            flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        } else if (options.advice == map_advice::random) {
+            flags |= FILE_FLAG_RANDOM_ACCESS;
+        }
+
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER file_size{};
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            return false;
+        }
+
+        if (file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return true;
+        }
+
+        // Large pages are not available for file backed sections; huge_pages is ignored here.
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr) {
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr) {
+            return false;
+        }
+
+        m_data = static_cast<const std::byte*>(view);
+        m_size = static_cast<size_type>(file_size.QuadPart);
+
+        if (options.will_need) {
+            will_need();
+        }
+
+        return true;
+    }
+
+    void _unmap() noexcept {
+        if (m_data != nullptr) {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+#else
+    bool _map(const char* path, map_options options) noexcept {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        if (info.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        const auto size = static_cast<size_type>(info.st_size);
+        void* view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        m_data = static_cast<const std::byte*>(view);
+        m_size = size;
+
+        if (options.advice != map_advice::normal) {
+            advise(options.advice);
+        }
+
+#ifdef MADV_HUGEPAGE
+        if (options.huge_pages) {
+            _madvise(0, m_size, MADV_HUGEPAGE);
+        }
+#endif
+
+        if (options.will_need) {
+            will_need();
+        }
+
+        return true;
+    }
+
+    void _unmap() noexcept {
+        if (m_data != nullptr) {
+            ::munmap(const_cast<std::byte*>(m_data), m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+
+    [[nodiscard]] static constexpr
+    int _advice_flag(map_advice advice) noexcept {
+        switch (advice) {
+        case map_advice::sequential: return MADV_SEQUENTIAL;
+        case map_advice::random: return MADV_RANDOM;
+        default: return MADV_NORMAL;
+        }
+    }
+
+    // madvise wants a page aligned start.
+    bool _madvise(size_type offset, size_type length, int flag) const noexcept {
+        const auto page = static_cast<size_type>(::sysconf(_SC_PAGESIZE));
+        const size_type aligned = offset - offset % page;
+        auto* start = const_cast<std::byte*>(m_data + aligned);
+
+        return ::madvise(start, length + (offset - aligned), flag) == 0;
+    }
+#endif
+
+private:
+    const std::byte* m_data;
+    size_type m_size;
+    bool m_failure;
+};
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_PARALLEL_HPP_
+#define MRT_STREAMBYTE_PARALLEL_HPP_
+
+#include "streambyte.hpp"
+#include "streambyte_mmap.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mrt {
+
+namespace detail {
+    [[nodiscard]] inline
+    unsigned worker_count(unsigned threads, std::size_t chunk_count) noexcept {
+        if (threads == 0) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        return static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(chunk_count, 1)));
+    }
+
+    // Runs work(index) for every index in [0, count) on `threads` workers pulling from a shared counter.
+    // The first exception stops the remaining work and is rethrown once every worker joined. A worker
+    // that fails to start leaves its share to the others.
+    template <typename Work>
+    void run_indexed(std::size_t count, unsigned threads, Work& work) {
+        std::atomic<std::size_t> next{0};
+        std::atomic<bool> stop{false};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto worker = [&]() {
+            for (;;) {
+                const std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= count || stop.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                try {
+                    work(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{error_mutex};
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    stop = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        threads = worker_count(threads, count);
+        pool.reserve(threads - 1);
+        for (unsigned i = 1; i < threads; ++i) {
+            try {
+                pool.emplace_back(worker);
+            } catch (const std::system_error&) {
+                // Out of threads: the ones already started, and this one, share the work.
+                break;
+            }
+        }
+
+        // The calling thread takes a share as well.
+        worker();
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    [[nodiscard]] inline
+    const_byte_span chunk_at(const_byte_span bytes, std::size_t chunk_size, std::size_t index) noexcept {
+        const std::size_t offset = index * chunk_size;
+        return bytes.subspan(offset, std::min(chunk_size, bytes.size() - offset));
+    }
+
+    [[nodiscard]] inline
+    std::size_t chunk_count(std::size_t size, std::size_t chunk_size) noexcept {
+        // Not (size + chunk_size - 1) / chunk_size, which wraps for chunk sizes near SIZE_MAX.
+        return size / chunk_size + (size % chunk_size != 0);
+    }
+}
+
+// Splits bytes into chunk_size slices and calls fn(index, chunk) for each of them concurrently.
+// fn must be safe to call from several threads at once. threads == 0 uses every hardware thread.
+template <typename Function>
+void parallel_for_each_chunk(const_byte_span bytes, std::size_t chunk_size, Function fn, unsigned threads = 0) {
+    chunk_size = std::max(chunk_size, std::size_t{1});
+    auto work = [&](std::size_t index) {
+        fn(index, detail::chunk_at(bytes, chunk_size, index));
+    };
+
+    detail::run_indexed(detail::chunk_count(bytes.size(), chunk_size), threads, work);
+}
+
+// Same, over a file. Workers share one read-only mapping of it, so chunks are never copied
+// and each worker only faults in the offset range it was handed.
+// Returns false when the file cannot be mapped.
+template <typename Function>
+bool parallel_for_each_chunk(const std::string& path, std::size_t chunk_size, Function fn, unsigned threads = 0) {
+    map_options options;
+    options.advice = map_advice::sequential;
+    const mapped_bytes file{path, options};
+    if (file.failed()) {
+        return false;
+    }
+
+    parallel_for_each_chunk(file.span(), chunk_size, std::move(fn), threads);
+    return true;
+}
+
+// Maps every chunk concurrently with transform(index, chunk), then folds the results
+// in chunk order: reduce(...reduce(reduce(init, r0), r1)..., rn).
+template <typename T, typename Transform, typename Reduce>
+T parallel_reduce_chunks(const_byte_span bytes, std::size_t chunk_size, T init, Transform transform, Reduce reduce, unsigned threads = 0) {
+    using result_type = std::decay_t<std::invoke_result_t<Transform&, std::size_t, const_byte_span>>;
+
+    chunk_size = std::max(chunk_size, std::size_t{1});
+    const std::size_t count = detail::chunk_count(bytes.size(), chunk_size);
+    std::vector<std::optional<result_type>> results(count);
+
+    auto work = [&](std::size_t index) {
+        results[index].emplace(transform(index, detail::chunk_at(bytes, chunk_size, index)));
+    };
+    detail::run_indexed(count, threads, work);
+
+    for (auto& result : results) {
+        init = reduce(std::move(init), std::move(*result));
+    }
+
+    return init;
+}
+
+// Same, over a file. Returns std::nullopt when the file cannot be mapped.
+template <typename T, typename Transform, typename Reduce>
+std::optional<T> parallel_reduce_chunks(const std::string& path, std::size_t chunk_size, T init, Transform transform, Reduce reduce, unsigned threads = 0) {
+    map_options options;
+    options.advice = map_advice::sequential;
+    const mapped_bytes file{path, options};
+    if (file.failed()) {
+        return std::nullopt;
+    }
+
+    return parallel_reduce_chunks(file.span(), chunk_size, std::move(init), std::move(transform), std::move(reduce), threads);
+}
+
+}
+
+#endif
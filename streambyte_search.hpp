@@ -0,0 +1,359 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_SEARCH_HPP_
+#define MRT_STREAMBYTE_SEARCH_HPP_
+
+#include "streambyte.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Kernels are picked at compile time from the target flags (e.g. -mavx2); memchr / a lookup table otherwise.
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define MRT_STREAMBYTE_SEARCH_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace mrt {
+
+namespace detail {
+    // Up to this many needles are compared in registers; more go through a 256 entry table.
+    inline constexpr std::size_t simd_needle_count = 8;
+
+    [[nodiscard]] inline
+    const std::byte* find_byte(const std::byte* first, const std::byte* last, std::byte value) noexcept {
+#if defined(__AVX2__)
+        const __m256i needle = _mm256_set1_epi8(static_cast<char>(value));
+        for (; last - first >= 32; first += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+            if (mask != 0) {
+                return first + count_trailing_zeros(mask);
+            }
+        }
+#endif
+#if defined(MRT_STREAMBYTE_SEARCH_SSE2)
+        const __m128i needle16 = _mm_set1_epi8(static_cast<char>(value));
+        for (; last - first >= 16; first += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle16)));
+            if (mask != 0) {
+                return first + count_trailing_zeros(mask);
+            }
+        }
+#elif defined(__ARM_NEON)
+        const uint8x16_t needle16 = vdupq_n_u8(static_cast<std::uint8_t>(value));
+        for (; last - first >= 16; first += 16) {
+            const uint8x16_t matches = vceqq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t*>(first)), needle16);
+            // Narrow to one nibble per byte to get a 64 bit mask.
+            const std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+            if (mask != 0) {
+                return first + count_trailing_zeros(mask) / 4;
+            }
+        }
+#endif
+        if (first == last) {
+            return last;
+        }
+
+        const void* found = std::memchr(first, static_cast<int>(value), static_cast<std::size_t>(last - first));
+        return found != nullptr ? static_cast<const std::byte*>(found) : last;
+    }
+
+    [[nodiscard]] inline
+    const std::byte* find_any_of(const std::byte* first, const std::byte* last, const_byte_span needles) noexcept {
+        if (needles.empty()) {
+            return last;
+        }
+
+        if (needles.size() == 1) {
+            return find_byte(first, last, needles[0]);
+        }
+
+        if (needles.size() <= simd_needle_count) {
+#if defined(__AVX2__)
+            __m256i wide[simd_needle_count];
+            for (std::size_t i = 0; i < needles.size(); ++i) {
+                wide[i] = _mm256_set1_epi8(static_cast<char>(needles[i]));
+            }
+
+            for (; last - first >= 32; first += 32) {
+                const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+                __m256i matches = _mm256_setzero_si256();
+                for (std::size_t i = 0; i < needles.size(); ++i) {
+                    matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, wide[i]));
+                }
+
+                const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(matches));
+                if (mask != 0) {
+                    return first + count_trailing_zeros(mask);
+                }
+            }
+#endif
+#if defined(MRT_STREAMBYTE_SEARCH_SSE2)
+            __m128i narrow[simd_needle_count];
+            for (std::size_t i = 0; i < needles.size(); ++i) {
+                narrow[i] = _mm_set1_epi8(static_cast<char>(needles[i]));
+            }
+
+            for (; last - first >= 16; first += 16) {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+                __m128i matches = _mm_setzero_si128();
+                for (std::size_t i = 0; i < needles.size(); ++i) {
+                    matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, narrow[i]));
+                }
+
+                const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(matches));
+                if (mask != 0) {
+                    return first + count_trailing_zeros(mask);
+                }
+            }
+#elif defined(__ARM_NEON)
+            uint8x16_t narrow[simd_needle_count];
+            for (std::size_t i = 0; i < needles.size(); ++i) {
+                narrow[i] = vdupq_n_u8(static_cast<std::uint8_t>(needles[i]));
+            }
+
+            for (; last - first >= 16; first += 16) {
+                const uint8x16_t block = vld1q_u8(reinterpret_cast<const std::uint8_t*>(first));
+                uint8x16_t matches = vdupq_n_u8(0);
+                for (std::size_t i = 0; i < needles.size(); ++i) {
+                    matches = vorrq_u8(matches, vceqq_u8(block, narrow[i]));
+                }
+
+                const std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+                if (mask != 0) {
+                    return first + count_trailing_zeros(mask) / 4;
+                }
+            }
+#endif
+        }
+
+        std::array<bool, 256> table{};
+        for (const auto needle : needles) {
+            table[static_cast<std::uint8_t>(needle)] = true;
+        }
+
+        for (; first != last; ++first) {
+            if (table[static_cast<std::uint8_t>(*first)]) {
+                return first;
+            }
+        }
+
+        return last;
+    }
+
+    // Runs kernel over the iterator's blocks until it finds something, consuming the blocks before it.
+    template <typename Iterator, typename Kernel>
+    Iterator find_in_blocks(Iterator first, Iterator last, Kernel&& kernel) {
+        while (first != last) {
+            const const_byte_span window = first.buffered();
+            const std::byte* found = kernel(window.data(), window.data() + window.size());
+            const auto offset = static_cast<std::size_t>(found - window.data());
+
+            if (offset != window.size()) {
+                first.consume(offset);
+                return first;
+            }
+
+            first.consume(window.size());
+        }
+
+        return first;
+    }
+}
+
+// std::find over contiguous bytes with a SIMD kernel.
+[[nodiscard]] inline
+const std::byte* find_byte(const std::byte* first, const std::byte* last, std::byte value) noexcept {
+    return detail::find_byte(first, last, value);
+}
+
+[[nodiscard]] inline
+const std::byte* find_any_of(const std::byte* first, const std::byte* last, const_byte_span needles) noexcept {
+    return detail::find_any_of(first, last, needles);
+}
+
+// Same over a block iterator: whole blocks are scanned in place, then the iterator is left on the match.
+// Returns an end iterator when the value does not show up before the end of the stream.
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+Iterator find_byte(Iterator first, Iterator last, std::byte value) {
+    return detail::find_in_blocks(std::move(first), std::move(last), [value](const std::byte* b, const std::byte* e) {
+        return detail::find_byte(b, e, value);
+    });
+}
+
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+Iterator find_any_of(Iterator first, Iterator last, const_byte_span needles) {
+    return detail::find_in_blocks(std::move(first), std::move(last), [needles](const std::byte* b, const std::byte* e) {
+        return detail::find_any_of(b, e, needles);
+    });
+}
+
+// Input range splitting a stream on a delimiter. Each record is a const_byte_span without the delimiter,
+// pointing into the iterator's block; only records straddling blocks are copied, into a spill buffer.
+// Like std::getline, a trailing delimiter does not produce an empty last record.
+// A record stays valid until the iterator is incremented.
+template <typename BlockIterator>
+class record_view {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const_byte_span;
+        using pointer = void;
+        using reference = const_byte_span;
+        using difference_type = std::ptrdiff_t;
+
+        constexpr
+        iterator() noexcept
+            : m_view{nullptr}
+        { }
+
+        [[nodiscard]]
+        const_byte_span operator*() const noexcept {
+            return m_view->m_record;
+        }
+
+        iterator& operator++() {
+            m_view->_next();
+
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        [[nodiscard]]
+        bool operator==(const iterator& rhs) const noexcept {
+            return _at_end() == rhs._at_end();
+        }
+
+        [[nodiscard]]
+        bool operator!=(const iterator& rhs) const noexcept {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend record_view;
+        constexpr explicit
+        iterator(record_view* view) noexcept
+            : m_view{view}
+        { }
+
+        [[nodiscard]]
+        bool _at_end() const noexcept {
+            return m_view == nullptr || m_view->m_done;
+        }
+
+        record_view* m_view;
+    };
+
+public:
+    record_view(BlockIterator source, std::byte delimiter)
+        : m_source{std::move(source)}, m_delimiter{delimiter}, m_pending{0}, m_done{false}, m_started{false}
+    { }
+
+    [[nodiscard]]
+    iterator begin() {
+        if (!m_started) {
+            m_started = true;
+            _next();
+        }
+
+        return iterator{this};
+    }
+
+    [[nodiscard]]
+    iterator end() noexcept {
+        return iterator{};
+    }
+
+private:
+    void _next() {
+        // The previous record may point into the block: only drop it now.
+        if (m_pending != 0) {
+            m_source.consume(m_pending);
+            m_pending = 0;
+        }
+        m_spill.clear();
+
+        for (;;) {
+            const const_byte_span window = m_source.buffered();
+            if (window.empty()) {
+                m_done = m_spill.empty();
+                m_record = const_byte_span{m_spill.data(), m_spill.size()};
+                return;
+            }
+
+            const std::byte* begin = window.data();
+            const std::byte* found = detail::find_byte(begin, begin + window.size(), m_delimiter);
+            const auto length = static_cast<std::size_t>(found - begin);
+
+            if (length != window.size()) {
+                if (m_spill.empty()) {
+                    m_record = const_byte_span{begin, length};
+                } else {
+                    m_spill.insert(m_spill.end(), begin, found);
+                    m_record = const_byte_span{m_spill.data(), m_spill.size()};
+                }
+
+                m_pending = length + 1;
+                return;
+            }
+
+            m_spill.insert(m_spill.end(), begin, begin + window.size());
+            m_source.consume(window.size());
+        }
+    }
+
+private:
+    BlockIterator m_source;
+    std::byte m_delimiter;
+    std::vector<std::byte> m_spill;
+    const_byte_span m_record;
+    std::size_t m_pending;
+    bool m_done;
+    bool m_started;
+};
+
+template <typename Iterator, typename = detail::enable_if_block_iterator_t<Iterator>>
+record_view<Iterator> split_records(Iterator it, std::byte delimiter) {
+    return record_view<Iterator>{std::move(it), delimiter};
+}
+
+inline
+record_view<shared_istreambyte_iterator<>> split_records(std::basic_istream<char>& stream, std::byte delimiter,
+    std::size_t block_size = shared_istreambyte_iterator<>::default_block_size)
+{
+    return record_view<shared_istreambyte_iterator<>>{shared_istreambyte_iterator<>{stream, block_size}, delimiter};
+}
+
+}
+
+#endif
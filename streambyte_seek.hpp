@@ -0,0 +1,337 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_SEEK_HPP_
+#define MRT_STREAMBYTE_SEEK_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <istream>
+#include <iterator>
+#include <streambuf>
+#include <type_traits>
+#include <vector>
+
+namespace mrt {
+
+// Random access view of a seekable streambuf that keeps at most cache_blocks blocks in memory.
+// Blocks start at multiples of block_size and are replaced least recently used first, so a
+// binary search over a multi-GB file reads a few dozen blocks instead of the whole file.
+// The streambuf position is moved around freely; nothing else should read from it meanwhile.
+// The cache is not synchronized: share one seekable_bytes between threads only under a lock.
+class seekable_bytes {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+    using istream_type = std::basic_istream<char_type, traits_type>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    static constexpr size_type default_block_size = 64 * 1024;
+    static constexpr size_type default_cache_blocks = 8;
+
+    template <typename T>
+    class basic_iterator;
+
+    template <typename T>
+    class record_range;
+
+    using iterator = basic_iterator<std::byte>;
+    using const_iterator = iterator;
+
+public:
+    explicit seekable_bytes(streambuf_type* streambuf, size_type block_size = default_block_size,
+                            size_type cache_blocks = default_cache_blocks)
+        : m_streambuf{streambuf}, m_block_size{std::max<size_type>(block_size, 1)},
+          m_size{0}, m_slots(std::max<size_type>(cache_blocks, 1)), m_last{0}, m_clock{0},
+          m_misses{0}, m_failure{streambuf == nullptr}
+    {
+        if (!m_failure) {
+            const auto end = m_streambuf->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+            m_failure = end == std::streampos(std::streamoff(-1));
+            m_size = m_failure ? 0 : static_cast<size_type>(std::streamoff(end));
+        }
+
+        m_storage.resize(m_slots.size() * m_block_size);
+    }
+
+    explicit seekable_bytes(istream_type& stream, size_type block_size = default_block_size,
+                            size_type cache_blocks = default_cache_blocks)
+        : seekable_bytes(stream.rdbuf(), block_size, cache_blocks)
+    { }
+
+    // Iterators point back to the cache.
+    seekable_bytes(const seekable_bytes&) = delete;
+    seekable_bytes& operator=(const seekable_bytes&) = delete;
+
+public:
+    [[nodiscard]] size_type size() const noexcept { return m_size; }
+    [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+    [[nodiscard]] size_type block_size() const noexcept { return m_block_size; }
+
+    [[nodiscard]] iterator begin() const noexcept;
+    [[nodiscard]] iterator end() const noexcept;
+
+    // No bounds check, like the other containers.
+    [[nodiscard]]
+    std::byte operator[](size_type offset) const {
+        const std::byte* block = _block(offset / m_block_size);
+        return block[offset % m_block_size];
+    }
+
+    // Copies up to dest.size() bytes starting at offset; returns how many were available.
+    size_type read(size_type offset, byte_span dest) const {
+        if (offset >= m_size) {
+            return 0;
+        }
+
+        const size_type count = std::min<size_type>(dest.size(), m_size - offset);
+        auto* out = dest.data();
+        for (size_type done = 0; done != count;) {
+            const size_type at = offset + done;
+            const size_type in_block = at % m_block_size;
+            const size_type take = std::min(count - done, m_block_size - in_block);
+            std::memcpy(out + done, _block(at / m_block_size) + in_block, take);
+            done += take;
+        }
+
+        return count;
+    }
+
+    // The file seen as an array of trivially copyable T (native layout), starting at first.
+    // A trailing partial record is left out.
+    template <typename T>
+    [[nodiscard]]
+    record_range<T> records(size_type first = 0) const noexcept;
+
+    // Blocks read from the streambuf so far.
+    [[nodiscard]]
+    std::uint64_t cache_misses() const noexcept {
+        return m_misses;
+    }
+
+    // True when the streambuf could not seek or a block came back short. Missing bytes read as zero.
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+private:
+    static constexpr size_type no_block = static_cast<size_type>(-1);
+
+    struct slot {
+        size_type block = no_block;
+        std::uint64_t last_use = 0;
+    };
+
+    // Caches are expected to be small, so a scan beats a map; the last block hit is checked first.
+    const std::byte* _block(size_type block) const {
+        slot* hit = &m_slots[m_last];
+        if (hit->block != block) {
+            hit = nullptr;
+            slot* oldest = &m_slots.front();
+            for (auto& candidate : m_slots) {
+                if (candidate.block == block) {
+                    hit = &candidate;
+                    break;
+                }
+
+                if (candidate.last_use < oldest->last_use) {
+                    oldest = &candidate;
+                }
+            }
+
+            if (hit == nullptr) {
+                hit = oldest;
+                _load(static_cast<size_type>(hit - m_slots.data()), block);
+            }
+
+            m_last = static_cast<size_type>(hit - m_slots.data());
+        }
+
+        hit->last_use = ++m_clock;
+        return m_storage.data() + m_last * m_block_size;
+    }
+
+    void _load(size_type index, size_type block) const {
+        std::byte* dest = m_storage.data() + index * m_block_size;
+        const size_type first = block * m_block_size;
+        const size_type expected = first < m_size ? std::min(m_block_size, m_size - first) : 0;
+        size_type got = 0;
+
+        ++m_misses;
+        m_slots[index].block = block;
+        if (m_streambuf->pubseekpos(static_cast<std::streamoff>(first), std::ios_base::in)
+            != std::streampos(std::streamoff(-1))) {
+            while (got != expected) {
+                const auto n = m_streambuf->sgetn(reinterpret_cast<char_type*>(dest + got),
+                                                  static_cast<std::streamsize>(expected - got));
+                if (n <= 0) {
+                    break;
+                }
+                got += static_cast<size_type>(n);
+            }
+        }
+
+        if (got != expected) {
+            m_failure = true;
+            std::memset(dest + got, 0, expected - got);
+        }
+    }
+
+private:
+    streambuf_type* m_streambuf;
+    size_type m_block_size;
+    size_type m_size;
+    mutable std::vector<std::byte> m_storage;
+    mutable std::vector<slot> m_slots;
+    mutable size_type m_last;
+    mutable std::uint64_t m_clock;
+    mutable std::uint64_t m_misses;
+    mutable bool m_failure;
+};
+
+// Random access iterator over the T records of a seekable_bytes; T = std::byte walks the raw bytes.
+// Dereferencing returns a copy, so values stay valid when their block is evicted.
+template <typename T>
+class seekable_bytes::basic_iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = T;
+
+public:
+    constexpr basic_iterator() noexcept
+        : m_owner{nullptr}, m_offset{0}
+    { }
+
+    constexpr basic_iterator(const seekable_bytes* owner, size_type offset) noexcept
+        : m_owner{owner}, m_offset{offset}
+    { }
+
+public:
+    [[nodiscard]]
+    reference operator*() const {
+        if constexpr (std::is_same_v<T, std::byte>) {
+            return (*m_owner)[m_offset];
+        } else {
+            T value;
+            m_owner->read(m_offset, byte_span{reinterpret_cast<std::byte*>(&value), sizeof(T)});
+            return value;
+        }
+    }
+
+    [[nodiscard]]
+    reference operator[](difference_type n) const {
+        return *(*this + n);
+    }
+
+    // Byte offset of the current record in the stream.
+    [[nodiscard]] constexpr
+    size_type offset() const noexcept {
+        return m_offset;
+    }
+
+    basic_iterator& operator++() noexcept { m_offset += sizeof(T); return *this; }
+    basic_iterator& operator--() noexcept { m_offset -= sizeof(T); return *this; }
+    basic_iterator operator++(int) noexcept { auto old = *this; ++*this; return old; }
+    basic_iterator operator--(int) noexcept { auto old = *this; --*this; return old; }
+
+    basic_iterator& operator+=(difference_type n) noexcept {
+        m_offset = static_cast<size_type>(static_cast<difference_type>(m_offset) + n * static_cast<difference_type>(sizeof(T)));
+        return *this;
+    }
+
+    basic_iterator& operator-=(difference_type n) noexcept {
+        return *this += -n;
+    }
+
+    [[nodiscard]] friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept { return it += n; }
+    [[nodiscard]] friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept { return it += n; }
+    [[nodiscard]] friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept { return it -= n; }
+
+    [[nodiscard]] friend
+    difference_type operator-(const basic_iterator& lhs, const basic_iterator& rhs) noexcept {
+        return (static_cast<difference_type>(lhs.m_offset) - static_cast<difference_type>(rhs.m_offset))
+            / static_cast<difference_type>(sizeof(T));
+    }
+
+    [[nodiscard]] friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset == rhs.m_offset; }
+    [[nodiscard]] friend bool operator!=(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset != rhs.m_offset; }
+    [[nodiscard]] friend bool operator<(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset < rhs.m_offset; }
+    [[nodiscard]] friend bool operator>(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset > rhs.m_offset; }
+    [[nodiscard]] friend bool operator<=(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset <= rhs.m_offset; }
+    [[nodiscard]] friend bool operator>=(const basic_iterator& lhs, const basic_iterator& rhs) noexcept { return lhs.m_offset >= rhs.m_offset; }
+
+private:
+    const seekable_bytes* m_owner;
+    size_type m_offset;
+};
+
+template <typename T>
+class seekable_bytes::record_range {
+public:
+    using iterator = basic_iterator<T>;
+
+public:
+    constexpr record_range(iterator first, iterator last) noexcept
+        : m_first{first}, m_last{last}
+    { }
+
+public:
+    [[nodiscard]] constexpr iterator begin() const noexcept { return m_first; }
+    [[nodiscard]] constexpr iterator end() const noexcept { return m_last; }
+    [[nodiscard]] constexpr size_type size() const noexcept { return static_cast<size_type>(m_last - m_first); }
+    [[nodiscard]] constexpr bool empty() const noexcept { return m_first == m_last; }
+    [[nodiscard]] T operator[](size_type i) const { return m_first[static_cast<difference_type>(i)]; }
+
+private:
+    iterator m_first;
+    iterator m_last;
+};
+
+inline seekable_bytes::iterator seekable_bytes::begin() const noexcept {
+    return iterator{this, 0};
+}
+
+inline seekable_bytes::iterator seekable_bytes::end() const noexcept {
+    return iterator{this, m_size};
+}
+
+template <typename T>
+seekable_bytes::record_range<T> seekable_bytes::records(size_type first) const noexcept {
+    static_assert(std::is_trivially_copyable_v<T>, "records are copied out of the cache byte by byte");
+
+    const size_type count = first < m_size ? (m_size - first) / sizeof(T) : 0;
+    return record_range<T>{basic_iterator<T>{this, first}, basic_iterator<T>{this, first + count * sizeof(T)}};
+}
+
+}
+
+#endif
@@ -0,0 +1,309 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_STATS_HPP_
+#define MRT_STREAMBYTE_STATS_HPP_
+
+#include "streambyte.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace mrt {
+
+// Plain copy of the io_stats counters at one point in time.
+struct io_counters {
+    std::uint64_t calls = 0;        // read / write calls that reached the wrapped source or sink
+    std::uint64_t bytes = 0;        // bytes actually moved
+    std::uint64_t requested = 0;    // bytes asked for
+    std::uint64_t short_calls = 0;  // short reads (end of data) or short writes (failed commits)
+    std::uint64_t blocked_ns = 0;   // time spent inside the wrapped calls
+
+    // How full the blocks were: 1 when every read got all it asked for.
+    [[nodiscard]]
+    double fill_ratio() const noexcept {
+        return requested == 0 ? 0.0 : static_cast<double>(bytes) / static_cast<double>(requested);
+    }
+
+    [[nodiscard]]
+    double average_call_size() const noexcept {
+        return calls == 0 ? 0.0 : static_cast<double>(bytes) / static_cast<double>(calls);
+    }
+};
+
+// Per-call latency in power of two buckets: bucket i counts calls that took [2^(i-1), 2^i) ns,
+// bucket 0 the ones under a nanosecond. 40 buckets reach about 9 minutes.
+class latency_histogram {
+public:
+    static constexpr std::size_t bucket_count = 40;
+
+public:
+    latency_histogram() noexcept {
+        reset();
+    }
+
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+public:
+    void record(std::uint64_t ns) noexcept {
+        std::size_t bucket = 0;
+        while (ns != 0 && bucket + 1 < bucket_count) {
+            ns >>= 1;
+            ++bucket;
+        }
+
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::uint64_t count(std::size_t bucket) const noexcept {
+        return m_buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Exclusive upper bound of a bucket, in nanoseconds.
+    [[nodiscard]] static constexpr
+    std::uint64_t upper_bound(std::size_t bucket) noexcept {
+        return std::uint64_t{1} << bucket;
+    }
+
+    // Upper bound of the bucket holding the given quantile (0.5, 0.99, ...); 0 without samples.
+    [[nodiscard]]
+    std::uint64_t percentile(double quantile) const noexcept {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            total += count(i);
+        }
+
+        if (total == 0) {
+            return 0;
+        }
+
+        const auto rank = static_cast<std::uint64_t>(quantile * static_cast<double>(total - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += count(i);
+            if (seen > rank) {
+                return upper_bound(i);
+            }
+        }
+
+        return upper_bound(bucket_count - 1);
+    }
+
+    // f(upper_bound_ns, count) for every non-empty bucket.
+    template <typename F>
+    void for_each_bucket(F&& f) const {
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            if (const std::uint64_t n = count(i); n != 0) {
+                f(upper_bound(i), n);
+            }
+        }
+    }
+
+    void reset() noexcept {
+        for (auto& bucket : m_buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets;
+};
+
+// Counters shared by every copy of an instrumented source or sink. Updates are relaxed atomics,
+// so a monitoring thread may snapshot() or export_to() while the iterators run.
+class io_stats {
+public:
+    io_stats() noexcept = default;
+
+    io_stats(const io_stats&) = delete;
+    io_stats& operator=(const io_stats&) = delete;
+
+public:
+    void record(std::size_t requested, std::size_t moved, std::uint64_t ns) noexcept {
+        m_calls.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(moved, std::memory_order_relaxed);
+        m_requested.fetch_add(requested, std::memory_order_relaxed);
+        if (moved < requested) {
+            m_short_calls.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_blocked_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void record_latency(std::uint64_t ns) noexcept {
+        m_latency.record(ns);
+    }
+
+    [[nodiscard]]
+    io_counters snapshot() const noexcept {
+        io_counters counters;
+        counters.calls = m_calls.load(std::memory_order_relaxed);
+        counters.bytes = m_bytes.load(std::memory_order_relaxed);
+        counters.requested = m_requested.load(std::memory_order_relaxed);
+        counters.short_calls = m_short_calls.load(std::memory_order_relaxed);
+        counters.blocked_ns = m_blocked_ns.load(std::memory_order_relaxed);
+
+        return counters;
+    }
+
+    [[nodiscard]]
+    const latency_histogram& latency() const noexcept {
+        return m_latency;
+    }
+
+    // Export hook: f(name, value) per counter, names fit Prometheus / StatsD as is.
+    // Bucketed latencies are available through latency().for_each_bucket().
+    template <typename F>
+    void export_to(F&& f) const {
+        const io_counters counters = snapshot();
+        f(std::string_view{"calls"}, counters.calls);
+        f(std::string_view{"bytes"}, counters.bytes);
+        f(std::string_view{"requested_bytes"}, counters.requested);
+        f(std::string_view{"short_calls"}, counters.short_calls);
+        f(std::string_view{"blocked_ns"}, counters.blocked_ns);
+    }
+
+    void reset() noexcept {
+        m_calls.store(0, std::memory_order_relaxed);
+        m_bytes.store(0, std::memory_order_relaxed);
+        m_requested.store(0, std::memory_order_relaxed);
+        m_short_calls.store(0, std::memory_order_relaxed);
+        m_blocked_ns.store(0, std::memory_order_relaxed);
+        m_latency.reset();
+    }
+
+private:
+    std::atomic<std::uint64_t> m_calls{0};
+    std::atomic<std::uint64_t> m_bytes{0};
+    std::atomic<std::uint64_t> m_requested{0};
+    std::atomic<std::uint64_t> m_short_calls{0};
+    std::atomic<std::uint64_t> m_blocked_ns{0};
+    latency_histogram m_latency;
+};
+
+namespace detail {
+    // Runs call() and records it; timed adds two clock reads and the histogram update.
+    template <bool timed, typename Call>
+    std::size_t record_call(io_stats* stats, std::size_t requested, Call&& call) {
+        if constexpr (timed) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::size_t moved = call();
+            const auto ns = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            stats->record(requested, moved, ns);
+            stats->record_latency(ns);
+
+            return moved;
+        } else {
+            const std::size_t moved = call();
+            stats->record(requested, moved, 0);
+
+            return moved;
+        }
+    }
+}
+
+// Source decorator counting what the iterator asks of the wrapped source. Iterators without it
+// pay nothing; timed = false keeps the counters but skips the clock and the histogram.
+template <typename Source = streambuf_source, bool timed = true>
+class instrumented_source {
+public:
+    using source_type = Source;
+
+public:
+    instrumented_source() noexcept
+        : m_source{}, m_stats{nullptr}
+    { }
+
+    instrumented_source(Source source, io_stats& stats) noexcept
+        : m_source{std::move(source)}, m_stats{&stats}
+    { }
+
+public:
+    std::size_t read(char* dest, std::size_t count) {
+        return detail::record_call<timed>(m_stats, count, [&] { return m_source.read(dest, count); });
+    }
+
+    [[nodiscard]] explicit
+    operator bool() const noexcept {
+        return m_stats != nullptr && static_cast<bool>(m_source);
+    }
+
+    [[nodiscard]]
+    const Source& source() const noexcept {
+        return m_source;
+    }
+
+private:
+    Source m_source;
+    io_stats* m_stats;
+};
+
+// Same for sinks; every short write is a failed commit.
+template <typename Sink = streambuf_sink, bool timed = true>
+class instrumented_sink {
+public:
+    using sink_type = Sink;
+
+public:
+    instrumented_sink() noexcept
+        : m_sink{}, m_stats{nullptr}
+    { }
+
+    instrumented_sink(Sink sink, io_stats& stats) noexcept
+        : m_sink{std::move(sink)}, m_stats{&stats}
+    { }
+
+public:
+    std::size_t write(const char* data, std::size_t count) {
+        return detail::record_call<timed>(m_stats, count, [&] { return m_sink.write(data, count); });
+    }
+
+    [[nodiscard]] explicit
+    operator bool() const noexcept {
+        return m_stats != nullptr && static_cast<bool>(m_sink);
+    }
+
+    [[nodiscard]]
+    const Sink& sink() const noexcept {
+        return m_sink;
+    }
+
+private:
+    Sink m_sink;
+    io_stats* m_stats;
+};
+
+template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE, typename Source = streambuf_source>
+using instrumented_istreambyte_iterator = istreambyte_iterator<buf_size, instrumented_source<Source>>;
+
+template <std::size_t buf_size = MRT_HARDWARE_CI_SIZE, typename Sink = streambuf_sink>
+using instrumented_ostreambyte_iterator = ostreambyte_iterator<buf_size, instrumented_sink<Sink>>;
+
+}
+
+#endif
@@ -0,0 +1,292 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_TEE_HPP_
+#define MRT_STREAMBYTE_TEE_HPP_
+
+#include "streambyte.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mrt {
+
+namespace detail {
+    template <typename Sink, typename = void>
+    struct has_update : std::false_type { };
+
+    template <typename Sink>
+    struct has_update<Sink, std::void_t<decltype(std::declval<Sink&>().update(std::declval<const_byte_span>()))>> : std::true_type { };
+
+    template <typename Sink, typename = void>
+    struct has_failed : std::false_type { };
+
+    template <typename Sink>
+    struct has_failed<Sink, std::void_t<decltype(std::declval<const Sink&>().failed())>> : std::true_type { };
+
+    // One block to one tee sink; false when the sink refused it.
+    //  - std::ostream, std::streambuf or std::streambuf*: sputn on the streambuf
+    //  - hashers (update(const_byte_span)): update
+    //  - callables taking a const_byte_span; a bool result tells whether it was taken
+    //  - ostreambyte_iterator and the like: assignment of the span, then failed() when there is one
+    template <typename Sink>
+    bool deliver(Sink& sink, const_byte_span block) {
+        using sink_type = std::remove_cv_t<Sink>;
+        if constexpr (std::is_base_of_v<std::basic_ostream<char>, sink_type>) {
+            std::basic_streambuf<char>* streambuf = sink.rdbuf();
+            return deliver(streambuf, block);
+        } else if constexpr (std::is_base_of_v<std::basic_streambuf<char>, sink_type>) {
+            std::basic_streambuf<char>* streambuf = &sink;
+            return deliver(streambuf, block);
+        } else if constexpr (std::is_convertible_v<sink_type, std::basic_streambuf<char>*>) {
+            std::basic_streambuf<char>* streambuf = sink;
+            const auto size = static_cast<std::streamsize>(block.size());
+            return streambuf != nullptr && streambuf->sputn(reinterpret_cast<const char*>(block.data()), size) == size;
+        } else if constexpr (has_update<sink_type>::value) {
+            sink.update(block);
+            return true;
+        } else if constexpr (std::is_invocable_v<Sink&, const_byte_span>) {
+            if constexpr (std::is_convertible_v<std::invoke_result_t<Sink&, const_byte_span>, bool>) {
+                return static_cast<bool>(sink(block));
+            } else {
+                sink(block);
+                return true;
+            }
+        } else {
+            static_assert(std::is_assignable_v<Sink&, const_byte_span>, "tee sinks are streambufs, hashers, callables or byte output iterators");
+            sink = block;
+            if constexpr (has_failed<sink_type>::value) {
+                return !sink.failed();
+            } else {
+                return true;
+            }
+        }
+    }
+}
+
+struct tee_result {
+    std::uint64_t bytes = 0;      // bytes read from the source
+    std::size_t failed_sinks = 0; // sinks that refused a block; they got nothing after it
+
+    [[nodiscard]] constexpr
+    bool failed() const noexcept {
+        return failed_sinks != 0;
+    }
+};
+
+// Reads [first, last) once and hands every block, straight out of the iterator's buffer, to each
+// sink in turn. Sinks are taken by reference so their state (a digest, pending bytes of an
+// ostreambyte_iterator) stays with the caller; flush those afterwards as usual.
+// Sinks too slow to keep up with the source can be wrapped in a threaded_sink.
+template <typename Iterator, typename... Sinks, typename = detail::enable_if_block_iterator_t<Iterator>>
+tee_result tee(Iterator first, Iterator last, Sinks&&... sinks) {
+    tee_result result;
+    std::array<bool, sizeof...(Sinks)> alive;
+    alive.fill(true);
+
+    while (first != last) {
+        const const_byte_span block = first.buffered();
+        std::size_t index = 0;
+        const auto feed = [&result, &alive, &index, block](auto& sink) {
+            if (alive[index] && !detail::deliver(sink, block)) {
+                alive[index] = false;
+                ++result.failed_sinks;
+            }
+            ++index;
+        };
+        (feed(sinks), ...);
+
+        result.bytes += block.size();
+        first.consume(block.size());
+    }
+
+    return result;
+}
+
+// Tee sink that runs `sink` on its own thread. Blocks are copied into one of max_blocks buffers
+// and queued; when the thread falls that far behind, the tee waits, so memory stays bounded.
+// finish() (or destruction) waits for the queue to drain; exceptions thrown by the sink come
+// back out of finish(). The sink must not be used by anyone else until then.
+template <typename Sink>
+class threaded_sink {
+public:
+    using sink_type = Sink;
+
+    static constexpr std::size_t default_max_blocks = 4;
+
+private:
+    using size_type = std::size_t;
+
+    struct queued_block {
+        size_type index;
+        size_type size;
+    };
+
+public:
+    explicit threaded_sink(Sink& sink, size_type max_blocks = default_max_blocks)
+        : m_sink{sink}, m_blocks(std::max(max_blocks, size_type{1})), m_failure{false}, m_stop{false}
+    {
+        for (size_type i = 0; i < m_blocks.size(); ++i) {
+            m_free.push_back(i);
+        }
+
+        m_worker = std::thread{[this]() { _drain_loop(); }};
+    }
+
+    threaded_sink(const threaded_sink&) = delete;
+    threaded_sink& operator=(const threaded_sink&) = delete;
+
+    ~threaded_sink() {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+public:
+    bool operator()(const_byte_span block) {
+        if (block.size() == 0) {
+            return !failed();
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_wake_producer.wait(lock, [this]() { return !m_free.empty() || m_failure; });
+        if (m_failure || m_stop) {
+            return false;
+        }
+
+        const size_type index = m_free.front();
+        m_free.pop_front();
+        lock.unlock();
+
+        // Buffers only grow, so after the first few blocks this is a plain copy.
+        auto& buffer = m_blocks[index];
+        if (buffer.size() < block.size()) {
+            buffer.resize(block.size());
+        }
+        std::memcpy(buffer.data(), block.data(), block.size());
+
+        lock.lock();
+        m_queued.push_back({index, block.size()});
+        lock.unlock();
+        m_wake_worker.notify_one();
+
+        return true;
+    }
+
+    // Waits for every queued block to reach the sink and stops the thread.
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stop = true;
+        }
+        m_wake_worker.notify_one();
+
+        if (m_worker.joinable()) {
+            m_worker.join();
+        }
+
+        if (m_error) {
+            std::rethrow_exception(std::exchange(m_error, nullptr));
+        }
+
+        return !m_failure;
+    }
+
+    [[nodiscard]]
+    bool failed() const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_failure;
+    }
+
+private:
+    void _drain_loop() {
+        for (;;) {
+            queued_block block{};
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_wake_worker.wait(lock, [this]() { return !m_queued.empty() || m_stop; });
+                if (m_queued.empty()) {
+                    return;
+                }
+
+                block = m_queued.front();
+                m_queued.pop_front();
+            }
+
+            // The sink runs unlocked so the tee keeps reading.
+            bool delivered = false;
+            std::exception_ptr error;
+            try {
+                delivered = detail::deliver(m_sink, const_byte_span{m_blocks[block.index].data(), block.size});
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                m_free.push_back(block.index);
+                if (!delivered) {
+                    m_failure = true;
+                    m_error = error;
+                    // Nothing more goes to a failed sink.
+                    m_queued.clear();
+                }
+            }
+            m_wake_producer.notify_one();
+
+            if (!delivered) {
+                return;
+            }
+        }
+    }
+
+private:
+    Sink& m_sink;
+    std::vector<std::vector<std::byte>> m_blocks;
+    std::deque<size_type> m_free;
+    std::deque<queued_block> m_queued;
+    bool m_failure;
+    bool m_stop;
+    std::exception_ptr m_error;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake_worker;
+    std::condition_variable m_wake_producer;
+    std::thread m_worker;
+};
+
+}
+
+#endif
@@ -0,0 +1,546 @@
+/* Copyright 2019 Alexandre Leblanc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MRT_STREAMBYTE_URING_HPP_
+#define MRT_STREAMBYTE_URING_HPP_
+
+// Opt-in: define MRT_STREAMBYTE_IO_URING before including this header. Linux only.
+// Talks to the kernel directly (no liburing), so there is nothing extra to link.
+#if defined(MRT_STREAMBYTE_IO_URING) && defined(__linux__)
+
+#include "streambyte.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <new>
+#include <streambuf>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace mrt {
+
+namespace detail {
+    // Minimal io_uring ring: setup, shared ring mappings, submission and completion.
+    class uring {
+    public:
+        uring() noexcept = default;
+        uring(const uring&) = delete;
+        uring& operator=(const uring&) = delete;
+
+        ~uring() {
+            close();
+        }
+
+        bool open(unsigned entries) noexcept {
+            io_uring_params params{};
+            m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (m_fd < 0) {
+                return false;
+            }
+
+            m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap) {
+                m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+            }
+
+            m_sq_ring = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+            if (m_sq_ring == MAP_FAILED) {
+                m_sq_ring = nullptr;
+                close();
+                return false;
+            }
+
+            if (single_mmap) {
+                m_cq_ring = m_sq_ring;
+            } else {
+                m_cq_ring = ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+                if (m_cq_ring == MAP_FAILED) {
+                    m_cq_ring = nullptr;
+                    close();
+                    return false;
+                }
+            }
+
+            m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                close();
+                return false;
+            }
+
+            auto* sq = static_cast<char*>(m_sq_ring);
+            auto* cq = static_cast<char*>(m_cq_ring);
+            m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            m_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            m_sqes = static_cast<io_uring_sqe*>(sqes);
+            m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            m_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            return true;
+        }
+
+        void close() noexcept {
+            if (m_sqes != nullptr) {
+                ::munmap(m_sqes, m_sqes_size);
+                m_sqes = nullptr;
+            }
+
+            if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+                ::munmap(m_cq_ring, m_cq_size);
+            }
+            m_cq_ring = nullptr;
+
+            if (m_sq_ring != nullptr) {
+                ::munmap(m_sq_ring, m_sq_size);
+                m_sq_ring = nullptr;
+            }
+
+            if (m_fd >= 0) {
+                ::close(m_fd);
+                m_fd = -1;
+            }
+        }
+
+        bool register_buffers(const iovec* buffers, unsigned count) noexcept {
+            return ::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+        }
+
+        // Queues an operation; nothing reaches the kernel until submit().
+        // Callers never keep more operations in flight than the ring has entries.
+        void prepare(std::uint8_t opcode, int fd, void* addr, std::uint32_t len, std::uint64_t offset,
+            std::uint64_t user_data, int buf_index) noexcept
+        {
+            const unsigned tail = *m_sq_tail + m_queued;
+            const unsigned index = tail & m_sq_mask;
+            io_uring_sqe& sqe = m_sqes[index];
+
+            sqe = io_uring_sqe{};
+            sqe.opcode = opcode;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<std::uint64_t>(addr);
+            sqe.len = len;
+            sqe.off = offset;
+            sqe.user_data = user_data;
+            if (buf_index >= 0) {
+                sqe.buf_index = static_cast<std::uint16_t>(buf_index);
+            }
+
+            m_sq_array[index] = index;
+            ++m_queued;
+        }
+
+        // Submits everything queued in one syscall, optionally waiting for one completion.
+        bool submit(bool wait) noexcept {
+            if (m_queued != 0) {
+                __atomic_store_n(m_sq_tail, *m_sq_tail + m_queued, __ATOMIC_RELEASE);
+            }
+
+            const unsigned to_submit = m_queued;
+            const unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+            m_queued = 0;
+
+            if (to_submit == 0 && !wait) {
+                return true;
+            }
+
+            for (;;) {
+                const long ret = ::syscall(__NR_io_uring_enter, m_fd, to_submit, wait ? 1u : 0u, flags, nullptr, 0);
+                if (ret >= 0) {
+                    return true;
+                }
+
+                if (errno != EINTR) {
+                    return false;
+                }
+            }
+        }
+
+        template <typename Handler>
+        void reap(Handler&& handler) {
+            unsigned head = *m_cq_head;
+            const unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+                handler(cqe.user_data, cqe.res);
+            }
+
+            __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        }
+
+    private:
+        int m_fd = -1;
+        void* m_sq_ring = nullptr;
+        void* m_cq_ring = nullptr;
+        std::size_t m_sq_size = 0;
+        std::size_t m_cq_size = 0;
+        std::size_t m_sqes_size = 0;
+        unsigned* m_sq_tail = nullptr;
+        unsigned m_sq_mask = 0;
+        unsigned* m_sq_array = nullptr;
+        io_uring_sqe* m_sqes = nullptr;
+        unsigned* m_cq_head = nullptr;
+        unsigned* m_cq_tail = nullptr;
+        unsigned m_cq_mask = 0;
+        io_uring_cqe* m_cqes = nullptr;
+        unsigned m_queued = 0;
+    };
+}
+
+// Streambuf over a regular file that bypasses basic_filebuf and keeps `depth` reads or writes
+// in flight through io_uring, on buffers registered with the kernel when allowed.
+// Plugs into istreambyte_iterator / ostreambyte_iterator / byte_chunks like any streambuf.
+// Opened either for reading (std::ios_base::in) or for writing (std::ios_base::out, truncating).
+class uring_bytebuf : public std::basic_streambuf<char> {
+public:
+    using char_type = char;
+    using traits_type = std::char_traits<char_type>;
+    using int_type = traits_type::int_type;
+
+    static constexpr std::size_t default_block_size = std::size_t{1} << 18;
+    static constexpr unsigned default_depth = 8;
+
+private:
+    using size_type = std::size_t;
+    static constexpr size_type alignment = 4096;
+
+    enum class slot_state {
+        idle,
+        pending,
+        ready
+    };
+
+    struct slot {
+        char_type* data = nullptr;
+        size_type size = 0;
+        size_type done = 0;
+        std::uint64_t offset = 0;
+        slot_state state = slot_state::idle;
+    };
+
+public:
+    uring_bytebuf(const char* path, std::ios_base::openmode mode = std::ios_base::in,
+        size_type block_size = default_block_size, unsigned depth = default_depth)
+        : m_fd{-1}, m_writing{(mode & std::ios_base::out) != 0}, m_fixed{false}, m_failure{false},
+          m_block_size{_round_up(std::max(block_size, size_type{1}))}, m_file_size{0}, m_next_offset{0},
+          m_current{0}, m_has_current{false}, m_eof{false}
+    {
+        m_failure = !_open(path, std::max(depth, 1u));
+    }
+
+    uring_bytebuf(const uring_bytebuf&) = delete;
+    uring_bytebuf& operator=(const uring_bytebuf&) = delete;
+
+    ~uring_bytebuf() override {
+        if (m_writing) {
+            sync();
+        }
+
+        _drain();
+        m_ring.close();
+
+        for (auto& s : m_slots) {
+            ::operator delete(s.data, std::align_val_t{alignment});
+        }
+
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    // True when the file or the ring could not be set up, or an operation failed.
+    [[nodiscard]]
+    bool failed() const noexcept {
+        return m_failure;
+    }
+
+    // True when reads and writes go through registered (fixed) buffers.
+    [[nodiscard]]
+    bool uses_fixed_buffers() const noexcept {
+        return m_fixed;
+    }
+
+protected:
+    int_type underflow() override {
+        if (m_writing || m_fd < 0) {
+            return traits_type::eof();
+        }
+
+        if (gptr() != egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        // The slots queued after the end read past it; resubmitting them would only push further.
+        if (m_eof) {
+            return traits_type::eof();
+        }
+
+        // Blocks are consumed in submission order; the one just used goes back in flight.
+        if (m_has_current) {
+            _submit_read(m_slots[m_current]);
+            if (!m_ring.submit(false)) {
+                m_failure = true;
+            }
+            m_current = (m_current + 1) % m_slots.size();
+        }
+        m_has_current = true;
+
+        slot& s = m_slots[m_current];
+        if (!_wait_for(s) || s.done == 0) {
+            m_eof = true;
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+
+        s.state = slot_state::idle;
+        setg(s.data, s.data, s.data + s.done);
+        return traits_type::to_int_type(*s.data);
+    }
+
+    int_type overflow(int_type c) override {
+        if (!m_writing || m_fd < 0) {
+            return traits_type::eof();
+        }
+
+        if (!_flush_current(false)) {
+            return traits_type::eof();
+        }
+
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        if (!m_writing || m_fd < 0) {
+            return 0;
+        }
+
+        _flush_current(true);
+        return m_failure ? -1 : 0;
+    }
+
+private:
+    [[nodiscard]] static constexpr
+    size_type _round_up(size_type size) noexcept {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    bool _open(const char* path, unsigned depth) {
+        const int flags = m_writing ? (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC);
+        m_fd = ::open(path, flags, 0644);
+        if (m_fd < 0) {
+            return false;
+        }
+
+        struct stat info{};
+        if (::fstat(m_fd, &info) != 0) {
+            return false;
+        }
+        m_file_size = static_cast<std::uint64_t>(info.st_size);
+
+        if (!m_ring.open(depth)) {
+            return false;
+        }
+
+        m_slots.resize(depth);
+        m_iovecs.resize(depth);
+        std::vector<iovec> buffers(depth);
+        for (unsigned i = 0; i < depth; ++i) {
+            m_slots[i].data = static_cast<char_type*>(::operator new(m_block_size, std::align_val_t{alignment}));
+            buffers[i] = iovec{m_slots[i].data, m_block_size};
+        }
+
+        // Registration can fail under a low RLIMIT_MEMLOCK; plain reads / writes still work then.
+        m_fixed = m_ring.register_buffers(buffers.data(), depth);
+
+        if (m_writing) {
+            setp(m_slots[0].data, m_slots[0].data + m_block_size);
+        } else {
+            for (auto& s : m_slots) {
+                _submit_read(s);
+            }
+            m_ring.submit(false);
+        }
+
+        return true;
+    }
+
+    std::uint8_t _opcode() const noexcept {
+        if (m_writing) {
+            return m_fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITEV;
+        }
+
+        return m_fixed ? IORING_OP_READ_FIXED : IORING_OP_READV;
+    }
+
+    void _prepare(slot& s) {
+        const auto index = static_cast<std::uint64_t>(&s - m_slots.data());
+        char_type* addr = s.data + s.done;
+        const auto len = static_cast<std::uint32_t>(s.size - s.done);
+
+        if (m_fixed) {
+            m_ring.prepare(_opcode(), m_fd, addr, len, s.offset + s.done, index, static_cast<int>(index));
+        } else {
+            m_iovecs[index] = iovec{addr, len};
+            m_ring.prepare(_opcode(), m_fd, &m_iovecs[index], 1, s.offset + s.done, index, -1);
+        }
+
+        s.state = slot_state::pending;
+    }
+
+    // Queues the next block of the file into s, if any is left.
+    void _submit_read(slot& s) {
+        s.done = 0;
+        s.size = 0;
+        s.state = slot_state::idle;
+
+        if (m_next_offset >= m_file_size) {
+            return;
+        }
+
+        s.offset = m_next_offset;
+        s.size = static_cast<size_type>(std::min<std::uint64_t>(m_block_size, m_file_size - m_next_offset));
+        m_next_offset += s.size;
+        _prepare(s);
+    }
+
+    // Sends the put area to the kernel and moves it to the next free slot.
+    bool _flush_current(bool wait_all) {
+        slot& s = m_slots[m_current];
+        const auto pending = static_cast<size_type>(pptr() - pbase());
+
+        if (pending != 0) {
+            s.offset = m_next_offset;
+            s.size = pending;
+            s.done = 0;
+            m_next_offset += pending;
+            _prepare(s);
+            m_current = (m_current + 1) % m_slots.size();
+        }
+
+        if (!m_ring.submit(false)) {
+            m_failure = true;
+        }
+
+        if (wait_all) {
+            _drain();
+        } else {
+            _wait_for(m_slots[m_current]);
+        }
+
+        slot& next = m_slots[m_current];
+        setp(next.data, next.data + m_block_size);
+        return !m_failure;
+    }
+
+    // Waits until s has no operation in flight. Returns false on error.
+    bool _wait_for(slot& s) {
+        while (s.state == slot_state::pending) {
+            if (!m_ring.submit(true)) {
+                m_failure = true;
+                return false;
+            }
+            _reap();
+        }
+
+        return !m_failure;
+    }
+
+    void _drain() {
+        for (auto& s : m_slots) {
+            if (!_wait_for(s)) {
+                return;
+            }
+        }
+    }
+
+    void _reap() {
+        m_ring.reap([this](std::uint64_t user_data, int res) {
+            slot& s = m_slots[static_cast<size_type>(user_data)];
+
+            if (res == -EINTR || res == -EAGAIN) {
+                _prepare(s);
+                return;
+            }
+
+            if (res <= 0) {
+                // A zero length transfer before the end means the file shrank under us.
+                if (res < 0 || m_writing) {
+                    m_failure = true;
+                }
+                s.state = m_writing ? slot_state::idle : slot_state::ready;
+                return;
+            }
+
+            s.done += static_cast<size_type>(res);
+            if (s.done < s.size) {
+                _prepare(s);
+                return;
+            }
+
+            s.state = m_writing ? slot_state::idle : slot_state::ready;
+        });
+
+        if (!m_ring.submit(false)) {
+            m_failure = true;
+        }
+    }
+
+private:
+    detail::uring m_ring;
+    int m_fd;
+    bool m_writing;
+    bool m_fixed;
+    bool m_failure;
+    size_type m_block_size;
+    std::uint64_t m_file_size;
+    std::uint64_t m_next_offset;
+    std::vector<slot> m_slots;
+    std::vector<iovec> m_iovecs;
+    size_type m_current;
+    bool m_has_current;
+    // Latched once a read comes back empty or fails.
+    bool m_eof;
+};
+
+}
+
+#endif
+
+#endif
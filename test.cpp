@@ -20,13 +20,41 @@
  */
 
 #include "streambyte.hpp"
+#include "streambyte_async.hpp"
+#include "streambyte_binary.hpp"
+#include "streambyte_bits.hpp"
+#include "streambyte_cdc.hpp"
+#include "streambyte_codec.hpp"
+#include "streambyte_compress.hpp"
+#include "streambyte_coro.hpp"
+#include "streambyte_fd.hpp"
+#include "streambyte_hash.hpp"
+#include "streambyte_mmap.hpp"
+#include "streambyte_parallel.hpp"
+#include "streambyte_search.hpp"
+#include "streambyte_seek.hpp"
+#include "streambyte_stats.hpp"
+#include "streambyte_tee.hpp"
+#include "streambyte_uring.hpp"
  
 #include <algorithm>
+#include <atomic>
+#include <array>
+#include <cctype>
+#include <chrono>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #define expect(x, y) expect_impl(x, y, __LINE__)
@@ -65,6 +93,119 @@ auto status() {
     std::cout << std::endl;
 }
 
+// Minimal codec for the compress_streambuf / decompress_streambuf plumbing:
+// each encode call writes a one byte length then up to 255 bytes, verbatim.
+struct length_prefix_encoder {
+    std::size_t calls = 0;
+
+    std::size_t block_size() const { return 100; }
+    bool failed() const { return false; }
+
+    template <typename Sink>
+    bool encode(const char* data, std::size_t size, mrt::encode_mode, Sink&& sink) {
+        ++calls;
+        for (;;) {
+            const auto chunk = std::min<std::size_t>(size, 255);
+            const auto length = static_cast<char>(chunk);
+            if (!sink(&length, 1) || !sink(data, chunk)) {
+                return false;
+            }
+
+            data += chunk;
+            size -= chunk;
+            if (size == 0) {
+                return true;
+            }
+        }
+    }
+};
+
+struct length_prefix_decoder {
+    std::size_t left = 0;
+    bool in_record = false;
+
+    std::size_t input_size() const { return 64; }
+    std::size_t output_size() const { return 16; }
+    bool failed() const { return false; }
+    bool idle() const { return !in_record; }
+
+    bool decode(const char*& in, const char* in_last, char*& out, char* out_last) {
+        while (in != in_last && out != out_last) {
+            if (!in_record) {
+                left = static_cast<unsigned char>(*in++);
+                in_record = left != 0;
+                continue;
+            }
+
+            const auto n = std::min<std::size_t>({left, static_cast<std::size_t>(in_last - in), static_cast<std::size_t>(out_last - out)});
+            std::copy(in, in + n, out);
+            in += n;
+            out += n;
+            left -= n;
+            in_record = left != 0;
+        }
+
+        return true;
+    }
+};
+
+// Manually advanced clock for the flush_after policy.
+struct test_clock {
+    using rep = std::chrono::nanoseconds::rep;
+    using period = std::chrono::nanoseconds::period;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<test_clock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{};
+
+    static time_point now() noexcept {
+        return current;
+    }
+};
+
+// Delivers characters without ever setting up a get area, like stdio synced streambufs.
+class unbuffered_streambuf : public std::streambuf {
+public:
+    explicit unbuffered_streambuf(std::string text)
+        : m_text{std::move(text)}, m_pos{0}
+    { }
+
+protected:
+    int_type underflow() override {
+        return m_pos == m_text.size() ? traits_type::eof() : traits_type::to_int_type(m_text[m_pos]);
+    }
+
+    int_type uflow() override {
+        return m_pos == m_text.size() ? traits_type::eof() : traits_type::to_int_type(m_text[m_pos++]);
+    }
+
+private:
+    std::string m_text;
+    std::size_t m_pos;
+};
+
+#if defined(MRT_STREAMBYTE_CORO) && defined(__linux__)
+#include <sys/socket.h>
+
+mrt::task<void> coro_send(mrt::async_socket_writer<mrt::epoll_executor>& writer, const std::vector<std::byte>& payload, int fd) {
+    for (std::size_t at = 0; at < payload.size(); at += 1000) {
+        const auto size = std::min<std::size_t>(1000, payload.size() - at);
+        co_await writer.write(mrt::const_byte_span{payload.data() + at, size});
+    }
+
+    co_await writer.flush();
+    ::shutdown(fd, SHUT_WR);
+}
+
+mrt::task<void> coro_receive(mrt::async_byte_reader<mrt::epoll_executor>& reader, std::vector<std::byte>& received, std::size_t& chunks) {
+    for (auto chunk = co_await reader.next_chunk(); !chunk.empty(); chunk = co_await reader.next_chunk()) {
+        received.insert(received.end(), chunk.begin(), chunk.end());
+        ++chunks;
+    }
+}
+#endif
+
 // This tests the integrity of the iterators.
 int main() {
     std::cout << "Starting testing..." << std::endl;
@@ -155,5 +296,1649 @@ int main() {
         status();
     }
 
+    // Case 4: bulk copy into a back_insert_iterator, several blocks long with 0xFF bytes in it.
+    {
+        std::cout << "istreambyte_iterator: bulk copy ";
+        std::string expected_bytes;
+        for (auto i = 0; i < 3000; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 256));
+        }
+
+        std::stringstream ss{expected_bytes};
+        std::vector<std::byte> resulting_bytes;
+        copy(mrt::istreambyte_iterator<64>{ss}, mrt::istreambyte_iterator<64>{}, std::back_inserter(resulting_bytes));
+
+        std::stringstream ss_bytewise{expected_bytes};
+        std::vector<std::byte> bytewise_bytes(mrt::istreambyte_iterator<64>{ss_bytewise}, mrt::istreambyte_iterator<64>{});
+
+        auto are_equals = std::equal(
+            std::begin(expected_bytes), std::end(expected_bytes),
+            std::begin(resulting_bytes), std::end(resulting_bytes),
+            [](const char& left, const std::byte& right) {
+                return static_cast<unsigned char>(left) == static_cast<unsigned char>(right);
+            }
+        );
+
+        expect(resulting_bytes.size() == expected_bytes.size(), "mrt::copy: Expected result do not match length.");
+        expect(are_equals, "mrt::copy: Expected results mismatch.");
+        expect(bytewise_bytes == resulting_bytes, "istreambyte_iterator: 0xFF bytes must not end the stream.");
+        expect(resulting_bytes.capacity() < (std::size_t{1} << 20),
+            "mrt::copy: A short stream should not leave a bulk chunk of capacity behind.");
+
+        std::string large_bytes(3 << 20, 'x');
+        std::stringstream ss_large{large_bytes};
+        std::vector<std::byte> large_result;
+        copy(mrt::istreambyte_iterator<>{ss_large}, mrt::istreambyte_iterator<>{}, std::back_inserter(large_result));
+        expect(large_result.size() == large_bytes.size(), "mrt::copy: Expected every byte of a multi-chunk stream.");
+
+        status();
+    }
+
+    // Case 5: read_bytes and copy_n into contiguous storage.
+    {
+        std::cout << "read_bytes / copy_n ";
+        std::stringstream ss;
+        ss << "012345674444234567890";
+
+        std::array<std::byte, 4> head{};
+        const auto head_count = mrt::read_bytes(ss, head);
+
+        std::array<std::byte, 32> rest{};
+        const auto rest_end = mrt::copy_n(mrt::istreambyte_iterator<4>{ss}, rest.size(), rest.data());
+
+        expect(head_count == head.size(), "read_bytes: Expected a full read.");
+        expect(head[3] == std::byte{'3'}, "read_bytes: Expected results mismatch.");
+        expect(rest_end - rest.data() == 17, "copy_n: Expected to stop at the end of the stream.");
+        expect(rest[0] == std::byte{'4'} && rest[16] == std::byte{'0'}, "copy_n: Expected results mismatch.");
+
+        status();
+    }
+
+    // Case 6: bulk writes mixed with single bytes keep their order.
+    {
+        std::cout << "ostreambyte_iterator: bulk write ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 3000; ++i) {
+            payload.push_back(static_cast<std::byte>(i % 256));
+        }
+
+        std::stringstream stream;
+        {
+            mrt::ostreambyte_iterator<64> it{stream};
+            *it = std::byte{'a'};
+            copy(std::begin(payload), std::end(payload), it);
+            *it = mrt::const_byte_span{payload.data(), 10};
+            *it = std::byte{'z'};
+            expect(!it.failed(), "ostreambyte_iterator: Bulk write should not fail.");
+        }
+        mrt::write_bytes(stream, mrt::const_byte_span{payload.data(), 2});
+
+        const std::string result = stream.str();
+        std::string expected_bytes{"a"};
+        for (auto i = 0; i < 3000; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 256));
+        }
+        for (auto i = 0; i < 10; ++i) {
+            expected_bytes.push_back(static_cast<char>(i));
+        }
+        expected_bytes += "z";
+        expected_bytes.push_back('\0');
+        expected_bytes.push_back('\1');
+
+        expect(result == expected_bytes, "ostreambyte_iterator: Bulk write results mismatch.");
+
+        status();
+    }
+
+    // Case 7: istreambuf_byte_iterator reads the streambuf in place and consumes exactly what it delivers.
+    {
+        std::cout << "istreambuf_byte_iterator ";
+        std::string expected_bytes;
+        for (auto i = 0; i < 3000; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 256));
+        }
+
+        std::stringstream ss{expected_bytes};
+        std::vector<std::byte> bytewise_bytes(mrt::istreambuf_byte_iterator{ss}, mrt::istreambuf_byte_iterator{});
+
+        ss.clear();
+        ss.seekg(0);
+        std::vector<std::byte> resulting_bytes;
+        mrt::copy_n(mrt::istreambuf_byte_iterator{ss}, 6, std::back_inserter(resulting_bytes));
+        const auto seek_position = ss.tellg();
+        copy(mrt::istreambuf_byte_iterator{ss}, mrt::istreambuf_byte_iterator{}, std::back_inserter(resulting_bytes));
+
+        auto are_equals = std::equal(
+            std::begin(expected_bytes), std::end(expected_bytes),
+            std::begin(resulting_bytes), std::end(resulting_bytes),
+            [](const char& left, const std::byte& right) {
+                return static_cast<unsigned char>(left) == static_cast<unsigned char>(right);
+            }
+        );
+
+        expect(bytewise_bytes == resulting_bytes, "istreambuf_byte_iterator: Byte-wise and bulk reads mismatch.");
+        expect(seek_position == 6, "istreambuf_byte_iterator: Stream position should match the bytes consumed.");
+        expect(are_equals, "istreambuf_byte_iterator: Expected results mismatch.");
+
+        status();
+    }
+
+    // Case 8: mapped_bytes exposes the file as a contiguous range.
+    {
+        std::cout << "mapped_bytes ";
+        const std::vector<std::byte> expected_bytes = get_expected();
+        {
+            std::ofstream file("mapped.testfile", std::ios_base::binary | std::ios_base::trunc);
+            std::copy(std::begin(expected_bytes), std::end(expected_bytes), mrt::ostreambyte_iterator(file));
+        }
+
+        mrt::map_options options;
+        options.advice = mrt::map_advice::sequential;
+        options.will_need = true;
+        const mrt::mapped_bytes mapped("mapped.testfile", options);
+
+        expect(!mapped.failed(), "mapped_bytes: Mapping should succeed.");
+        expect(std::equal(mapped.begin(), mapped.end(), std::begin(expected_bytes), std::end(expected_bytes)), 
+            "mapped_bytes: Expected results mismatch.");
+        expect(mapped.span().size() == MAX_BYTES && mapped[MAX_BYTES - 1] == expected_bytes.back(), 
+            "mapped_bytes: Random access mismatch.");
+        expect(mapped.advise(mrt::map_advice::random, 10, 20), "mapped_bytes: advise should succeed on a sub range.");
+
+        const mrt::mapped_bytes missing("missing.testfile");
+        expect(missing.failed() && missing.empty(), "mapped_bytes: Missing files should fail to map.");
+
+        std::remove("mapped.testfile");
+        status();
+    }
+
+    // Case 9: shared_istreambyte_iterator copies share one runtime sized block.
+    {
+        std::cout << "shared_istreambyte_iterator ";
+        std::string expected_bytes;
+        for (auto i = 0; i < 3000; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 256));
+        }
+
+        std::stringstream ss{expected_bytes};
+        mrt::shared_istreambyte_iterator<> it{ss, 100};
+        mrt::shared_istreambyte_iterator<> copy_of_it = it;
+
+        const auto first = *it++;
+        const auto second = *copy_of_it;
+        mrt::shared_istreambyte_iterator<> from_proxy = copy_of_it++;
+
+        std::vector<std::byte> resulting_bytes{first, second};
+        copy(from_proxy, mrt::shared_istreambyte_iterator<>{}, std::back_inserter(resulting_bytes));
+
+        std::stringstream ss_bytewise{expected_bytes};
+        std::vector<std::byte> bytewise_bytes(mrt::shared_istreambyte_iterator<>{ss_bytewise, 7}, mrt::shared_istreambyte_iterator<>{});
+
+        auto are_equals = std::equal(
+            std::begin(expected_bytes), std::end(expected_bytes),
+            std::begin(resulting_bytes), std::end(resulting_bytes),
+            [](const char& left, const std::byte& right) {
+                return static_cast<unsigned char>(left) == static_cast<unsigned char>(right);
+            }
+        );
+
+        expect(sizeof(it) == sizeof(void*), "shared_istreambyte_iterator: Copies should be pointer sized.");
+        expect(it.block_size() == 100, "shared_istreambyte_iterator: Block size should be the runtime one.");
+        expect(are_equals, "shared_istreambyte_iterator: Copies should advance together.");
+        expect(bytewise_bytes == resulting_bytes, "shared_istreambyte_iterator: Byte-wise and bulk reads mismatch.");
+
+        status();
+    }
+
+    // Case 10: byte_chunks yields blocks, ostreamchunk_iterator writes them back.
+    {
+        std::cout << "byte_chunks / ostreamchunk_iterator ";
+        std::string expected_bytes;
+        for (auto i = 0; i < 3050; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 256));
+        }
+
+        std::stringstream in{expected_bytes};
+        std::stringstream out;
+        std::size_t chunk_count = 0;
+        bool sizes_match = true;
+
+        auto chunks = mrt::byte_chunks(in, 100);
+        for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+            const auto chunk = *it;
+            sizes_match = sizes_match && (chunk.size() == 100 || chunk.size() == 50);
+            ++chunk_count;
+            *mrt::ostreamchunk_iterator{out} = chunk;
+        }
+
+        std::stringstream in_place{expected_bytes};
+        auto window_chunks = mrt::byte_chunks(mrt::istreambuf_byte_iterator{in_place});
+        std::stringstream out_in_place;
+        const auto sink = std::copy(window_chunks.begin(), window_chunks.end(), mrt::ostreamchunk_iterator{out_in_place});
+
+        expect(chunk_count == 31 && sizes_match, "byte_chunks: Expected blocks of the requested size.");
+        expect(out.str() == expected_bytes, "ostreamchunk_iterator: Expected results mismatch.");
+        expect(out_in_place.str() == expected_bytes && !sink.failed(), "byte_chunks: Get area chunks mismatch.");
+
+        status();
+    }
+
+    // Case 11: prefetch_streambuf reads ahead on a background thread.
+    {
+        std::cout << "prefetch_streambuf ";
+        std::string expected_bytes;
+        for (auto i = 0; i < 100'000; ++i) {
+            expected_bytes.push_back(static_cast<char>(i % 251));
+        }
+
+        std::stringstream source{expected_bytes};
+        mrt::prefetch_streambuf prefetch{source, 4096, 3};
+        std::vector<std::byte> resulting_bytes(mrt::istreambyte_iterator<1000>{&prefetch}, mrt::istreambyte_iterator<1000>{});
+
+        std::stringstream chunk_source{expected_bytes};
+        mrt::prefetch_streambuf chunk_prefetch{chunk_source, 4096};
+        std::stringstream out;
+        auto chunks = mrt::byte_chunks(mrt::istreambuf_byte_iterator{&chunk_prefetch});
+        std::copy(chunks.begin(), chunks.end(), mrt::ostreamchunk_iterator{out});
+
+        auto are_equals = std::equal(
+            std::begin(expected_bytes), std::end(expected_bytes),
+            std::begin(resulting_bytes), std::end(resulting_bytes),
+            [](const char& left, const std::byte& right) {
+                return static_cast<unsigned char>(left) == static_cast<unsigned char>(right);
+            }
+        );
+
+        expect(are_equals, "prefetch_streambuf: Expected results mismatch.");
+        expect(out.str() == expected_bytes, "prefetch_streambuf: Chunked results mismatch.");
+
+        std::stringstream empty_source;
+        mrt::prefetch_streambuf empty_prefetch{empty_source};
+        expect(mrt::istreambuf_byte_iterator{&empty_prefetch} == mrt::istreambuf_byte_iterator{}, 
+            "prefetch_streambuf: Empty sources should be at end right away.");
+
+        status();
+    }
+
+    // Case 12: parallel_for_each_chunk / parallel_reduce_chunks over a file.
+    {
+        std::cout << "parallel chunks ";
+        std::vector<std::byte> expected_bytes;
+        for (auto i = 0; i < 100'003; ++i) {
+            expected_bytes.push_back(static_cast<std::byte>(i % 251));
+        }
+        {
+            std::ofstream file("parallel.testfile", std::ios_base::binary | std::ios_base::trunc);
+            mrt::write_bytes(file, expected_bytes);
+        }
+
+        std::atomic<std::size_t> total{0};
+        std::atomic<std::size_t> index_sum{0};
+        const bool mapped = mrt::parallel_for_each_chunk("parallel.testfile", 1000, 
+            [&](std::size_t index, mrt::const_byte_span chunk) {
+                total += chunk.size();
+                index_sum += index;
+            }, 4);
+
+        // Concatenating in order must give the file back: the reduction is ordered.
+        const auto concatenated = mrt::parallel_reduce_chunks("parallel.testfile", 777, std::vector<std::byte>{},
+            [](std::size_t, mrt::const_byte_span chunk) { return std::vector<std::byte>(chunk.begin(), chunk.end()); },
+            [](std::vector<std::byte> all, std::vector<std::byte> part) {
+                all.insert(all.end(), part.begin(), part.end());
+                return all;
+            }, 4);
+
+        std::size_t whole_size = 0;
+        mrt::parallel_for_each_chunk(mrt::const_byte_span{expected_bytes}, ~std::size_t{0}, [&](std::size_t, mrt::const_byte_span chunk) {
+            whole_size += chunk.size();
+        }, 4);
+
+        expect(mapped && total == expected_bytes.size(), "parallel_for_each_chunk: Every byte should be visited once.");
+        expect(whole_size == expected_bytes.size(), "parallel_for_each_chunk: The largest chunk size should give one chunk.");
+        expect(index_sum == 100 * 101 / 2, "parallel_for_each_chunk: Every chunk index should be visited once.");
+        expect(concatenated && *concatenated == expected_bytes, "parallel_reduce_chunks: Reduction should follow chunk order.");
+        expect(!mrt::parallel_reduce_chunks("missing.testfile", 10, 0, 
+            [](std::size_t, mrt::const_byte_span) { return 0; }, std::plus<int>{}), 
+            "parallel_reduce_chunks: Missing files should be reported.");
+
+        std::remove("parallel.testfile");
+        status();
+    }
+
+    // Case 13: find_byte / find_any_of / split_records.
+    {
+        std::cout << "find_byte / split_records ";
+        std::vector<std::byte> haystack(1000, std::byte{'a'});
+        haystack[700] = std::byte{'x'};
+        haystack[900] = std::byte{'y'};
+
+        bool kernels_match = true;
+        for (std::size_t start = 0; start < 64; ++start) {
+            const auto* first = haystack.data() + start;
+            const auto* last = haystack.data() + haystack.size() - start;
+            const std::array<std::byte, 3> needles{std::byte{'y'}, std::byte{'q'}, std::byte{'x'}};
+
+            kernels_match = kernels_match
+                && mrt::find_byte(first, last, std::byte{'x'}) == std::find(first, last, std::byte{'x'})
+                && mrt::find_byte(first, last, std::byte{'z'}) == last
+                && mrt::find_any_of(first, last, needles) == std::find_first_of(first, last, needles.begin(), needles.end());
+        }
+
+        std::string text(reinterpret_cast<const char*>(haystack.data()), haystack.size());
+        std::stringstream ss{text};
+        auto found = mrt::find_byte(mrt::istreambyte_iterator<64>{ss}, mrt::istreambyte_iterator<64>{}, std::byte{'y'});
+        std::vector<std::byte> tail;
+        mrt::copy(found, mrt::istreambyte_iterator<64>{}, std::back_inserter(tail));
+
+        std::stringstream records{"first\nsecond record, longer than a block\n\nlast"};
+        std::vector<std::string> split;
+        for (const auto record : mrt::split_records(mrt::istreambyte_iterator<8>{records}, std::byte{'\n'})) {
+            split.emplace_back(reinterpret_cast<const char*>(record.data()), record.size());
+        }
+
+        const std::vector<std::string> expected_split{"first", "second record, longer than a block", "", "last"};
+
+        // Without a get area the window is one byte; a match at its start must not drop it.
+        unbuffered_streambuf unbuffered_text{"ab,cd"};
+        auto comma = mrt::find_byte(mrt::istreambuf_byte_iterator{&unbuffered_text}, mrt::istreambuf_byte_iterator{}, std::byte{','});
+        const bool comma_found = comma != mrt::istreambuf_byte_iterator{} && *comma == std::byte{','};
+        unbuffered_streambuf lone_comma{","};
+        const bool lone_found = mrt::find_byte(mrt::istreambuf_byte_iterator{&lone_comma}, mrt::istreambuf_byte_iterator{},
+            std::byte{','}) != mrt::istreambuf_byte_iterator{};
+
+        expect(kernels_match, "find_byte: SIMD kernels should agree with std::find.");
+        expect(tail.size() == 100 && tail[0] == std::byte{'y'}, "find_byte: Iterator should stop on the match.");
+        expect(split == expected_split, "split_records: Records mismatch.");
+        expect(comma_found && lone_found, "find_byte: A streambuf without a get area should stop on the match.");
+
+        status();
+    }
+
+    // Case 14: crc32c / xxhash64 / hashing_streambuf.
+    {
+        std::cout << "crc32c / xxhash64 ";
+        const auto digest = [](auto hasher, std::string_view text) {
+            hasher.update({reinterpret_cast<const std::byte*>(text.data()), text.size()});
+            return hasher.value();
+        };
+
+        expect(digest(mrt::crc32c{}, "123456789") == 0xE3069283u, "crc32c: Check value should match.");
+        expect(digest(mrt::crc32c{}, "") == 0u, "crc32c: Empty input should hash to zero.");
+        expect(digest(mrt::xxhash64{}, "") == 0xEF46DB3751D8E999ull, "xxhash64: Empty input should match the reference.");
+        expect(digest(mrt::xxhash64{}, "abc") == 0x44BC2CF5AD770999ull, "xxhash64: Short input should match the reference.");
+        expect(digest(mrt::xxhash64{}, "Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ull,
+            "xxhash64: Input spanning a stripe should match the reference.");
+
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 10'007; ++i) {
+            payload.push_back(static_cast<std::byte>((i * 7) % 256));
+        }
+
+        mrt::crc32c whole_crc;
+        mrt::xxhash64 whole_xxh;
+        whole_crc.update(payload);
+        whole_xxh.update(payload);
+
+        // Any split of the input must give the one-shot digest.
+        mrt::crc32c split_crc;
+        mrt::xxhash64 split_xxh;
+        for (std::size_t offset = 0, step = 1; offset < payload.size(); offset += step, step = step * 3 % 97 + 1) {
+            const auto part = mrt::const_byte_span{payload}.subspan(offset, std::min(step, payload.size() - offset));
+            split_crc.update(part);
+            split_xxh.update(part);
+        }
+
+        expect(split_crc.value() == whole_crc.value(), "crc32c: Streaming updates should match a single update.");
+        expect(split_xxh.value() == whole_xxh.value(), "xxhash64: Streaming updates should match a single update.");
+
+        // Write path: the digest is computed as the iterator commits its blocks.
+        std::stringstream ss;
+        mrt::hashing_streambuf<mrt::crc32c> write_hash{ss.rdbuf()};
+        std::copy(payload.begin(), payload.end(), mrt::ostreambyte_iterator<128>{&write_hash});
+
+        // Read path, through both the block reads and the get area.
+        mrt::hashing_streambuf<mrt::xxhash64> read_hash{ss};
+        std::vector<std::byte> read_back;
+        mrt::copy(mrt::istreambyte_iterator<100>{&read_hash}, mrt::istreambyte_iterator<100>{}, std::back_inserter(read_back));
+
+        std::stringstream again{ss.str()};
+        mrt::hashing_streambuf<mrt::crc32c> get_area_hash{again, mrt::crc32c{}, 333};
+        const auto area_crc = mrt::hash_bytes(mrt::istreambuf_byte_iterator{&get_area_hash}, mrt::istreambuf_byte_iterator{}, mrt::crc32c{});
+
+        expect(write_hash.value() == whole_crc.value(), "hashing_streambuf: Written bytes should be hashed once each.");
+        expect(read_back == payload && read_hash.value() == whole_xxh.value(), "hashing_streambuf: Read bytes should be hashed once each.");
+        expect(get_area_hash.value() == whole_crc.value() && area_crc.value() == whole_crc.value(),
+            "hash_bytes: Hashing blocks in place should match the stream digest.");
+        status();
+    }
+
+    // Case 15: compress_streambuf / decompress_streambuf.
+    {
+        std::cout << "compress_streambuf ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 5'000; ++i) {
+            payload.push_back(static_cast<std::byte>(i % 253));
+        }
+
+        std::stringstream ss;
+        std::size_t encode_calls = 0;
+        {
+            mrt::compress_streambuf<length_prefix_encoder> packed{ss};
+            {
+                mrt::ostreambyte_iterator<32> out{&packed};
+                std::copy(payload.begin(), payload.begin() + 1000, out);
+                // A large write skips the staging buffer.
+                out = mrt::const_byte_span{payload}.subspan(1000);
+            }
+            expect(packed.finish() && !packed.failed(), "compress_streambuf: finish() should succeed.");
+            encode_calls = packed.encoder().calls;
+        }
+
+        mrt::decompress_streambuf<length_prefix_decoder> unpacked{ss};
+        std::vector<std::byte> read_back;
+        mrt::copy(mrt::istreambyte_iterator<1000>{&unpacked}, mrt::istreambyte_iterator<1000>{}, std::back_inserter(read_back));
+
+        std::string packed_bytes = ss.str();
+        std::stringstream truncated{packed_bytes.substr(0, packed_bytes.size() - 10)};
+        mrt::decompress_streambuf<length_prefix_decoder> cut{truncated};
+        std::vector<std::byte> partial;
+        std::copy(mrt::istreambuf_byte_iterator{&cut}, mrt::istreambuf_byte_iterator{}, std::back_inserter(partial));
+
+        expect(read_back == payload && !unpacked.failed(), "decompress_streambuf: Round trip should give the payload back.");
+        expect(encode_calls < 20, "compress_streambuf: Writes should reach the encoder in blocks.");
+        expect(cut.failed() && partial.size() < payload.size(), "decompress_streambuf: A truncated stream should be reported.");
+        status();
+    }
+
+    // Case 16: binary_reader / binary_writer.
+    {
+        std::cout << "binary_reader / binary_writer ";
+        enum class tag : std::uint16_t { header = 0x0102 };
+        const std::vector<std::uint64_t> varints{0, 1, 127, 128, 300, 16'383, 16'384, 1ull << 35, 1ull << 56, ~0ull};
+        std::vector<std::uint32_t> words(1'000);
+        std::iota(words.begin(), words.end(), 0xA0B0C0D0u);
+        std::vector<double> reals{0.5, -2.25, 1e300};
+
+        std::stringstream ss;
+        {
+            mrt::binary_writer<64> writer{ss};
+            writer.write(std::uint32_t{0x11223344u});
+            writer.write(std::uint32_t{0x11223344u}, mrt::byte_order::big);
+            writer.write(tag::header, mrt::byte_order::big);
+            writer.write(std::int8_t{-5});
+            writer.write(-1.5f, mrt::byte_order::big);
+            writer.write_array(words.data(), words.size(), mrt::byte_order::big);
+            writer.write_array(reals.data(), reals.size());
+            // Enough varints to straddle several reader blocks.
+            for (int round = 0; round < 50; ++round) {
+                for (const auto value : varints) {
+                    writer.write_varint(value);
+                }
+            }
+            writer.write_zigzag(-3);
+            writer.write_zigzag(std::int64_t{1} << 40);
+            expect(!writer.failed(), "binary_writer: Writes should succeed.");
+            expect(writer.flush() && !writer.failed(), "binary_writer: Flushing should succeed.");
+        }
+
+        // The last partial block only reaches the sink on flush(), which is where its failure shows.
+        struct refusing_sink : std::streambuf { } refusing;
+        {
+            mrt::binary_writer<64> writer{&refusing};
+            writer.write(std::uint32_t{1});
+            const bool held = !writer.failed();
+            expect(held && !writer.flush() && writer.failed(), "binary_writer: A failing sink should show through flush().");
+        }
+
+        const std::string encoded = ss.str();
+        expect(encoded.compare(0, 8, "\x44\x33\x22\x11\x11\x22\x33\x44") == 0, "binary_writer: Byte order should be honoured.");
+
+        mrt::binary_reader reader{mrt::istreambyte_iterator<37>{ss}};
+        const auto le = reader.read<std::uint32_t>();
+        const auto be = reader.read<std::uint32_t>(mrt::byte_order::big);
+        const auto header = reader.read<tag>(mrt::byte_order::big);
+        const auto small = reader.read<std::int8_t>();
+        const auto real = reader.read<float>(mrt::byte_order::big);
+
+        std::vector<std::uint32_t> words_back(words.size());
+        std::vector<double> reals_back(reals.size());
+        const auto words_read = reader.read_array(words_back.data(), words_back.size(), mrt::byte_order::big);
+        reader.read_array(reals_back.data(), reals_back.size());
+
+        std::vector<std::uint64_t> expected_varints;
+        for (int round = 0; round < 50; ++round) {
+            expected_varints.insert(expected_varints.end(), varints.begin(), varints.end());
+        }
+        std::vector<std::uint64_t> varints_back(expected_varints.size());
+        const auto first_varint = reader.read_varint();
+        const auto varints_read = reader.read_varints(varints_back.data() + 1, varints_back.size() - 1);
+        varints_back[0] = first_varint;
+
+        const auto negative = reader.read_zigzag();
+        const auto positive = reader.read_zigzag();
+
+        expect(le == 0x11223344u && be == 0x11223344u && header == tag::header && small == -5 && real == -1.5f,
+            "binary_reader: Scalars should round trip in either byte order.");
+        expect(words_read == words.size() && words_back == words && reals_back == reals,
+            "binary_reader: Arrays should round trip in either byte order.");
+        expect(varints_read == expected_varints.size() - 1 && varints_back == expected_varints,
+            "binary_reader: Batched varints should match the single value decoder.");
+        expect(negative == -3 && positive == std::int64_t{1} << 40, "binary_reader: Zigzag values should round trip.");
+        expect(!reader.failed() && reader.at_end(), "binary_reader: The whole payload should be consumed.");
+
+        (void)reader.read<std::uint64_t>();
+        std::stringstream overlong{std::string(11, '\xFF')};
+        mrt::binary_reader bad{mrt::istreambuf_byte_iterator{overlong}};
+        (void)bad.read_varint();
+
+        // Near the end read_varints takes the checked path, one byte window at a time.
+        unbuffered_streambuf unbuffered_varints{std::string("\x01\xAC\x02\x7F", 4)};
+        mrt::binary_reader slow{mrt::istreambuf_byte_iterator{&unbuffered_varints}};
+        std::array<std::uint64_t, 3> slow_back{};
+        const auto slow_read = slow.read_varints(slow_back.data(), slow_back.size());
+
+        expect(reader.failed() && bad.failed(), "binary_reader: Short or overlong input should be reported.");
+        expect(slow_read == 3 && slow_back[0] == 1 && slow_back[1] == 300 && slow_back[2] == 127 && !slow.failed(),
+            "binary_reader: Varints should decode from a streambuf without a get area.");
+        status();
+    }
+
+    // Case 17: fd_bytebuf.
+    {
+        std::cout << "fd_bytebuf ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 200'000; ++i) {
+            payload.push_back(static_cast<std::byte>((i * 13) % 256));
+        }
+
+        {
+            mrt::fd_bytebuf file{"fd.testfile", std::ios_base::out, 4096};
+            {
+                mrt::ostreambyte_iterator<100> out{&file};
+                std::copy(payload.begin(), payload.begin() + 5'000, out);
+                // Large blocks go straight to write().
+                out = mrt::const_byte_span{payload}.subspan(5'000);
+            }
+            expect(file.close() && !file.failed(), "fd_bytebuf: Writing should succeed.");
+        }
+
+        mrt::fd_bytebuf file{"fd.testfile", std::ios_base::in, 4096};
+        std::vector<std::byte> read_back;
+        mrt::copy(mrt::istreambyte_iterator<1 << 16>{&file}, mrt::istreambyte_iterator<1 << 16>{}, std::back_inserter(read_back));
+
+        std::array<std::byte, 16> middle{};
+        const auto got = file.read_at(100'000, middle);
+
+        // Mixed reads and writes keep the descriptor position in step with the stream position.
+        mrt::fd_bytebuf update{"fd.testfile", std::ios_base::in | std::ios_base::out, 64};
+        std::istream reader{&update};
+        char first_bytes[10];
+        reader.read(first_bytes, 10);
+        update.sputn("\x01\x02\x03", 3);
+        update.pubsync();
+        std::array<std::byte, 4> patched{};
+        update.read_at(9, patched);
+
+        mrt::fd_bytebuf missing{"missing.testfile"};
+
+        expect(read_back == payload && !file.failed(), "fd_bytebuf: Reading should give the file back.");
+        expect(got == middle.size() && std::equal(middle.begin(), middle.end(), payload.begin() + 100'000),
+            "fd_bytebuf: read_at should read at the given offset.");
+        expect(patched[0] == payload[9] && patched[1] == std::byte{1} && patched[3] == std::byte{3},
+            "fd_bytebuf: Writes after reads should land at the stream position.");
+        expect(!missing.is_open() && missing.failed(), "fd_bytebuf: Missing files should be reported.");
+
+        std::remove("fd.testfile");
+        status();
+    }
+
+    // Case 18: fd_bytebuf direct I/O.
+    {
+        std::cout << "fd_bytebuf direct ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 300'001; ++i) {
+            payload.push_back(static_cast<std::byte>((i * 7) % 251));
+        }
+
+        bool direct = false;
+        {
+            mrt::fd_bytebuf file{"direct.testfile", std::ios_base::out, 10'000, mrt::fd_caching::direct};
+            direct = file.caching() == mrt::fd_caching::direct;
+            {
+                mrt::ostreambyte_iterator<100> out{&file};
+                std::copy(payload.begin(), payload.begin() + 777, out);
+            }
+            // Unaligned memory and an unaligned tail still end up in the file.
+            file.sputn(reinterpret_cast<const char*>(payload.data()) + 777, 200'000);
+            file.pubsync();
+            file.sputn(reinterpret_cast<const char*>(payload.data()) + 200'777, static_cast<std::streamsize>(payload.size() - 200'777));
+            expect(file.close() && !file.failed(), "fd_bytebuf direct: Writing should succeed.");
+        }
+
+        {
+            mrt::fd_bytebuf file{"direct.testfile", std::ios_base::app, 4096, mrt::fd_caching::direct};
+            file.sputn("tail", 4);
+            expect(file.close() && !file.failed(), "fd_bytebuf direct: Appending should succeed.");
+        }
+        payload.insert(payload.end(), {std::byte{'t'}, std::byte{'a'}, std::byte{'i'}, std::byte{'l'}});
+
+        mrt::fd_bytebuf file{"direct.testfile", std::ios_base::in, 1 << 16, mrt::fd_caching::direct};
+        std::vector<std::byte> read_back;
+        mrt::copy(mrt::istreambyte_iterator<4096>{&file}, mrt::istreambyte_iterator<4096>{}, std::back_inserter(read_back));
+
+        // Unaligned positions are read from the block that holds them.
+        std::istream seeker{&file};
+        seeker.clear();
+        seeker.seekg(123'457);
+        std::array<char, 8> middle{};
+        seeker.read(middle.data(), middle.size());
+
+        expect(!direct || mrt::fd_bytebuf{"direct.testfile"}.caching() == mrt::fd_caching::cached, "fd_bytebuf direct: Opening should report the caching mode.");
+        expect(read_back == payload && !file.failed(), "fd_bytebuf direct: Reading should give the file back.");
+        expect(std::equal(middle.begin(), middle.end(), reinterpret_cast<const char*>(payload.data()) + 123'457),
+            "fd_bytebuf direct: Seeking to unaligned positions should read the right bytes.");
+
+        std::remove("direct.testfile");
+        status();
+    }
+
+    // Case 19: fd_bytebuf adaptive buffer size.
+    {
+        std::cout << "fd_bytebuf adaptive ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 2'000'000; ++i) {
+            payload.push_back(static_cast<std::byte>((i * 5) % 253));
+        }
+
+        {
+            mrt::fd_bytebuf file{"adaptive.testfile", std::ios_base::out};
+            mrt::write_bytes(&file, payload);
+        }
+
+        mrt::fd_bytebuf file{"adaptive.testfile", std::ios_base::in | std::ios_base::out, mrt::fd_bytebuf::adaptive_buffer_size};
+        const auto initial = file.buffer_size();
+        // Reads in place from the buffer, so every refill goes through it.
+        std::vector<std::byte> read_back(mrt::istreambuf_byte_iterator{&file}, mrt::istreambuf_byte_iterator{});
+        const auto grown = file.buffer_size();
+
+        file.pubseekpos(0);
+        for (auto i = 0; i < 16; ++i) {
+            file.sputn("0123456789", 10);
+            file.pubsync();
+        }
+        const auto shrunk = file.buffer_size();
+
+        expect(initial >= mrt::fd_bytebuf::min_adaptive_buffer_size, "fd_bytebuf adaptive: The first size should come from the file system.");
+        expect(read_back == payload && !file.failed(), "fd_bytebuf adaptive: Reading should give the file back.");
+        expect(grown > initial && grown <= mrt::fd_bytebuf::max_adaptive_buffer_size, "fd_bytebuf adaptive: Sequential reads should grow the buffer.");
+        expect(shrunk < grown, "fd_bytebuf adaptive: Small flushes should shrink the buffer.");
+
+        file.close();
+        std::remove("adaptive.testfile");
+        status();
+    }
+
+    // Case 20: source / sink policies.
+    {
+        std::cout << "source / sink policies ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 3'000; ++i) {
+            payload.push_back(static_cast<std::byte>(i % 211));
+        }
+
+        // Memory: a plain pointer walk with the block iterator interface.
+        std::vector<std::byte> walked;
+        std::copy(mrt::span_byte_iterator{payload}, mrt::span_byte_iterator{}, std::back_inserter(walked));
+        std::vector<std::byte> bulk;
+        mrt::copy(mrt::span_byte_iterator{payload}, mrt::span_byte_iterator{}, std::back_inserter(bulk));
+        const auto found = mrt::find_byte(mrt::span_byte_iterator{payload}, mrt::span_byte_iterator{}, std::byte{210});
+        mrt::binary_reader reader{mrt::span_byte_iterator{payload}};
+        (void)reader.read<std::uint16_t>();
+
+        std::vector<std::byte> target(payload.size());
+        auto stored = mrt::copy(payload.begin(), payload.end(), mrt::span_byte_writer{target});
+        std::array<std::byte, 4> small{};
+        mrt::span_byte_writer overflow{small};
+        overflow = mrt::const_byte_span{payload}.first(5);
+
+        expect(walked == payload && bulk == payload, "span_byte_iterator: Walking memory should yield every byte.");
+        expect(found != mrt::span_byte_iterator{} && *found == std::byte{210} && found.buffered().size() == payload.size() - 210,
+            "span_byte_iterator: Block algorithms should work in place.");
+        expect(reader.read<std::byte>() == payload[2], "span_byte_iterator: binary_reader should read memory in place.");
+        expect(target == payload && stored.position() == target.data() + target.size() && !stored.failed(),
+            "span_byte_writer: Bytes should be stored in place.");
+        expect(overflow.failed() && small[3] == payload[3], "span_byte_writer: Writing past the end should fail.");
+
+        // Descriptors: read / write per block with no streambuf.
+        {
+            mrt::fd_bytebuf file{"policy.testfile", std::ios_base::out};
+            mrt::ostreambyte_iterator<256, mrt::fd_sink> out{mrt::fd_sink{file.native_handle()}};
+            std::copy(payload.begin(), payload.end(), out);
+        }
+
+        mrt::fd_bytebuf file{"policy.testfile"};
+        using fd_iterator = mrt::istreambyte_iterator<256, mrt::fd_source>;
+        std::vector<std::byte> from_fd;
+        std::copy(fd_iterator{mrt::fd_source{file.native_handle()}}, fd_iterator{}, std::back_inserter(from_fd));
+        expect(from_fd == payload, "fd_source / fd_sink: Blocks should round trip through the descriptor.");
+
+        std::remove("policy.testfile");
+        status();
+    }
+
+    // Case 21: ranges / default_sentinel.
+    {
+        std::cout << "ranges ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 1'000; ++i) {
+            payload.push_back(static_cast<std::byte>(i % 7));
+        }
+
+        // Distances no longer overflow a char.
+        std::stringstream ss{std::string(reinterpret_cast<const char*>(payload.data()), payload.size())};
+        const auto distance = std::distance(mrt::istreambyte_iterator<64>{ss}, mrt::istreambyte_iterator<64>{});
+        expect(distance == 1'000, "istreambyte_iterator: difference_type should hold stream sized distances.");
+
+#ifdef __cpp_lib_ranges
+        ss.clear();
+        ss.seekg(0);
+        std::vector<std::byte> copied;
+        std::ranges::copy(mrt::views::bytes<32>(ss), std::back_inserter(copied));
+        const auto ones = std::ranges::count(mrt::views::bytes(mrt::span_byte_iterator{payload}), std::byte{1});
+
+        std::size_t chunked = 0;
+        std::stringstream chunk_source{std::string(reinterpret_cast<const char*>(payload.data()), payload.size())};
+        auto chunks = mrt::byte_chunks(chunk_source, 300);
+        for (auto it = chunks.begin(); it != std::default_sentinel; ++it) {
+            chunked += (*it).size();
+        }
+
+        std::stringstream sink;
+        std::ranges::copy(payload, mrt::ostreambyte_iterator<16>{sink});
+
+        expect(copied == payload, "views::bytes: std::ranges::copy should read the whole stream.");
+        expect(ones == 143, "views::bytes: Range algorithms should accept block iterators with default_sentinel.");
+        expect(chunked == payload.size(), "byte_chunks: Chunk iterators should compare to default_sentinel.");
+        expect(sink.str().size() == payload.size(), "ostreambyte_iterator: Should model std::output_iterator.");
+#endif
+        status();
+    }
+
+    // Case 22: instrumented_source / instrumented_sink.
+    {
+        std::cout << "io_stats ";
+        std::string payload(10'000, 'x');
+        std::stringstream ss{payload};
+
+        mrt::io_stats read_stats;
+        std::vector<std::byte> read_back;
+        using counted_iterator = mrt::instrumented_istreambyte_iterator<4096>;
+        mrt::copy(counted_iterator{mrt::instrumented_source<>{mrt::streambuf_source{ss.rdbuf()}, read_stats}}, counted_iterator{},
+            std::back_inserter(read_back));
+
+        mrt::io_stats write_stats;
+        std::stringstream out;
+        {
+            mrt::instrumented_ostreambyte_iterator<100> it{mrt::instrumented_sink<>{mrt::streambuf_sink{out.rdbuf()}, write_stats}};
+            for (auto i = 0; i < 1'050; ++i) {
+                *it++ = std::byte{'y'};
+            }
+        }
+
+        const auto reads = read_stats.snapshot();
+        const auto writes = write_stats.snapshot();
+        std::uint64_t latency_samples = 0;
+        read_stats.latency().for_each_bucket([&](std::uint64_t, std::uint64_t n) { latency_samples += n; });
+        std::uint64_t exported = 0;
+        write_stats.export_to([&](std::string_view name, std::uint64_t value) {
+            exported += name == "bytes" ? value : 0;
+        });
+
+        expect(read_back.size() == payload.size() && reads.bytes == payload.size(), "io_stats: Reads should count the bytes moved.");
+        expect(reads.short_calls == 1 && reads.fill_ratio() > 0.0 && reads.fill_ratio() <= 1.0,
+            "io_stats: Only the end of the data should be a short read.");
+        expect(latency_samples == reads.calls && read_stats.latency().percentile(0.5) > 0, "io_stats: Every call should be timed.");
+        expect(writes.calls == 11 && writes.short_calls == 0 && exported == 1'050, "io_stats: Every commit should be counted and exported.");
+        status();
+    }
+
+    // Case 23: ostreambyte_iterator flush policies, copies and moves.
+    {
+        std::cout << "flush policies ";
+        const std::string text = "abc\ndef";
+        const auto bytes = [&text](std::size_t first, std::size_t count) {
+            return mrt::const_byte_span{reinterpret_cast<const std::byte*>(text.data()) + first, count};
+        };
+
+        std::stringstream threshold_out;
+        std::stringstream delimiter_out;
+        std::stringstream age_out;
+        std::stringstream explicit_out;
+        std::size_t threshold_seen = 0;
+        std::size_t age_before = 0;
+        {
+            mrt::ostreambyte_iterator<64, mrt::streambuf_sink, mrt::flush_at_threshold> threshold{threshold_out, mrt::flush_at_threshold{4}};
+            for (char c : text) {
+                *threshold++ = static_cast<std::byte>(c);
+            }
+            threshold_seen = threshold_out.str().size();
+
+            mrt::ostreambyte_iterator delimiter{delimiter_out, mrt::flush_any{mrt::flush_at_threshold{100}, mrt::flush_on_delimiter{}}};
+            delimiter = bytes(0, 3);
+            const bool held = delimiter_out.str().empty();
+            *delimiter++ = std::byte{'\n'};
+            expect(held && delimiter_out.str() == "abc\n", "flush_on_delimiter: A write with the delimiter should commit.");
+
+            mrt::ostreambyte_iterator<4096, mrt::streambuf_sink, mrt::flush_after<test_clock>> age{age_out,
+                mrt::flush_after<test_clock>{std::chrono::milliseconds{1}}};
+            for (auto i = 0; i < 200; ++i) {
+                *age++ = std::byte{'a'};
+            }
+            age_before = age_out.str().size();
+            test_clock::current += std::chrono::milliseconds{2};
+            for (auto i = 0; i < 64; ++i) {
+                *age++ = std::byte{'b'};
+            }
+
+            mrt::ostreambyte_iterator<64> explicit_flush{explicit_out};
+            explicit_flush = bytes(0, 3);
+            expect(explicit_out.str().empty() && explicit_flush.flush() && explicit_out.str() == "abc",
+                "ostreambyte_iterator: flush() should commit what is pending.");
+        }
+
+        // Copies and moves share the pending block instead of committing it.
+        std::stringstream copied_out;
+        {
+            mrt::ostreambyte_iterator<64> original{copied_out};
+            original = bytes(0, 3);
+            {
+                auto copy = original;
+                expect(copied_out.str().empty(), "ostreambyte_iterator: Copying should not flush.");
+                auto moved = std::move(copy);
+                moved = bytes(3, 4);
+                original = moved;
+                expect(copied_out.str().empty(), "ostreambyte_iterator: Moving and assigning should not flush.");
+            }
+            expect(copied_out.str().empty(), "ostreambyte_iterator: Only the last copy should commit.");
+        }
+
+        // Bytes written before a copy stay ahead of the ones written after it.
+        std::stringstream ordered_out;
+        {
+            mrt::ostreambyte_iterator<64> it{ordered_out};
+            *it = std::byte{'a'};
+            {
+                auto saved = it;
+                *it = std::byte{'b'};
+                it.flush();
+                expect(ordered_out.str() == "ab", "ostreambyte_iterator: Bytes should keep their order across a copy.");
+                *saved = std::byte{'c'};
+                *it = std::byte{'d'};
+            }
+        }
+
+        // The policy lives with the block, so a copy starting it starts the clock for all of them.
+        std::stringstream shared_age_out;
+        std::size_t shared_age_seen = 0;
+        {
+            mrt::ostreambyte_iterator<4096, mrt::streambuf_sink, mrt::flush_after<test_clock>> it{shared_age_out,
+                mrt::flush_after<test_clock>{std::chrono::milliseconds{1}}};
+            {
+                auto first_writer = it;
+                *first_writer = std::byte{'x'};
+            }
+            for (auto i = 0; i < 100; ++i) {
+                *it++ = std::byte{'y'};
+            }
+            shared_age_seen = shared_age_out.str().size();
+        }
+
+        // Assignment takes the failure state of its source, plus that of committing the dropped block.
+        struct refusing_sink : std::streambuf { } refusing;
+        std::stringstream healthy_out;
+        bool cleared = false;
+        bool reported = false;
+        {
+            mrt::ostreambyte_iterator<64> healthy{healthy_out};
+            mrt::ostreambyte_iterator<64> broken{&refusing};
+            *broken = std::byte{'x'};
+            const bool broke = !broken.flush() && broken.failed();
+            broken = healthy;
+            cleared = broke && !broken.failed();
+
+            mrt::ostreambyte_iterator<64> pending{&refusing};
+            *pending = std::byte{'y'};
+            pending = healthy;
+            reported = pending.failed();
+        }
+
+        expect(threshold_seen == 4 && threshold_out.str() == text, "flush_at_threshold: Commits should follow the threshold.");
+        expect(shared_age_seen == 0 && shared_age_out.str().size() == 101,
+            "flush_after: Copies should share the policy's clock.");
+        expect(cleared, "ostreambyte_iterator: Assigning from a healthy iterator should clear an earlier failure.");
+        expect(reported, "ostreambyte_iterator: A failed commit of the dropped block should be reported.");
+        expect(age_before == 0 && age_out.str().size() == 264, "flush_after: Old bytes should be committed on the next write.");
+        expect(copied_out.str() == text, "ostreambyte_iterator: Pending bytes should follow the copies.");
+        expect(ordered_out.str() == "abcd", "ostreambyte_iterator: Copies writing in turn should not reorder the output.");
+        status();
+    }
+
+    // Case 24: async_byte_writer drains on its own thread under every backpressure mode.
+    {
+        std::cout << "async_byte_writer ";
+        std::string payload;
+        for (auto i = 0; i < 100000; ++i) {
+            payload.push_back(static_cast<char>('a' + i % 26));
+        }
+        const auto bytes = [&payload](std::size_t first, std::size_t count) {
+            return mrt::const_byte_span{reinterpret_cast<const std::byte*>(payload.data()) + first, count};
+        };
+
+        std::stringstream blocking_out;
+        std::stringstream dropping_out;
+        std::stringstream growing_out;
+        std::stringstream shared_out;
+        std::uint64_t dropped = 0;
+        bool blocking_flushed = false;
+        {
+            // Much more than the ring holds, so the producer has to wait for the I/O thread.
+            mrt::async_byte_writer blocking{blocking_out, 256};
+            mrt::ostreambyte_iterator<1000> it{&blocking};
+            for (char c : payload) {
+                *it++ = static_cast<std::byte>(c);
+            }
+            blocking_flushed = it.flush() && blocking.flush() && blocking_out.str() == payload;
+
+            mrt::async_byte_writer dropping{dropping_out, 16, mrt::backpressure::drop};
+            expect(dropping.write(bytes(0, 32)), "async_byte_writer: Dropping is not a failure.");
+            dropping.write(bytes(0, 8));
+            dropping.flush();
+            dropped = dropping.dropped();
+
+            mrt::async_byte_writer growing{growing_out, 64, mrt::backpressure::grow};
+            for (std::size_t first = 0; first < payload.size(); first += 1000) {
+                growing.write(bytes(first, 1000));
+            }
+
+            mrt::async_byte_writer shared{shared_out, 64, mrt::backpressure::block, true};
+            const auto produce = [&shared](char c) {
+                const std::string record(10, c);
+                for (auto i = 0; i < 500; ++i) {
+                    shared.write(mrt::const_byte_span{reinterpret_cast<const std::byte*>(record.data()), record.size()});
+                }
+            };
+            std::thread first{produce, 'x'};
+            std::thread second{produce, 'y'};
+            first.join();
+            second.join();
+        }
+
+        bool records_intact = shared_out.str().size() == 10000;
+        for (std::size_t i = 0; records_intact && i < shared_out.str().size(); i += 10) {
+            records_intact = shared_out.str().substr(i, 10) == std::string(10, shared_out.str()[i]);
+        }
+
+        // A slow sink and a producer that keeps the ring busy: flush() only waits for what came before it.
+        struct slow_sink : std::streambuf {
+            std::mutex mutex;
+            std::string received;
+
+            std::streamsize xsputn(const char* s, std::streamsize count) override {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock{mutex};
+                received.append(s, static_cast<std::size_t>(count));
+                return count;
+            }
+        };
+        slow_sink slow;
+        std::atomic<bool> producer_stop{false};
+        std::atomic<bool> producer_done{false};
+        bool flushed_while_busy = false;
+        {
+            mrt::async_byte_writer busy{&slow, 1 << 16, mrt::backpressure::block, true};
+            // Writes a little during every sputn, so the I/O thread never finds the ring empty;
+            // the time limit only bounds how long a starved flush() would hang.
+            std::thread producer{[&]() {
+                const auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+                while (!producer_stop && std::chrono::steady_clock::now() < limit) {
+                    busy.write(bytes(0, 10));
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                producer_done = true;
+            }};
+            const auto received = [&slow]() {
+                std::lock_guard<std::mutex> lock{slow.mutex};
+                return slow.received;
+            };
+            while (received().empty()) {
+                std::this_thread::yield();
+            }
+
+            const std::string marker = "<flush>";
+            busy.write(mrt::const_byte_span{reinterpret_cast<const std::byte*>(marker.data()), marker.size()});
+            const bool flushed = busy.flush();
+            const bool still_running = !producer_done;
+            flushed_while_busy = flushed && still_running && received().find(marker) != std::string::npos;
+            producer_stop = true;
+            producer.join();
+        }
+
+        std::stringbuf read_only{std::ios_base::in};
+        mrt::async_byte_writer failing{&read_only, 64};
+        failing.write(bytes(0, 10));
+        const bool reported = !failing.flush() && failing.failed() && !failing.write(bytes(0, 10));
+
+        expect(blocking_flushed, "async_byte_writer: Blocking writes should all reach the sink.");
+        expect(dropped == 32 && dropping_out.str() == payload.substr(0, 8), "async_byte_writer: Only writes that do not fit should be dropped.");
+        expect(growing_out.str() == payload, "async_byte_writer: Grown writes should keep their order.");
+        expect(records_intact, "async_byte_writer: Writes from several producers should not interleave.");
+        expect(flushed_while_busy, "async_byte_writer: A steady producer should not hold flush() up.");
+        expect(reported, "async_byte_writer: A failing sink should be reported.");
+        status();
+    }
+
+    // Case 25: seekable_bytes random access through a small block cache.
+    {
+        std::cout << "seekable_bytes ";
+        std::vector<std::uint32_t> keys;
+        for (std::uint32_t i = 0; i < 100'000; ++i) {
+            keys.push_back(i * 3);
+        }
+
+        std::stringstream index{std::string(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(std::uint32_t))};
+        mrt::seekable_bytes file{index, 4096, 4};
+        auto records = file.records<std::uint32_t>();
+
+        bool found = true;
+        for (std::uint32_t key : {0u, 3u, 150'000u, 299'997u}) {
+            const auto it = std::lower_bound(records.begin(), records.end(), key);
+            found = found && it != records.end() && *it == key && it.offset() == key / 3 * sizeof(std::uint32_t);
+        }
+        const auto missing = std::lower_bound(records.begin(), records.end(), 7u);
+        const auto past = std::lower_bound(records.begin(), records.end(), 300'000u);
+        const auto misses = file.cache_misses();
+
+        // Raw bytes, backwards and across block boundaries.
+        const auto& raw = index.str();
+        auto last = file.end();
+        --last;
+        std::array<std::byte, 6> straddling{};
+        const auto copied = file.read(4093, straddling);
+
+        expect(file.size() == raw.size() && records.size() == keys.size() && file.end() - file.begin() == static_cast<std::ptrdiff_t>(raw.size()),
+            "seekable_bytes: Sizes should match the stream.");
+        expect(found && *missing == 9 && past == records.end(), "seekable_bytes: lower_bound should work over records.");
+        expect(misses < 4 * 17, "seekable_bytes: Binary searches should only read a few blocks.");
+        expect(*last == static_cast<std::byte>(raw.back()) && file.begin()[5000] == static_cast<std::byte>(raw[5000])
+            && (file.begin() + 4095)[1] == static_cast<std::byte>(raw[4096]), "seekable_bytes: Offsets should reach the right bytes.");
+        expect(copied == 6 && std::memcmp(straddling.data(), raw.data() + 4093, 6) == 0 && file.read(raw.size(), straddling) == 0,
+            "seekable_bytes: read should cross blocks and stop at the end.");
+        expect(!file.failed(), "seekable_bytes: A seekable stream should not fail.");
+
+        std::stringstream source{"abc"};
+        mrt::prefetch_streambuf unseekable{source};
+        mrt::seekable_bytes cannot{&unseekable};
+        expect(cannot.failed() && cannot.empty(), "seekable_bytes: Streams that cannot seek should be reported.");
+
+#ifdef __cpp_lib_ranges
+        static_assert(std::random_access_iterator<mrt::seekable_bytes::iterator>);
+        expect(std::ranges::count(file, static_cast<std::byte>(raw[0])) == std::count(raw.begin(), raw.end(), raw[0]),
+            "seekable_bytes: Should be a std::ranges::random_access_range.");
+#endif
+        status();
+    }
+
+    // Case 26: gather_writer coalesces small pieces and passes large ones to writev.
+    {
+        std::cout << "gather_writer ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 5'000; ++i) {
+            payload.push_back(static_cast<std::byte>((i * 7) % 256));
+        }
+        const mrt::const_byte_span big{payload};
+        const auto text = [](const char* s) {
+            return mrt::const_byte_span{reinterpret_cast<const std::byte*>(s), std::strlen(s)};
+        };
+
+        std::vector<std::byte> expected = {std::byte{'>'}};
+        const auto append = [&expected](mrt::const_byte_span piece) {
+            expected.insert(expected.end(), piece.begin(), piece.end());
+        };
+
+        std::uint64_t large_calls = 0;
+        std::uint64_t small_calls = 0;
+        std::uint64_t many_calls = 0;
+        {
+            mrt::fd_bytebuf file{"gather.testfile", std::ios_base::out, 4096};
+            file.sputc('>');
+            mrt::gather_writer writer{file, 4096};
+
+            for (auto i = 0; i < 10; ++i) {
+                writer.write({text("head"), big, text("tail")});
+                append(text("head"));
+                append(big);
+                append(text("tail"));
+            }
+            large_calls = writer.system_calls();
+
+            for (auto i = 0; i < 100; ++i) {
+                writer.write({text("h"), text("small payload"), text("t")});
+                append(text("h"));
+                append(text("small payload"));
+                append(text("t"));
+            }
+            writer.flush();
+            small_calls = writer.system_calls() - large_calls;
+
+            // More pieces than one writev takes.
+            std::vector<mrt::const_byte_span> pieces;
+            for (auto i = 0; i < 100; ++i) {
+                pieces.push_back(text("#"));
+                pieces.push_back(big.subspan(0, 2'000));
+                append(text("#"));
+                append(big.subspan(0, 2'000));
+            }
+            writer.write(pieces.begin(), pieces.end());
+            many_calls = writer.system_calls() - large_calls - small_calls;
+            expect(!writer.failed(), "gather_writer: Writing should succeed.");
+        }
+
+        mrt::fd_bytebuf file{"gather.testfile", std::ios_base::in};
+        std::vector<std::byte> read_back;
+        mrt::copy(mrt::istreambyte_iterator<4096>{&file}, mrt::istreambyte_iterator<4096>{}, std::back_inserter(read_back));
+        file.close();
+        std::remove("gather.testfile");
+
+        mrt::fd_bytebuf missing{"missing.testfile"};
+        mrt::gather_writer closed{missing};
+
+        expect(read_back == expected, "gather_writer: Pieces should reach the file in order.");
+        expect(large_calls == 10, "gather_writer: Each message with a large piece should be one writev.");
+        expect(small_calls == 1, "gather_writer: Small messages should be batched in the buffer.");
+        expect(many_calls >= 4 && many_calls <= 5, "gather_writer: Long piece lists should be split.");
+        expect(closed.failed() && !closed.write(big), "gather_writer: An invalid handle should be reported.");
+        status();
+    }
+
+    // Case 27: copy_stream between descriptors and through the buffered fallback.
+    {
+        std::cout << "copy_stream ";
+        std::string payload;
+        for (auto i = 0; i < 300'000; ++i) {
+            payload.push_back(static_cast<char>('a' + (i * 7) % 26));
+        }
+        {
+            std::ofstream source{"copy_source.testfile", std::ios_base::binary};
+            source << payload;
+        }
+        const auto read_file = [](const char* path) {
+            std::ifstream file{path, std::ios_base::binary};
+            return std::string(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+        };
+
+        mrt::copy_result partial;
+        {
+            mrt::fd_bytebuf in{"copy_source.testfile", std::ios_base::in, 4096};
+            mrt::fd_bytebuf out{"copy_partial.testfile", std::ios_base::out, 4096};
+            char skipped[10];
+            in.sgetn(skipped, 10);
+            out.sputn("prefix", 6);
+            partial = mrt::copy_stream(&in, &out);
+            out.sputn("!", 1);
+        }
+
+        mrt::copy_result whole;
+        {
+            std::ifstream in{"copy_source.testfile", std::ios_base::binary};
+            std::ofstream out{"copy_whole.testfile", std::ios_base::binary};
+            whole = mrt::copy_stream(in, out);
+        }
+
+        std::stringstream memory_in{payload};
+        std::stringstream memory_out;
+        const auto buffered = mrt::copy_stream(memory_in, memory_out);
+
+        expect(!partial.failed && partial.bytes == payload.size() - 10
+            && read_file("copy_partial.testfile") == "prefix" + payload.substr(10) + "!",
+            "copy_stream: Copies should start and end at the stream positions.");
+        expect(!whole.failed && whole.bytes == payload.size() && read_file("copy_whole.testfile") == payload,
+            "copy_stream: Whole files should be copied.");
+        expect(!buffered.failed && buffered.method == mrt::copy_method::buffered && memory_out.str() == payload,
+            "copy_stream: Streams without descriptors should be copied in user space.");
+#ifdef __linux__
+        expect(partial.method != mrt::copy_method::buffered, "copy_stream: fd_bytebuf pairs should be copied by the kernel.");
+#ifdef MRT_STREAMBYTE_FILEBUF_FD
+        expect(whole.method != mrt::copy_method::buffered, "copy_stream: std::filebuf pairs should be copied by the kernel.");
+#else
+        expect(whole.method == mrt::copy_method::buffered, "copy_stream: std::filebuf pairs should fall back to user space.");
+#endif
+        // procfs reports a size of 0 and the kernel copies nothing, yet the file has content.
+        mrt::copy_result from_proc;
+        {
+            mrt::fd_bytebuf in{"/proc/self/status", std::ios_base::in, 4096};
+            mrt::fd_bytebuf out{"copy_proc.testfile", std::ios_base::out, 4096};
+            from_proc = mrt::copy_stream(&in, &out);
+        }
+        expect(!from_proc.failed && from_proc.bytes != 0
+            && read_file("copy_proc.testfile").compare(0, 5, "Name:") == 0,
+            "copy_stream: A 0 from the kernel before any byte moved should not end the copy.");
+        std::remove("copy_proc.testfile");
+#endif
+
+        std::remove("copy_source.testfile");
+        std::remove("copy_partial.testfile");
+        std::remove("copy_whole.testfile");
+        status();
+    }
+
+    // Case 28: tee feeds one read pass to several sinks.
+    {
+        std::cout << "tee ";
+        std::string payload;
+        for (auto i = 0; i < 200'000; ++i) {
+            payload.push_back(static_cast<char>((i * 31) % 251));
+        }
+
+        std::stringstream source{payload};
+        std::stringstream iterator_out;
+        std::stringstream streambuf_out;
+        std::stringstream threaded_out;
+        mrt::xxhash64 hasher;
+        mrt::crc32c threaded_crc;
+        std::size_t blocks = 0;
+        std::size_t refused_after = 0;
+        mrt::tee_result result;
+        bool finished = false;
+        {
+            mrt::ostreambyte_iterator<1000> out{iterator_out};
+            mrt::threaded_sink slow_file{threaded_out, 2};
+            mrt::threaded_sink slow_hash{threaded_crc};
+            result = mrt::tee(mrt::istreambyte_iterator<4096>{source}, mrt::istreambyte_iterator<4096>{},
+                out, hasher, streambuf_out.rdbuf(), slow_file, slow_hash,
+                [&blocks](mrt::const_byte_span) { ++blocks; },
+                [&refused_after](mrt::const_byte_span) { return refused_after++ == 0; });
+            finished = slow_file.finish() && slow_hash.finish();
+        }
+
+        std::stringstream again{payload};
+        const auto expected_hash = mrt::hash_bytes(mrt::istreambyte_iterator<64>{again}, mrt::istreambyte_iterator<64>{}, mrt::xxhash64{}).value();
+        mrt::crc32c expected_crc;
+        expected_crc.update({reinterpret_cast<const std::byte*>(payload.data()), payload.size()});
+
+        std::stringbuf read_only{std::ios_base::in};
+        std::stringstream failing_source{payload};
+        mrt::threaded_sink failing{read_only};
+        const auto failing_result = mrt::tee(mrt::istreambyte_iterator<4096>{failing_source}, mrt::istreambyte_iterator<4096>{}, failing);
+
+        expect(result.bytes == payload.size() && blocks == (payload.size() + 4095) / 4096, "tee: Every block should be read once.");
+        expect(iterator_out.str() == payload && streambuf_out.str() == payload, "tee: Iterator and streambuf sinks should get everything.");
+        expect(hasher.value() == expected_hash, "tee: Hashers should see every byte.");
+        expect(finished && threaded_out.str() == payload && threaded_crc.value() == expected_crc.value(),
+            "threaded_sink: Off-thread sinks should get every block in order.");
+        expect(result.failed_sinks == 1 && refused_after == 2, "tee: A refusing sink should be dropped and reported.");
+        expect(!failing.finish() && failing_result.failed_sinks <= 1, "threaded_sink: A failing sink should be reported.");
+        status();
+    }
+
+    // Case 29: bit_reader / bit_writer in both bit orders.
+    {
+        std::cout << "bit_reader / bit_writer ";
+        std::vector<std::pair<std::uint64_t, unsigned>> symbols;
+        std::uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (auto i = 0; i < 5'000; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            const auto width = static_cast<unsigned>(state % 56) + 1;
+            symbols.emplace_back((state >> 8) & ((std::uint64_t{1} << width) - 1), width);
+        }
+
+        const auto round_trip = [&symbols](auto order_tag) {
+            constexpr mrt::bit_order order = decltype(order_tag)::value;
+            std::stringstream ss;
+            {
+                mrt::bit_writer<256, order> writer{ss};
+                for (const auto& [value, width] : symbols) {
+                    writer.write_bits(value, width);
+                }
+            }
+
+            // Small blocks so refills keep crossing block boundaries.
+            mrt::bit_reader<mrt::istreambyte_iterator<64>, order> reader{mrt::istreambyte_iterator<64>{ss}};
+            bool same = true;
+            for (const auto& [value, width] : symbols) {
+                same = same && reader.read_bits(width) == value;
+            }
+            reader.align_to_byte();
+            return same && !reader.failed() && reader.at_end();
+        };
+        const bool lsb = round_trip(std::integral_constant<mrt::bit_order, mrt::bit_order::lsb_first>{});
+        const bool msb = round_trip(std::integral_constant<mrt::bit_order, mrt::bit_order::msb_first>{});
+
+        std::stringstream lsb_out;
+        std::stringstream msb_out;
+        {
+            mrt::bit_writer<> lsb_writer{lsb_out};
+            lsb_writer.write_bits(0b101, 3);
+            lsb_writer.write_bit(true);
+            mrt::bit_writer<64, mrt::bit_order::msb_first> msb_writer{msb_out};
+            msb_writer.write_bits(0b101, 3);
+            msb_writer.write_bit(true);
+            msb_writer.write_bits(0xABCD, 16);
+        }
+
+        // Peek / consume decoding straight out of the get area.
+        std::stringstream packed{"\xB1\x0F"};
+        mrt::bit_reader<mrt::istreambuf_byte_iterator, mrt::bit_order::msb_first> peeker{mrt::istreambuf_byte_iterator{packed}};
+        peeker.refill();
+        const auto nibble = peeker.peek_bits(4);
+        peeker.consume_bits(4);
+        const auto rest = peeker.peek_bits(12);
+        peeker.consume_bits(12);
+        const bool past_end = peeker.read_bits(1) == 0 && peeker.failed();
+
+        // Refills ending on a byte boundary in the slow path must not overfill the accumulator.
+        std::string counting;
+        for (auto i = 0; i < 64; ++i) {
+            counting.push_back(static_cast<char>(i));
+        }
+        std::stringstream aligned{counting};
+        mrt::bit_reader<mrt::istreambyte_iterator<16>> stepper{mrt::istreambyte_iterator<16>{aligned}};
+        stepper.refill();
+        stepper.consume_bits(56);
+        stepper.refill();
+        stepper.consume_bits(56);
+        stepper.refill();
+        stepper.align_to_byte();
+        stepper.refill();
+        const bool stepped = stepper.bits_available() <= 63 && stepper.read_bits(8) == 14;
+
+        expect(lsb && msb, "bit_reader / bit_writer: Symbols should round trip in both bit orders.");
+        expect(lsb_out.str() == "\x0D" && msb_out.str() == std::string("\xBA\xBC\xD0"), "bit_writer: Bits should be packed in stream order.");
+        expect(nibble == 0xB && rest == 0x10F && past_end, "bit_reader: peek_bits / consume_bits should walk the stream.");
+        expect(stepped, "bit_reader: Refills should keep the accumulator within 64 bits.");
+        status();
+    }
+
+    // Case 30: cdc_chunks cuts content-defined chunks that survive insertions.
+    {
+        std::cout << "cdc_chunks ";
+        std::string payload;
+        std::uint64_t state = 0x2545F4914F6CDD1Dull;
+        for (auto i = 0; i < 1'000'000; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            payload.push_back(static_cast<char>(state >> 56));
+        }
+
+        const auto cut = [](auto&& chunks) {
+            std::vector<std::string> result;
+            for (const auto chunk : chunks) {
+                result.emplace_back(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+            }
+            return result;
+        };
+
+        std::stringstream whole{payload};
+        const auto chunks = cut(mrt::cdc_chunks(whole, 2048, 8192, 65536));
+        // Tiny blocks: every chunk crosses blocks and is gathered.
+        std::stringstream small_blocks{payload};
+        const auto gathered = cut(mrt::cdc_chunks(mrt::istreambyte_iterator<64>{small_blocks}, 2048, 8192, 65536));
+        std::stringstream edited{"inserted" + payload};
+        const auto shifted = cut(mrt::cdc_chunks(edited, 2048, 8192, 65536));
+
+        std::string joined;
+        bool bounded = true;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            joined += chunks[i];
+            bounded = bounded && chunks[i].size() <= 65536 && (chunks[i].size() >= 2048 || i + 1 == chunks.size());
+        }
+        const auto average = payload.size() / chunks.size();
+
+        std::size_t shared = 0;
+        for (const auto& chunk : shifted) {
+            shared += std::find(chunks.begin(), chunks.end(), chunk) != chunks.end() ? 1 : 0;
+        }
+
+        std::stringstream empty;
+        auto none = mrt::cdc_chunks(empty);
+
+        expect(joined == payload && bounded, "cdc_chunks: Chunks should cover the stream within the size limits.");
+        expect(average >= 4096 && average <= 16384, "cdc_chunks: Chunks should average about avg_size.");
+        expect(gathered == chunks, "cdc_chunks: Boundaries should not depend on the block size.");
+        expect(shared + 2 >= shifted.size(), "cdc_chunks: An insertion should only change the chunks around it.");
+        expect(none.begin() == none.end(), "cdc_chunks: An empty stream should have no chunks.");
+        status();
+    }
+
+    // Case 31: base64 / hex stages write into the iterator's block and round trip.
+    {
+        std::cout << "base64_encode ";
+        const auto reference = [](const std::string& bytes, const char* chars, bool padding) {
+            std::string text;
+            for (std::size_t i = 0; i < bytes.size(); i += 3) {
+                const std::size_t n = std::min<std::size_t>(3, bytes.size() - i);
+                std::uint32_t word = 0;
+                for (std::size_t k = 0; k < 3; ++k) {
+                    word = word << 8 | (k < n ? static_cast<unsigned char>(bytes[i + k]) : 0u);
+                }
+                for (std::size_t k = 0; k < 4; ++k) {
+                    if (k <= n) {
+                        text.push_back(chars[word >> (18 - 6 * k) & 63]);
+                    } else if (padding) {
+                        text.push_back('=');
+                    }
+                }
+            }
+            return text;
+        };
+
+        std::string payload;
+        for (auto i = 0; i < 5000; ++i) {
+            payload.push_back(static_cast<char>((i * 7919) >> 3));
+        }
+
+        const char* standard = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const char* url = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        bool encoded = true;
+        bool decoded = true;
+        for (std::size_t size = 0; size < 200; size += (size < 70 ? 1 : 37)) {
+            const std::string bytes = payload.substr(0, size);
+            for (const bool padding : {true, false}) {
+                for (const auto alphabet : {mrt::base64_alphabet::standard, mrt::base64_alphabet::url}) {
+                    std::stringstream text;
+                    {
+                        // 16 byte blocks split groups across windows.
+                        mrt::ostreambyte_iterator<16> out{text};
+                        std::stringstream in{bytes};
+                        encoded = mrt::base64_encode(mrt::istreambyte_iterator<32>{in}, mrt::istreambyte_iterator<32>{},
+                                                     out, alphabet, padding) && out.flush() && encoded;
+                    }
+                    encoded = encoded && text.str() == reference(bytes, alphabet == mrt::base64_alphabet::url ? url : standard, padding)
+                        && text.str().size() == mrt::base64_encoded_size(size, padding);
+
+                    std::vector<std::byte> back(mrt::base64_decoded_size(text.str().size()));
+                    mrt::span_byte_writer out{mrt::byte_span{back}};
+                    decoded = mrt::base64_decode(text.str(), out, alphabet) && decoded;
+                    back.resize(static_cast<std::size_t>(out.position() - back.data()));
+                    decoded = decoded && std::string(reinterpret_cast<const char*>(back.data()), back.size()) == bytes;
+                }
+            }
+        }
+
+        std::stringstream hex;
+        {
+            mrt::ostreambyte_iterator<7> out{hex};
+            const auto bytes = mrt::const_byte_span{reinterpret_cast<const std::byte*>(payload.data()), payload.size()};
+            encoded = mrt::hex_encode(bytes, out) && out.flush() && encoded;
+        }
+        std::vector<std::byte> unhexed(payload.size());
+        mrt::span_byte_writer unhex_out{mrt::byte_span{unhexed}};
+        std::string upper = hex.str();
+        std::transform(upper.begin(), upper.end(), upper.begin(), [](char c) { return static_cast<char>(std::toupper(c)); });
+        std::string expected_hex;
+        for (const char c : payload) {
+            expected_hex.push_back("0123456789abcdef"[static_cast<unsigned char>(c) >> 4]);
+            expected_hex.push_back("0123456789abcdef"[static_cast<unsigned char>(c) & 15]);
+        }
+        const bool hex_ok = hex.str() == expected_hex
+            && mrt::hex_decode(upper, unhex_out)
+            && std::memcmp(unhexed.data(), payload.data(), payload.size()) == 0;
+
+        // Through the streambuf stages, with the decoder reading whole blocks.
+        std::stringstream staged;
+        {
+            mrt::base64_encode_streambuf encoder{staged.rdbuf(), mrt::base64_encoder{mrt::base64_alphabet::url}};
+            encoder.sputn(payload.data(), 1000);
+            encoder.sputn(payload.data() + 1000, static_cast<std::streamsize>(payload.size() - 1000));
+        }
+        mrt::base64_decode_streambuf decoder{staged.rdbuf(), mrt::base64_decoder{mrt::base64_alphabet::url}};
+        std::string restaged;
+        for (mrt::istreambyte_iterator<4096> it{&decoder}; it != mrt::istreambyte_iterator<4096>{}; ++it) {
+            restaged.push_back(static_cast<char>(*it));
+        }
+
+        std::stringstream hex_text{"48656c6C6f"};
+        mrt::hex_decode_streambuf hex_decoder{hex_text.rdbuf()};
+        std::string hello(5, '\0');
+        const bool hex_streamed = hex_decoder.sgetn(hello.data(), 5) == 5 && hello == "Hello";
+
+        std::array<std::byte, 8> sink{};
+        const auto rejects = [&](std::string_view text) {
+            mrt::span_byte_writer out{mrt::byte_span{sink}};
+            return !mrt::base64_decode(text, out);
+        };
+        std::array<std::byte, 6> exact{};
+        mrt::span_byte_writer exact_out{mrt::byte_span{exact}};
+        mrt::span_byte_writer hex_sink{mrt::byte_span{sink}};
+
+        expect(encoded, "base64_encode: Encoding should match RFC 4648 for every length and alphabet.");
+        expect(decoded, "base64_decode: Decoding should restore the bytes, padded or not.");
+        expect(hex_ok, "hex_encode: Hex should round trip and decode either case.");
+        expect(restaged == payload && !decoder.failed(), "base64_decode_streambuf: The streambuf stages should round trip.");
+        expect(hex_streamed, "hex_decode_streambuf: Hex should decode through a streambuf.");
+        expect(mrt::base64_decode("Zm9vYg==", exact_out) && exact_out.position() == exact.data() + 4,
+               "base64_decode: Padding should not need room in the output.");
+        expect(rejects("Zm9v YmFy") && rejects("Zm9vY") && rejects("Zm=v") && rejects("Zg=a") && rejects("Zm9v+/-_"),
+               "base64_decode: Invalid text should be rejected.");
+        expect(!mrt::hex_decode("abc", hex_sink) && !mrt::hex_decode("zz", hex_sink),
+               "hex_decode: Odd or non-hex input should be rejected.");
+        status();
+    }
+
+#if defined(MRT_STREAMBYTE_CORO) && defined(__linux__)
+    // Case 32: async_byte_reader / async_socket_writer over a socketpair (C++20 coroutines).
+    {
+        std::cout << "async_byte_reader ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 1'000'000; ++i) {
+            payload.push_back(static_cast<std::byte>(i % 253));
+        }
+
+        int fds[2];
+        expect(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "async_byte_reader: socketpair should succeed.");
+
+        mrt::epoll_executor executor;
+        mrt::async_socket_writer<mrt::epoll_executor> writer{executor, fds[0], 4096};
+        mrt::async_byte_reader<mrt::epoll_executor> reader{executor, fds[1], 8192};
+        std::vector<std::byte> received;
+        std::size_t chunks = 0;
+
+        executor.spawn(coro_receive(reader, received, chunks));
+        executor.spawn(coro_send(writer, payload, fds[0]));
+        executor.run();
+
+        expect(!executor.failed() && !writer.failed() && !reader.failed(), "async_byte_reader: Nothing should fail.");
+        expect(received == payload, "async_byte_reader: Expected results mismatch.");
+        expect(chunks > 1, "async_byte_reader: The payload should arrive in several chunks.");
+
+        ::close(fds[0]);
+        ::close(fds[1]);
+        status();
+    }
+#endif
+
+#if defined(MRT_STREAMBYTE_IO_URING) && defined(__linux__)
+    // Case 33: uring_bytebuf round trip (only built with -DMRT_STREAMBYTE_IO_URING).
+    {
+        std::cout << "uring_bytebuf ";
+        std::vector<std::byte> expected_bytes;
+        for (auto i = 0; i < 300'000; ++i) {
+            expected_bytes.push_back(static_cast<std::byte>(i % 251));
+        }
+
+        {
+            mrt::uring_bytebuf out{"uring.testfile", std::ios_base::out, 8192, 4};
+            expect(!out.failed(), "uring_bytebuf: Opening for writing should succeed.");
+            mrt::ostreambyte_iterator<100> it{&out};
+            std::copy(std::begin(expected_bytes), std::end(expected_bytes), it);
+        }
+
+        mrt::uring_bytebuf in{"uring.testfile", std::ios_base::in, 8192, 4};
+        std::vector<std::byte> resulting_bytes(mrt::istreambuf_byte_iterator{&in}, mrt::istreambuf_byte_iterator{});
+
+        // Repeated probes at the end must not queue reads past it, even once the file grows.
+        bool stays_at_end = true;
+        for (auto i = 0; i < 10; ++i) {
+            stays_at_end = stays_at_end && in.sgetc() == std::char_traits<char>::eof();
+        }
+        {
+            std::ofstream grown{"uring.testfile", std::ios_base::binary | std::ios_base::app};
+            grown << std::string(1 << 20, 'z');
+        }
+        for (auto i = 0; i < 10; ++i) {
+            stays_at_end = stays_at_end && in.sgetc() == std::char_traits<char>::eof();
+        }
+
+        expect(!in.failed(), "uring_bytebuf: Reading should not fail.");
+        expect(resulting_bytes == expected_bytes, "uring_bytebuf: Expected results mismatch.");
+        expect(stays_at_end, "uring_bytebuf: The end of file should be latched.");
+
+        std::remove("uring.testfile");
+        status();
+    }
+#endif
+
+#if defined(MRT_STREAMBYTE_ZSTD) || defined(MRT_STREAMBYTE_LZ4)
+    // Case 34: zstd / lz4 round trips (only built with -DMRT_STREAMBYTE_ZSTD / -DMRT_STREAMBYTE_LZ4).
+    {
+        std::cout << "zstd / lz4 streambufs ";
+        std::vector<std::byte> payload;
+        for (auto i = 0; i < 300'000; ++i) {
+            payload.push_back(static_cast<std::byte>((i / 7) % 256));
+        }
+
+        const auto round_trip = [&payload](auto tag, auto encoder) {
+            using compress_type = mrt::compress_streambuf<decltype(encoder)>;
+            using decompress_type = mrt::decompress_streambuf<typename decltype(tag)::type>;
+
+            std::stringstream ss;
+            bool written = false;
+            {
+                compress_type packed{ss, std::move(encoder)};
+                mrt::write_bytes(&packed, payload);
+                written = packed.finish();
+            }
+
+            decompress_type unpacked{ss};
+            std::vector<std::byte> read_back;
+            mrt::copy(mrt::istreambyte_iterator<4096>{&unpacked}, mrt::istreambyte_iterator<4096>{}, std::back_inserter(read_back));
+
+            return written && !unpacked.failed() && read_back == payload && ss.str().size() < payload.size();
+        };
+
+        struct zstd_tag { using type = mrt::zstd_decoder; };
+        struct lz4_tag { using type = mrt::lz4_decoder; };
+#if defined(MRT_STREAMBYTE_ZSTD)
+        expect(round_trip(zstd_tag{}, mrt::zstd_encoder{}), "zstd_compress_streambuf: Round trip should give the payload back.");
+        expect(round_trip(zstd_tag{}, mrt::zstd_encoder{3, 2}), "zstd_compress_streambuf: Threaded compression should round trip.");
+#endif
+#if defined(MRT_STREAMBYTE_LZ4)
+        expect(round_trip(lz4_tag{}, mrt::lz4_encoder{}), "lz4_compress_streambuf: Round trip should give the payload back.");
+#endif
+        status();
+    }
+#endif
+
     return g_final_result == 0 ? 0 : -g_final_result;
 }
\ No newline at end of file